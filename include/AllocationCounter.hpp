@@ -0,0 +1,41 @@
+/**
+ *  @file   AllocationCounter.hpp
+ *  @brief  Counts heap allocations, for catching them creeping into the drawing paths.
+ *  @author Ellah
+ *  @date   2021-12-24
+ ***********************************************/
+#ifndef ALLOCATIONCOUNTER_HPP
+#define ALLOCATIONCOUNTER_HPP
+
+// Heap allocations made by a thread, and the bytes asked for
+struct AllocationCount {
+    unsigned long allocations = 0;
+    unsigned long deallocations = 0;
+    unsigned long bytes = 0;
+};
+
+// Built with COUNT_ALLOCATIONS, operator new and delete count every allocation of each thread.
+// Without it nothing is counted and every count stays 0.
+class AllocationCounter {
+public:
+    static bool isEnabled();
+    // What the calling thread allocated so far
+    static AllocationCount get();
+};
+
+// Counts what the calling thread allocates from its construction on
+class AllocationProbe {
+private:
+    AllocationCount m_start;
+
+public:
+    AllocationProbe();
+
+    unsigned long getAllocations() const;
+    unsigned long getDeallocations() const;
+    unsigned long getBytes() const;
+    // Starts counting again from now
+    void reset();
+};
+
+#endif
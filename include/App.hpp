@@ -19,13 +19,26 @@
 // Project header files
 #include "Command.hpp"
 #include "TCPClient.hpp"
+#include "Reconciler.hpp"
+#include "Palette.hpp"
+#include "Canvas.hpp"
+#include "LayerStack.hpp"
+#include "Blend.hpp"
+#include "SessionRecorder.hpp"
+#include "Profiler.hpp"
+#include "EventTrace.hpp"
 
 #include "CompositeCommand.hpp"
 using namespace std;
 
 // Some values for our GUI
 enum {
-    DRAW_MODE, ERASE_MODE
+    DRAW_MODE, ERASE_MODE, FILL_MODE, LINE_MODE, RECT_MODE, ELLIPSE_MODE, SELECT_MODE
+};
+// Where the GUI and the canvas are shown. A headless App has no windows and no OpenGL context, for
+// servers, benchmarks and tests.
+enum WindowLayout {
+    SEPARATE_WINDOWS, SINGLE_WINDOW, HEADLESS
 };
 struct Mode {
     const char *label;
@@ -37,6 +50,13 @@ struct PresetColor {
     sf::Color color;
 };
 
+// A canvas tile on the GPU, with the tile version it holds and the frame it was last shown in
+struct TileTexture {
+    sf::Texture texture;
+    sf::Uint64 version;
+    sf::Uint64 lastShown;
+};
+
 // Singleton for our Application called 'App'.
 class App {
 private:
@@ -46,34 +66,84 @@ private:
     deque<Command *> m_commands;
     // Stack that stores the last action to occur.
     stack<Command *> m_undo;
-    // Main image
-    sf::Image *m_image;
-    // Create a sprite that we overlay on top of the texture.
-    sf::Sprite *m_sprite;
-    // Texture sent to the GPU for rendering
-    sf::Texture *m_texture;
+    // Layers commands draw on, their composite is what the window shows. May be larger than the window.
+    LayerStack *m_layers;
+    // Textures of the canvas tiles shown recently, by level, row and column. See tileKey.
+    map<sf::Uint64, TileTexture> m_tileTextures;
+    // Counts the calls to updateTiles, for evicting the textures shown least recently
+    sf::Uint64 m_tileFrame;
+    // Window pixels per canvas pixel, and the canvas position shown at the canvas area's top left corner
+    float m_zoom;
+    sf::Vector2f m_viewOrigin;
     // Our rendering window
     sf::RenderWindow *m_window;
 
     // Our clock for measuring re-renders
     sf::Clock *m_clock;
     TCPClient *m_client;
+    // Set while the server's order is authoritative, see Reconciler
+    Reconciler *m_reconciler;
+    // Set while the session is recorded, see SessionRecorder
+    SessionRecorder *m_recorder;
     sf::RenderWindow *gui_window;
+    // Where other users' cursors are, by session number. Drawn over the canvas, never onto it.
+    map<sf::Uint16, sf::Vector2i> m_cursors;
+    // Colour table of each user, including ours, see Palette
+    map<string, Palette> m_palettes;
+    // Set when the canvas window shows something out of date
+    bool m_canvasDirty;
+    // Number of frames the GUI still has to be laid out and rendered for
+    int m_guiFrames;
+    // Set when the GUI is drawn in the canvas window, left of the canvas
+    bool m_singleWindow;
+    // Set when there are no windows at all, see WindowLayout
+    bool m_headless;
+    // Set once loop should return
+    bool m_closed;
+    // Times the stages of each frame, shown in the GUI while m_showProfiler is set
+    Profiler m_profiler;
+    bool m_showProfiler;
+    // Messages sent by each user, ourselves included, for following them across processes. See EventTrace.
+    map<string, unsigned long> m_flowCounts;
+    // Time since the profiler section was last laid out
+    sf::Clock m_profilerClock;
+    // Canvas window events for the update function. Only used with a single window, where the GUI polls it.
+    queue<sf::Event> m_events;
 
 // Store the address of our function pointer for each of the callback functions.
     void (*m_updateFunc)(App *);
     void (*m_drawFunc)(App *);
 
     void executeCommand(Command *c);
+    string getLocalName() const;
 
     void drawLayout();
-    void handleGUIInput();
+    void drawProfiler();
+    void sampleQueues();
+    void display(sf::RenderWindow *window);
+    void drawCursors();
+    void drawSelection();
+    void drawTiles();
+    sf::IntRect getVisibleTiles(unsigned int level) const;
+    static sf::Uint64 tileKey(unsigned int level, unsigned int column, unsigned int row);
+    void renderGUI();
+    void renderCanvas();
+    bool handleGUIInput();
+    void loopHeadless();
 
 public:
 // Member Variables
     unsigned int mouseX, mouseY;
     int selectedMode = DRAW_MODE;
     sf::Uint8 brushRadius;
+    sf::Uint8 brushOpacity = 255;
+    BlendMode blendMode = BLEND_NORMAL;
+    // How far a colour may be from the clicked one on each channel to be filled, see FloodFill
+    sf::Uint8 fillTolerance = 0;
+    // Whether rectangles and ellipses are drawn filled rather than outlined, see Shape
+    bool fillShapes = false;
+    // Canvas rectangle picked with the select tool, which moves or copies it, see Selection. Empty if none.
+    sf::IntRect selection;
     sf::Color selectedColor = sf::Color::Black;
     sf::Color backgroundColor = sf::Color::White;
     map<string, CompositeCommand *> m_inProgressCommands;
@@ -84,44 +154,99 @@ public:
     unsigned static int const WINDOW_WIDTH = 800, WINDOW_HEIGHT = 800;
     unsigned static int const GUI_WIDTH = 220;
     unsigned static int const FRAMES_PER_SECOND = 24;
+    unsigned static int const CURSOR_RADIUS = 6;
+    // Longest an idle loop sleeps before checking for input again
+    unsigned static int const IDLE_WAIT_MS = 16;
+    // Nuklear updates hover and active states a frame after the input that caused them
+    unsigned static int const GUI_SETTLE_FRAMES = 2;
+    // Tile textures kept on the GPU, 16 KiB each
+    unsigned static int const MAX_TILE_TEXTURES = 1024;
+    // Time between two layouts of the profiler section while it is shown
+    unsigned static int const PROFILER_REFRESH_MS = 250;
+    static constexpr float MIN_ZOOM = 1.0f / 64, MAX_ZOOM = 16;
     static const vector<Mode> PRESET_MODES;
+    static const vector<Mode> BLEND_MODES;
     static const vector<PresetColor> PRESET_COLORS;
 
 // Member functions
     //Getters
-    sf::Image &getImage();
-    sf::Texture &getTexture();
+    // The layer we draw on
+    Canvas &getImage();
+    LayerStack &getLayers();
+    unsigned int getLayer() const;
+    sf::Color getEraseColor() const;
+    // The canvas window, only for an App with windows
     sf::RenderWindow &getWindow();
+    bool isHeadless() const;
     sf::Clock &getClock();
     sf::Color getBGColor();
+    sf::Vector2i getMousePosition();
+    int getCanvasOffset() const;
     TCPClient *getClient();
+    Reconciler *getReconciler();
+    const map<sf::Uint16, sf::Vector2i> &getCursors() const;
+    Palette &getPalette(const string &username);
+    float getZoom() const;
+    // Level of the canvas's pyramid shown at the current zoom
+    unsigned int getViewLevel() const;
+    unsigned long getTileTextureCount() const;
+    Profiler &getProfiler();
 
     int getMode();
     [[nodiscard]] sf::Uint8 getRadius() const;
-    static sf::Uint8 getColorNumber(sf::Color color);
 
     //Setters
     void setMode(int newMode);
     void setBGColor(sf::Color newBGColor);
+    void setReconcile(bool reconcile);
+    void setRecorder(SessionRecorder *recorder);
+    void setCursor(sf::Uint16 session, sf::Uint16 x, sf::Uint16 y);
+    void setCanvasSize(unsigned int width, unsigned int height);
+    // Draws on another layer from now on, and tells the others
+    void selectLayer(unsigned int layer);
 
     //Other
-    //Constructor
-    App(void (*updateFunction)(App *), void (*drawFunction)(App *));
+    //Constructor, a single window holds both the GUI and the canvas if asked, or there are none
+    App(void (*updateFunction)(App *), void (*drawFunction)(App *), WindowLayout layout = SEPARATE_WINDOWS);
+
+    bool pollEvent(sf::Event &event);
 
     void addClient(TCPClient *client);
+    void sendCommand(const sf::Packet &packet);
+    // Applies the next command the client received, returns false if there was none
+    bool executeReceivedCommand();
+    // Applies a command as received from the server, without its sequence number
+    void applyCommand(sf::Packet packet);
 
     void startComposite(const string &username, CompositeCommand *c);
     void endComposite(const string &username);
     void addToComposite(const string &username, Command *c);
+    // Keeps a stroke in step with a command the reconciler drew instead
+    void followStroke(sf::Uint8 header, const string &username, sf::Packet &packet);
     void addCommand(Command *c);
     void undoCommand();
     void redoCommand();
 
+    // Converts between positions in the canvas area of the window and on the canvas
+    sf::Vector2f toCanvas(sf::Vector2i position) const;
+    sf::Vector2f toWindow(sf::Vector2f position) const;
+    // Zooms by a factor, keeping the canvas position under the given window position in place
+    void zoomAt(sf::Vector2i position, float factor);
+    // Moves the view by a number of window pixels
+    void pan(float dx, float dy);
+    void resetView();
+
+    void updateTiles();
+    void invalidateCanvas();
+    void invalidateGUI();
+
     void incrementBrushRadius();
     void decrementBrushRadius();
 
     void destroy();
     void loop();
+    // Makes loop return after the current frame
+    void close();
 
 
 };
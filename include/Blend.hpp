@@ -0,0 +1,49 @@
+/**
+ *  @file   Blend.hpp
+ *  @brief  Blending spans of premultiplied pixels, vectorised for the processor it runs on.
+ *  @author Ellah
+ *  @date   2021-12-20
+ ***********************************************/
+#ifndef BLEND_HPP
+#define BLEND_HPP
+
+// Include our Third-Party SFML header
+#include <SFML/Graphics.hpp>
+
+// How a brush dab combines with the pixels under it
+// BLEND_NORMAL   Paints over them
+// BLEND_MULTIPLY Darkens them by the colour, white leaves them as they were
+// BLEND_SCREEN   Lightens them by the colour, black leaves them as they were
+// BLEND_ERASE    Makes them transparent by the colour's alpha, whatever the colour
+enum BlendMode : sf::Uint8 {
+    BLEND_NORMAL, BLEND_MULTIPLY, BLEND_SCREEN, BLEND_ERASE, BLEND_MODE_COUNT
+};
+
+// Implementations of the span functions. They give the same pixels to the bit, the vectorised ones
+// are only faster.
+enum BlendKernel {
+    KERNEL_SCALAR, KERNEL_SSE41, KERNEL_AVX2
+};
+
+// Every pixel given to these is premultiplied, i.e. its colour is already scaled by its alpha, like the
+// pixels of a Canvas. The best kernel the processor supports is picked the first time one is used.
+class Blend {
+public:
+    // Blends one colour into count pixels, each pixel weighted by its coverage from 0 to 255
+    static void colorSpan(BlendMode mode, sf::Color *dst, const sf::Uint8 *coverage, unsigned int count,
+                          sf::Color color);
+
+    // Blends count pixels over as many others, the ones blended scaled by an opacity from 0 to 255
+    static void pixelSpan(sf::Color *dst, const sf::Color *src, unsigned int count, sf::Uint8 opacity);
+
+    // Converts between straight colours, as picked and sent, and premultiplied ones
+    static sf::Color premultiply(sf::Color color);
+    static sf::Color unpremultiply(sf::Color color);
+
+    // Uses the given kernel from now on if the processor supports it. Returns whether it does.
+    static bool setKernel(BlendKernel kernel);
+    static BlendKernel getKernel();
+    static bool isSupported(BlendKernel kernel);
+};
+
+#endif
@@ -21,10 +21,12 @@ private:
     deque<DrawBrush> m_draws;
 
     // Generate and add new DrawBrushes to connect the two most recently added DrawBrushes
-    void interpolate(DrawBrush newestDraw);
+    void interpolate(const DrawBrush &newestDraw);
 
     // Add a DrawBrush to m_draws if it is unique and execute it
-    void addAndExecuteDraw(DrawBrush newDraw);
+    void addAndExecuteDraw(const DrawBrush &newDraw);
+    // Execute the DrawBrush last added to m_draws, or remove it if it is the same as the one before
+    void executeNewestDraw();
 
 public:
     //Constructor
@@ -38,9 +40,12 @@ public:
     bool execute() override;
     bool undo() override;
     void addAndExecuteCommand(Command *c) override;
+    // Add a DrawBrush that is already on the canvas without drawing it again, so the next one is
+    // interpolated from it
+    void continueFrom(const DrawBrush &drawn);
 
-    // Returns a copy of the DrawBrushes currently in this BrushStroke
-    deque<DrawBrush> getDraws();
+    // Returns the DrawBrushes currently in this BrushStroke
+    const deque<DrawBrush> &getDraws() const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,115 @@
+/**
+ *  @file   Canvas.hpp
+ *  @brief  Sparse tiled drawing surface, larger than the window.
+ *  @author Ellah
+ *  @date   2021-12-18
+ ***********************************************/
+#ifndef CANVAS_HPP
+#define CANVAS_HPP
+
+// Include our Third-Party SFML header
+#include <SFML/Graphics.hpp>
+
+// Include standard library C++ libraries.
+#include <vector>
+using namespace std;
+
+// The pixels commands draw on. Its size does not depend on the window and can be up to MAX_SIZE on each
+// side. Pixels are kept in TILE_SIZE square tiles that are only allocated once something is painted on
+// them, every other pixel is the background colour. A board therefore costs memory for what was drawn on
+// it, plus a small table with one entry per tile.
+//
+// Pixels are premultiplied, their colour already scaled by their alpha, see Blend. The two only differ
+// for pixels that are not opaque.
+//
+// For zoomed out views the canvas also keeps a pyramid of levels, each half the size of the one below,
+// with level 0 being the canvas itself. A tile above level 0 is rebuilt from the four below it only when
+// asked for after one of them changed, and stays blank while they are.
+class Canvas {
+private:
+    unsigned int m_width, m_height;
+    // Number of levels, the top one fits in a single tile
+    unsigned int m_levels;
+    sf::Color m_background;
+    // Pixels of each tile row by row, by level then tile index. Empty while blank.
+    vector<vector<vector<sf::Color>>> m_tiles;
+    // Tiles whose pixels are out of date because a tile below changed
+    vector<vector<bool>> m_stale;
+    // Tiles that changed since the tile above was last rebuilt, the tile above is already stale
+    vector<vector<bool>> m_reported;
+    // Value of s_version when each tile last changed, so a copy can tell if it is out of date. Shared by
+    // every canvas, so a tile copied from another canvas never has the version of different pixels.
+    vector<vector<sf::Uint64>> m_versions;
+    static sf::Uint64 s_version;
+    // Level 0 tiles changed since takeChangedTiles was last called, and whether the canvas was created since
+    vector<unsigned int> m_changed;
+    vector<bool> m_listed;
+    bool m_recreated;
+
+    unsigned int tileIndex(unsigned int level, unsigned int column, unsigned int row) const;
+    void markChanged(unsigned int column, unsigned int row);
+    void touch(unsigned int column, unsigned int row);
+    void rebuild(unsigned int level, unsigned int column, unsigned int row);
+
+public:
+    unsigned static constexpr int TILE_SIZE = 64;
+    unsigned static constexpr int MAX_SIZE = 32768;
+
+    Canvas();
+
+    // Starts over with a canvas of the given size filled with the background colour
+    void create(unsigned int width, unsigned int height, sf::Color background);
+
+    // Pixels outside the canvas are left alone
+    void setPixel(unsigned int x, unsigned int y, sf::Color color);
+
+    // Pixels outside the canvas read as the background
+    sf::Color getPixel(unsigned int x, unsigned int y) const;
+
+    // Returns row y of the canvas from x for changing in place, allocating its tile. Sets count to the
+    // number of pixels that can be changed, at most count and no further than the end of the tile.
+    sf::Color *editSpan(unsigned int x, unsigned int y, unsigned int &count);
+
+    // Returns row y of the canvas from x for reading, limiting count the same way. Returns nullptr
+    // instead if the tile is blank, as then every one of those pixels is the background.
+    const sf::Color *readSpan(unsigned int x, unsigned int y, unsigned int &count) const;
+
+    // Copies a region to RGBA pixels with the given number of pixels per row, for a texture
+    void copyTo(sf::Uint8 *pixels, unsigned int left, unsigned int top, unsigned int width, unsigned int height,
+                unsigned int stride) const;
+
+    // Copies RGBA pixels with the given number of pixels per row into a region, which has to be on the
+    // canvas. Parts of blank tiles that would only get the background are left blank.
+    void copyFrom(const sf::Uint8 *pixels, unsigned int left, unsigned int top, unsigned int width,
+                  unsigned int height, unsigned int stride);
+
+    // Paints a region on the canvas one colour, making the tiles it covers whole blank if that is the background
+    void fillRect(unsigned int left, unsigned int top, unsigned int width, unsigned int height, sf::Color color);
+
+    // Returns the pixels of a tile at a level, bringing it up to date first. Empty if the tile is blank.
+    const vector<sf::Color> &getTile(unsigned int level, unsigned int column, unsigned int row);
+
+    // Replaces the pixels of a level 0 tile, TILE_SIZE rows of TILE_SIZE. Empty pixels make it blank.
+    void setTile(unsigned int column, unsigned int row, const vector<sf::Color> &pixels);
+
+    // Copies a level 0 tile with its version from another canvas of the same size, unless it has that version
+    void copyTile(const Canvas &other, unsigned int column, unsigned int row);
+
+    // Moves the indexes of the level 0 tiles changed since the last call into tiles. Returns true instead
+    // if the canvas was created again since, as then every tile may have changed.
+    bool takeChangedTiles(vector<unsigned int> &tiles);
+
+    //Getters
+    sf::Vector2u getSize() const;
+    sf::Color getBackground() const;
+    unsigned long getTileCount() const;
+    unsigned int getLevels() const;
+    // Number of tiles across and down at a level
+    sf::Vector2u getTileGrid(unsigned int level) const;
+    // Changes whenever the tile's pixels may have, once brought up to date
+    sf::Uint64 getTileVersion(unsigned int level, unsigned int column, unsigned int row) const;
+    // FNV-1a hash of the size and every pixel, the same whichever tiles are allocated
+    sf::Uint64 getHash() const;
+};
+
+#endif
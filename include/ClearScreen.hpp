@@ -11,13 +11,14 @@
 #include <string>
 // Project header files
 #include "Command.hpp"
+#include "Canvas.hpp"
 #include "App.hpp"
 using namespace std;
 
 // Represents the command to color a single pixel
 class ClearScreen : public Command {
 private:
-    sf::Image *m_image{};
+    Canvas *m_image{};
 
     static string generateCommandDescription(sf::Color prevColor, sf::Color newColor);
 
@@ -25,8 +26,9 @@ public:
     // Construct ClearScreen from App values
     explicit ClearScreen(App *app);
 
-    // Construct ClearScreen with selected color as the new color
-    ClearScreen(sf::Image *image, sf::Color prevColor, sf::Color newColor);
+    // Construct ClearScreen with selected color as the new color. The previous colour is premultiplied,
+    // as the canvas keeps it.
+    ClearScreen(Canvas *image, sf::Color prevColor, sf::Color newColor);
 
     //Destructor
     ~ClearScreen() override;
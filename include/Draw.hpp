@@ -17,13 +17,14 @@
 #include <SFML/Network.hpp>
 // Project header files
 #include "Command.hpp"
+#include "Canvas.hpp"
 #include "App.hpp"
 using namespace std;
 
 // Represents the command to color a single pixel
 class Draw : public Command {
 private:
-    sf::Image *m_image{};
+    Canvas *m_image{};
 
     static string
     generateCommandDescription(unsigned int posX, unsigned int posY, sf::Color prevColor, sf::Color newColor);
@@ -35,10 +36,10 @@ public:
     explicit Draw(App *app);
 
     // Grab prevColor from image
-    Draw(sf::Image *image, unsigned int posX, unsigned int posY, sf::Color newColor);
+    Draw(Canvas *image, unsigned int posX, unsigned int posY, sf::Color newColor);
 
     // Default constructor
-    Draw(sf::Image *image, unsigned int posX, unsigned int posY, sf::Color prevColor, sf::Color newColor);
+    Draw(Canvas *image, unsigned int posX, unsigned int posY, sf::Color prevColor, sf::Color newColor);
 
     ~Draw() override;
 
@@ -48,7 +49,7 @@ public:
 
     bool undo() override;
 
-    sf::Image *getImage();
+    Canvas *getImage();
 
     // These are safe to expose without a getter/setter because they are constant
     const unsigned int m_posX;
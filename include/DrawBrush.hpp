@@ -10,23 +10,35 @@
 // Include standard library C++ libraries.
 #include <string>
 #include <vector>
+#include <map>
 // Project header files
 #include "Command.hpp"
+#include "Canvas.hpp"
+#include "Blend.hpp"
 using namespace std;
 
 class DrawBrush : public Command {
 private:
-    sf::Image *m_image{};
+    Canvas *m_image{};
 
     static string
     generateCommandDescription(unsigned int posX, unsigned int posY, unsigned int rad, sf::Color newColor);
 
+    // Anti-aliased coverage masks already worked out, by radius and sub-pixel phase. See getMask.
+    static map<unsigned int, vector<sf::Uint8>> s_masks;
+
+    // Coverage of each pixel of the dab's square, row by row, for a centre offset by a sub-pixel phase
+    static const vector<sf::Uint8> &getMask(unsigned int radius, unsigned int subX, unsigned int subY);
+    static unsigned int squareRoot(sf::Uint64 value);
+
 public:
     // Construct DrawBrush from App values
     DrawBrush(App *app);
 
-    // Construct DrawBrush with given new color and radius
-    DrawBrush(sf::Image *image, unsigned int posX, unsigned int posY, unsigned int rad, sf::Color newColor);
+    // Construct DrawBrush with given new color and radius, blended at an opacity from 0 to 255.
+    // The centre may sit subX and subY steps of 1 / SUBPIXEL_STEPS right of and below the pixel's centre.
+    DrawBrush(Canvas *image, unsigned int posX, unsigned int posY, unsigned int rad, sf::Color newColor,
+              sf::Uint8 opacity = 255, BlendMode mode = BLEND_NORMAL, sf::Uint8 subX = 0, sf::Uint8 subY = 0);
 
     //Destructor
     ~DrawBrush() override;
@@ -36,14 +48,24 @@ public:
     bool execute() override;
     bool undo() override;
 
-    sf::Image *getImage();
+    Canvas *getImage() const;
 
     // These are safe to expose without a getter/setter because they are constant
     const unsigned int m_posX;
     const unsigned int m_posY;
     const unsigned int m_radius;
-    vector<vector<sf::Color>> m_prevColors;
+    // Colours under the dab's square before it was drawn, row by row like its mask
+    vector<sf::Color> m_prevColors;
     const sf::Color m_newColor;
+    const sf::Uint8 m_opacity;
+    const BlendMode m_mode;
+    const sf::Uint8 m_subX;
+    const sf::Uint8 m_subY;
+
+    // Dab centres are placed to a quarter of a pixel
+    unsigned static int const SUBPIXEL_BITS = 2, SUBPIXEL_STEPS = 1 << SUBPIXEL_BITS;
+    // Distances are worked out in 1 / 256 of a pixel
+    unsigned static int const FIXED_BITS = 8, FIXED_ONE = 1 << FIXED_BITS;
 };
 
 #endif
@@ -17,13 +17,14 @@
 #include <SFML/Network.hpp>
 // Project header files
 #include "Command.hpp"
+#include "Canvas.hpp"
 #include "App.hpp"
 using namespace std;
 
 // Represents the command to color a single pixel
 class Eraser : public Command {
 private:
-    sf::Image *m_image{};
+    Canvas *m_image{};
 
     static string generateCommandDescription_a(unsigned int posX, unsigned int posY, unsigned int rad,
                                                sf::Color prevColor, sf::Color newColor);
@@ -36,10 +37,10 @@ public:
     explicit Eraser(App *app);
 
     // Grab prevColor from image
-    Eraser(sf::Image *image, unsigned int posX, unsigned int posY, unsigned int rad, sf::Color newColor);
+    Eraser(Canvas *image, unsigned int posX, unsigned int posY, unsigned int rad, sf::Color newColor);
 
     // Default constructor
-    Eraser(sf::Image *image, unsigned int posX, unsigned int posY, unsigned int rad, sf::Color prevColor,
+    Eraser(Canvas *image, unsigned int posX, unsigned int posY, unsigned int rad, sf::Color prevColor,
            sf::Color newColor);
 
     ~Eraser() override;
@@ -49,7 +50,7 @@ public:
     bool execute() override;
     bool undo() override;
 
-    sf::Image *getImage();
+    Canvas *getImage();
 
     // These are safe to expose without a getter/setter because they are constant
     const unsigned int m_posX;
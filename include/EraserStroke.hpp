@@ -37,6 +37,8 @@ public:
     bool execute() override;
     bool undo() override;
     [[maybe_unused]] void addAndExecuteCommand(Command *c) override;
+    // Add an Eraser that is already on the canvas without erasing again, so the next one is interpolated from it
+    void continueFrom(const Eraser &erased);
 
     // Returns a copy of the draws currently in this EraserStroke
     deque<Eraser> getErasers();
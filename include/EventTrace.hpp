@@ -0,0 +1,77 @@
+/**
+ *  @file   EventTrace.hpp
+ *  @brief  Writes spans and flows as Chrome trace events, for viewing clients and the server on one timeline.
+ *  @author Ellah
+ *  @date   2021-12-23
+ ***********************************************/
+#ifndef EVENTTRACE_HPP
+#define EVENTTRACE_HPP
+
+// Include our Third-Party SFML Header
+#include <SFML/System.hpp>
+
+// Include standard library C++ libraries.
+#include <string>
+#include <fstream>
+#include <mutex>
+#include <atomic>
+using namespace std;
+
+// Where a message is on its way from its sender, through the server, to everyone else
+enum FlowPhase {
+    FLOW_SENT, FLOW_RELAYED, FLOW_APPLIED
+};
+
+// Writes the trace of this process, in the JSON array format chrome://tracing and Perfetto read. Times
+// are wall clock microseconds, so the traces of processes on the same machine line up. Every event is
+// on its own line after the opening bracket, so traces are merged by keeping the first one whole and
+// the others without their first line.
+//
+// A message is followed across processes by flow events named after its sender and its number among
+// the messages that sender sent. Each process counts those itself, in the order the server relays them.
+class EventTrace {
+private:
+    static mutex s_mutex;
+    static ofstream s_file;
+    static atomic<bool> s_enabled;
+    static sf::Uint32 s_process;
+    // Events written since the file was last flushed
+    static unsigned int s_unflushed;
+
+    static void write(const string &event);
+    static string escape(const string &text);
+
+public:
+    // Events written between two flushes
+    unsigned static int const FLUSH_INTERVAL = 256;
+
+    // Starts tracing to a file, replacing it. The process name is shown in the viewer.
+    static bool start(const string &path, const string &process);
+    // Ends the trace and closes the file
+    static void stop();
+    static bool isEnabled();
+
+    // Microseconds since the epoch
+    static sf::Int64 now();
+    // A small number identifying the calling thread, the same for all its events
+    static sf::Uint32 getThread();
+
+    // Writes a span of the calling thread
+    static void span(const char *name, const char *category, sf::Int64 start, sf::Int64 duration);
+    // Writes a step of a message's way, inside the span the calling thread has open
+    static void flow(FlowPhase phase, const string &sender, unsigned long index);
+};
+
+// Writes a span from its construction to its destruction while tracing
+class TraceSpan {
+private:
+    const char *m_name;
+    const char *m_category;
+    sf::Int64 m_start;
+
+public:
+    TraceSpan(const char *name, const char *category);
+    ~TraceSpan();
+};
+
+#endif
@@ -0,0 +1,89 @@
+/**
+ *  @file   FloodFill.hpp
+ *  @brief  Paint bucket, fills the area around a pixel that has its colour.
+ *  @author Ellah
+ *  @date   2021-12-25
+ ***********************************************/
+#ifndef FLOODFILL_HPP
+#define FLOODFILL_HPP
+
+// Include standard library C++ libraries.
+#include <string>
+#include <vector>
+// Project header files
+#include "Command.hpp"
+#include "Canvas.hpp"
+#include "App.hpp"
+using namespace std;
+
+// Pixels of a row a fill painted over that all had the same colour before
+struct FillSpan {
+    sf::Uint16 x, y, length;
+    sf::Color color;
+};
+
+// A pixel of a row to fill from, found next to the span painted on the row dy above or below it. That
+// span covered left up to right, so those pixels of the row need no looking at again.
+struct FillSeed {
+    unsigned int x, y, left, right;
+    int dy;
+};
+
+// Fills the pixels connected to a seed pixel, above, below, left or right, whose colour is within a
+// tolerance of the seed's on every channel. Works a row at a time on the canvas's spans, keeping a stack
+// of seeds for the rows above and below, and keeps only the spans it painted over for undo. Only the seed
+// is sent over the network, every client fills its own canvas from it.
+class FloodFill : public Command {
+private:
+    Canvas *m_image{};
+    // Colour painted, premultiplied like the canvas, and the seed's colour before the fill
+    sf::Color m_fill;
+    sf::Color m_target;
+    // Pixels already filled, row by row. Only kept when the fill colour is within the tolerance, as
+    // otherwise filled pixels no longer match.
+    vector<bool> m_filled;
+    vector<FillSpan> m_spans;
+
+    static string generateCommandDescription(unsigned int posX, unsigned int posY, sf::Color newColor);
+
+    bool matches(sf::Color color) const;
+    // Returns how many of count pixels from x of row y, read from span or blank if nullptr, are inside the fill
+    // or outside it, like inside. Counts from the last pixel down if backwards.
+    unsigned int measure(const sf::Color *span, unsigned int x, unsigned int y, unsigned int count, bool inside,
+                         bool backwards) const;
+    // Returns the first x from x up to limit where the pixel is inside the fill or not, unlike inside
+    unsigned int skip(unsigned int x, unsigned int y, unsigned int limit, bool inside) const;
+    // Returns the first x of the run of pixels inside the fill that ends at x
+    unsigned int extendLeft(unsigned int x, unsigned int y) const;
+    void fillSpan(unsigned int left, unsigned int right, unsigned int y);
+    void addSpan(unsigned int x, unsigned int y, unsigned int length, sf::Color color);
+    // Adds a seed for each run of pixels inside the fill on row y from start up to end, found next to the
+    // span from left up to right
+    void addSeeds(vector<FillSeed> &seeds, unsigned int start, unsigned int end, unsigned int y, int dy,
+                  unsigned int left, unsigned int right) const;
+
+public:
+    // Construct FloodFill from App values
+    explicit FloodFill(App *app);
+
+    FloodFill(Canvas *image, unsigned int posX, unsigned int posY, sf::Color newColor, sf::Uint8 tolerance = 0);
+
+    //Destructor
+    ~FloodFill() override;
+
+    bool operator==(Command &cmd) const override;
+
+    bool execute() override;
+    bool undo() override;
+
+    // What the last execute painted over
+    const vector<FillSpan> &getSpans() const;
+
+    // These are safe to expose without a getter/setter because they are constant
+    const unsigned int m_posX;
+    const unsigned int m_posY;
+    const sf::Color m_newColor;
+    const sf::Uint8 m_tolerance;
+};
+
+#endif
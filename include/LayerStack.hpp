@@ -0,0 +1,89 @@
+/**
+ *  @file   LayerStack.hpp
+ *  @brief  Ordered layers drawn on by commands, composited into the canvas shown.
+ *  @author Ellah
+ *  @date   2021-12-19
+ ***********************************************/
+#ifndef LAYERSTACK_HPP
+#define LAYERSTACK_HPP
+
+// Include our Third-Party SFML header
+#include <SFML/Graphics.hpp>
+
+// Include standard library C++ libraries.
+#include <string>
+#include <vector>
+#include <map>
+// Project header files
+#include "Canvas.hpp"
+using namespace std;
+
+// A fixed number of layers of the same size, the first at the bottom. The bottom layer is filled with the
+// background colour, the ones above are transparent until painted, and as every layer is a sparse Canvas
+// an unused one costs only its tile table. Commands draw on one layer, so erasing a layer above shows the
+// layers below it and clearing a layer leaves the others alone.
+//
+// Each user draws on the layer they last selected, like their palette this is kept by username. Which
+// layers are shown and how opaque they are is up to each client.
+//
+// The composite of the visible layers is kept as another Canvas, and each time it is asked for only the
+// tiles a layer changed since are composited again.
+class LayerStack {
+private:
+    vector<Canvas> m_layers;
+    vector<bool> m_visible;
+    vector<sf::Uint8> m_opacity;
+    // Layer each user draws on, by username
+    map<string, unsigned int> m_selected;
+    // The visible layers blended together, up to date except for the tiles the layers still list as changed
+    Canvas m_composite;
+    // Set when every tile must be composited again, e.g. after a layer was hidden
+    bool m_recomposite;
+    // Kept between calls to composite so their memory is reused: the tiles to composite, one tile's
+    // blended pixels and a blank layer's coverage
+    vector<unsigned int> m_changedTiles;
+    vector<sf::Color> m_pixels;
+    vector<sf::Uint8> m_coverage;
+
+    sf::Color getCompositeBackground() const;
+    void compositeTile(unsigned int column, unsigned int row);
+
+public:
+    unsigned static constexpr int LAYER_COUNT = 4;
+
+    LayerStack();
+
+    // Starts over with blank layers of the given size
+    void create(unsigned int width, unsigned int height, sf::Color background);
+
+    // Copies the other stack's layers and selections, keeping which layers are shown and how
+    void assign(const LayerStack &other);
+
+    // Like assign, but only copies the tiles whose version differs from the other stack's, so only those are
+    // composited again. Copies everything if the layers differ in size or background.
+    void assignChanged(const LayerStack &other);
+
+    // Returns the visible layers blended together, compositing the tiles that changed first. Like every
+    // layer, its pixels are premultiplied.
+    Canvas &composite();
+
+    // Makes a user's following commands draw on the given layer. Layers that do not exist are ignored.
+    void select(const string &username, unsigned int layer);
+
+    // Colour erasing paints on a layer, the background on the bottom one and transparent above it
+    static sf::Color getEraseColor(unsigned int layer, sf::Color background);
+
+    //Getters
+    Canvas &getLayer(unsigned int layer);
+    const Canvas &getLayer(unsigned int layer) const;
+    unsigned int getSelected(const string &username) const;
+    bool isVisible(unsigned int layer) const;
+    sf::Uint8 getOpacity(unsigned int layer) const;
+    sf::Vector2u getSize() const;
+
+    //Setters
+    void setVisible(unsigned int layer, bool visible);
+    void setOpacity(unsigned int layer, sf::Uint8 opacity);
+};
+
+#endif
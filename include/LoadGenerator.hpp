@@ -0,0 +1,103 @@
+/**
+ *  @file   LoadGenerator.hpp
+ *  @brief  Simulated clients drawing against a server, measuring how fast it relays.
+ *  @author Ellah
+ *  @date   2021-12-21
+ ***********************************************/
+#ifndef LOADGENERATOR_HPP
+#define LOADGENERATOR_HPP
+
+// Include our Third-Party SFML Header
+#include <SFML/Network.hpp>
+
+// Include standard library C++ libraries.
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+// Project header files
+#include "TCPClient.hpp"
+#include "TCPServer.hpp"
+#include "Palette.hpp"
+using namespace std;
+
+// What the simulated clients do
+struct LoadSettings {
+    unsigned int clients = 8;
+    // Messages each client sends per second, a stroke being its start, its dabs and its end
+    float rate = 60;
+    sf::Time duration = sf::seconds(10);
+    // Dabs in each generated stroke
+    unsigned int strokeLength = 32;
+    unsigned int radius = 4;
+    // Server to load. Without one, a server is started on the local address in this process.
+    sf::IpAddress server = sf::IpAddress::None;
+    unsigned short port = 8100;
+    // Strokes to replay instead of generated ones, each client starting at a different one
+    vector<vector<sf::Vector2i>> strokes;
+};
+
+// What was measured, times in microseconds
+struct LoadReport {
+    // Time each client took to connect and join
+    vector<sf::Int64> joins;
+    // Time from a message being sent to another client receiving it, sorted
+    vector<sf::Int64> latencies;
+    // Messages sent, and copies of them received by the other clients
+    unsigned long sent = 0, received = 0;
+    // How long sending and receiving took, up to the last copy received
+    sf::Int64 elapsed = 0;
+
+    // The latency below which the given fraction of them are, 0 without any
+    sf::Int64 getLatency(double fraction) const;
+    // Copies received per second
+    double getThroughput() const;
+    // Number of latencies of each bit length, so bucket i holds the ones from 2^(i-1) up to 2^i - 1
+    vector<unsigned long> getHistogram() const;
+};
+
+// Joins a number of clients to a server, has each of them draw strokes at a fixed rate and times how
+// long the others take to receive each message. All clients are driven from the calling thread.
+class LoadGenerator {
+private:
+    // One simulated client
+    struct Simulated {
+        TCPClient *client;
+        Palette palette;
+        // When each message it sent left, in order
+        vector<sf::Int64> sendTimes;
+        sf::Int64 nextSend;
+        // Stroke being drawn, and the message of it to send next
+        unsigned int stroke;
+        unsigned int step;
+        // Messages received from each of the others, which the server relays in the order they were sent
+        map<string, unsigned long> receivedFrom;
+    };
+
+    LoadSettings m_settings;
+    vector<Simulated> m_simulated;
+    map<string, unsigned int> m_indices;
+    // Started when no server was given, and the thread it runs in
+    TCPServer *m_server;
+    thread m_serverThread;
+    sf::Clock m_clock;
+
+    void startServer();
+    void stopServer();
+    void generateStrokes();
+    void sendNext(Simulated &simulated, LoadReport &report);
+    // Hands out everything the clients received, returns whether there was anything
+    bool receive(LoadReport &report);
+
+public:
+    // Longest wait for the last copies once sending stopped
+    unsigned static int const DRAIN_TIMEOUT_MS = 5000;
+
+    explicit LoadGenerator(LoadSettings settings);
+    ~LoadGenerator();
+
+    // Joins the clients, runs for the set duration and returns what was measured
+    LoadReport run();
+};
+
+#endif
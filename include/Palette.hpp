@@ -0,0 +1,62 @@
+/**
+ *  @file   Palette.hpp
+ *  @brief  Colour table one user's messages are encoded with.
+ *  @author Ellah
+ *  @date   2021-12-17
+ ***********************************************/
+#ifndef PALETTE_HPP
+#define PALETTE_HPP
+
+// Include our Third-Party SFML header
+#include <SFML/Graphics.hpp>
+#include <SFML/Network.hpp>
+
+// Include standard library C++ libraries.
+#include <unordered_map>
+using namespace std;
+
+// A colour travels as a single byte indexing the sender's palette. The preset colours are entries 1 to 8.
+// The first time a sender uses any other colour it gives it the next free entry and sends the entry
+// number with DEFINE set, followed by the colour as packed RGBA. Receivers keep one palette per sender
+// and learn the entry from that message, so later messages with the colour are as small as before.
+// Once the palette is full, colours are sent as LITERAL followed by packed RGBA.
+//
+// Entries are only ever defined in the sender's message order, which the server keeps, so every client
+// ends with the same palette for a given sender, including clients that join or resume later.
+class Palette {
+public:
+    // Code for a colour that follows as packed RGBA and is not kept
+    sf::Uint8 static constexpr LITERAL = 0;
+    // Flag on an entry number meaning the entry is defined as the packed RGBA that follows
+    sf::Uint8 static constexpr DEFINE = 0x80;
+    // Number of entries, every entry number is below DEFINE
+    sf::Uint8 static constexpr SIZE = DEFINE;
+
+private:
+    // Colour of each of the SIZE entries, unknown entries read as black
+    sf::Color m_colors[SIZE];
+    // Entry of each colour, by packed RGBA
+    unordered_map<sf::Uint32, sf::Uint8> m_entries;
+    // Next entry to define
+    sf::Uint8 m_next;
+
+    void define(sf::Uint8 entry, sf::Color color);
+
+public:
+    // Starts with the preset colours
+    Palette();
+
+    // Writes the colour to the packet, defining a new entry for it if needed
+    void write(sf::Packet &packet, sf::Color color);
+
+    // Reads a colour written by this palette's owner, learning any entry it defines
+    sf::Color read(sf::Packet &packet);
+
+    // Copies one colour from a packet to another without decoding it
+    static void relay(sf::Packet &from, sf::Packet &to);
+
+    //Getters
+    sf::Uint8 getSize() const;
+};
+
+#endif
@@ -0,0 +1,119 @@
+/**
+ *  @file   Profiler.hpp
+ *  @brief  Times the stages of the App's frames and keeps the last few seconds of them.
+ *  @author Ellah
+ *  @date   2021-12-23
+ ***********************************************/
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+// Include our Third-Party SFML Header
+#include <SFML/System.hpp>
+
+// Include standard library C++ libraries.
+#include <vector>
+using namespace std;
+
+// Parts of a frame that are timed, in microseconds. Some happen inside others, e.g. uploading
+// happens while drawing, so they do not add up to the frame.
+enum ProfileStage {
+    // From the start of a frame to its end, without the idle wait
+    PROFILE_FRAME,
+    // Handing window events to the GUI
+    PROFILE_INPUT,
+    // Laying out the GUI
+    PROFILE_LAYOUT,
+    // The update function, which also drains the network
+    PROFILE_UPDATE,
+    // The draw function, which also uploads the canvas tiles
+    PROFILE_DRAW,
+    PROFILE_UPLOAD,
+    // Drawing the canvas and GUI into the windows, then showing them
+    PROFILE_RENDER,
+    PROFILE_DISPLAY,
+    // Executing, undoing and redoing commands, ours or anyone's
+    PROFILE_COMMANDS,
+    // Receiving messages from the server
+    PROFILE_NETWORK,
+    PROFILE_STAGE_COUNT
+};
+
+// Quantities sampled once a frame
+enum ProfileCounter {
+    // Bytes of canvas tiles uploaded to the GPU during the frame
+    PROFILE_UPLOAD_BYTES,
+    // Messages received but not yet applied
+    PROFILE_INBOX,
+    // Commands of ours the server has not ordered yet, see Reconciler
+    PROFILE_PENDING,
+    PROFILE_COUNTER_COUNT
+};
+
+// The values of one stage or counter over the last HISTORY_FRAMES frames
+struct ProfileSeries {
+    // Oldest overwritten first, next is where the frame in progress goes
+    vector<sf::Int64> samples;
+    unsigned long next = 0;
+    // Value of the frame in progress
+    sf::Int64 current = 0;
+};
+
+class Profiler {
+private:
+    ProfileSeries m_stages[PROFILE_STAGE_COUNT];
+    ProfileSeries m_counters[PROFILE_COUNTER_COUNT];
+    // Scopes of each stage currently open, only the outermost one is timed
+    unsigned int m_depth[PROFILE_STAGE_COUNT];
+    // Frames ended so far
+    unsigned long m_frames;
+
+    static void push(ProfileSeries &series);
+    static vector<sf::Int64> getHistory(const ProfileSeries &series);
+
+public:
+    // Frames kept, a few seconds of them
+    unsigned static constexpr int HISTORY_FRAMES = 128;
+    static const char *const STAGE_NAMES[PROFILE_STAGE_COUNT];
+
+    Profiler();
+
+    // Adds time spent in a stage, or an amount to a counter, during the frame in progress
+    void add(ProfileStage stage, sf::Int64 microseconds);
+    void add(ProfileCounter counter, sf::Int64 amount);
+    // Sets a counter of the frame in progress
+    void set(ProfileCounter counter, sf::Int64 value);
+    // Opens a scope of a stage, returns true unless one is open already
+    bool enter(ProfileStage stage);
+    // Closes a scope of a stage, adding its time if it was the outermost
+    void leave(ProfileStage stage, sf::Int64 microseconds);
+    // Keeps the frame in progress and starts the next
+    void endFrame();
+
+    unsigned long getFrames() const;
+    // A stage's or counter's values over the frames kept, oldest first
+    vector<sf::Int64> getHistory(ProfileStage stage) const;
+    vector<sf::Int64> getHistory(ProfileCounter counter) const;
+    // The last frame's value of a counter
+    sf::Int64 getLast(ProfileCounter counter) const;
+    sf::Int64 getAverage(ProfileStage stage) const;
+    // The time below which the given fraction of the frames kept spent in the stage, by nearest rank
+    sf::Int64 getPercentile(ProfileStage stage, double fraction) const;
+    // The number of frames kept whose time in the stage has each bit length, like LoadReport
+    vector<unsigned long> getHistogram(ProfileStage stage) const;
+};
+
+// Times a stage from its construction to its destruction, or nothing without a profiler. Scopes of a
+// stage opened inside another of the same stage, e.g. a redo applied as a received command, are not
+// counted twice.
+class ProfileScope {
+private:
+    Profiler *m_profiler;
+    ProfileStage m_stage;
+    sf::Clock m_clock;
+
+public:
+    ProfileScope(Profiler *profiler, ProfileStage stage);
+    ~ProfileScope();
+};
+
+#endif
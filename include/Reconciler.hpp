@@ -0,0 +1,83 @@
+/**
+ *  @file   Reconciler.hpp
+ *  @brief  Keeps the canvas in the server's order while drawing locally without waiting for it.
+ *  @author Ellah
+ *  @date   2021-12-16
+ ***********************************************/
+#ifndef RECONCILER_HPP
+#define RECONCILER_HPP
+
+// Include our Third-Party SFML header
+#include <SFML/Graphics.hpp>
+#include <SFML/Network.hpp>
+
+// Include standard library C++ libraries.
+#include <string>
+#include <deque>
+#include <stack>
+#include <map>
+// Project header files
+#include "Command.hpp"
+#include "Canvas.hpp"
+#include "LayerStack.hpp"
+#include "CompositeCommand.hpp"
+#include "Palette.hpp"
+using namespace std;
+
+// The server's sequence numbers decide the order every client applies commands in. Local commands are
+// drawn straight away and remembered here until the server sequences them. A remote command that arrives
+// first is ordered before them, so it is applied to the authoritative base canvas and the local commands
+// are drawn again over it. Every client therefore ends with the same canvas.
+class Reconciler {
+private:
+    // Our username, the server acknowledges our own commands instead of sending them back
+    string m_username;
+    // Colour erasers paint with
+    sf::Color m_background;
+    // Layers with every command the server has sequenced, in that order
+    LayerStack m_base;
+    // Strokes in progress on m_base, by username
+    map<string, CompositeCommand *> m_strokes;
+    // Commands applied to m_base, most recent first, and the commands undone from it
+    deque<Command *> m_commands;
+    stack<Command *> m_undo;
+    // Packets for local commands that are on screen but not yet sequenced by the server, oldest first
+    deque<sf::Packet> m_pending;
+    // Colour table of each user. Reading an entry definition twice gives the same entry, so the same
+    // tables serve the base canvas and the rebuilt screen.
+    map<string, Palette> m_palettes;
+
+    // Applies a command packet to the given layers, keeping strokes and undo history in the given containers
+    static void apply(sf::Packet packet, LayerStack *layers, sf::Color background, map<string, Palette> &palettes,
+                      map<string, CompositeCommand *> &strokes, deque<Command *> &commands, stack<Command *> &undo);
+
+public:
+    // Reads the drawing command in a packet from username, after its header and username, onto the layer they
+    // selected. Returns nullptr for messages that do not draw, such as strokes, layers, undo and redo.
+    static Command *decodeCommand(sf::Uint8 header, const string &username, sf::Packet &packet, LayerStack &layers,
+                                  sf::Color background, Palette &palette);
+
+    // Starts from the given layers and colour tables, as if the server had sequenced everything on them
+    Reconciler(string username, const LayerStack &layers, sf::Color background, map<string, Palette> palettes);
+
+    ~Reconciler();
+
+    // Remember a local command that has been drawn and sent to the server
+    void addLocal(const sf::Packet &packet);
+
+    // The server sequenced our oldest pending command. Returns true if the screen must be rebuilt.
+    bool commitLocal();
+
+    // Apply a command from another client. Returns true if the screen must be rebuilt, otherwise
+    // the command can be drawn on screen as usual.
+    bool addRemote(const sf::Packet &packet);
+
+    // Redraw the screen as the base layers with our pending commands on top
+    void rebuild(LayerStack &layers);
+
+    //Getters
+    const LayerStack &getBase() const;
+    unsigned long getPendingCount() const;
+};
+
+#endif
@@ -0,0 +1,66 @@
+/**
+ *  @file   Selection.hpp
+ *  @brief  Moves or copies a rectangle of the canvas as a single command.
+ *  @author Ellah
+ *  @date   2021-12-27
+ ***********************************************/
+#ifndef SELECTION_HPP
+#define SELECTION_HPP
+
+// Include standard library C++ libraries.
+#include <string>
+#include <vector>
+// Project header files
+#include "Command.hpp"
+#include "Canvas.hpp"
+using namespace std;
+
+// Moves or copies the pixels of a rectangle by an offset, which is all that is sent over the network. Rows
+// are copied whole with memcpy, and when the rectangle and the offset line up with the tiles the tiles
+// themselves are moved instead, so blank tiles stay blank. Only the pixels that were under the destination
+// are kept for undo, as the ones moved away are still at the destination. Pixels that would land off the
+// canvas stay where they are.
+class Selection : public Command {
+private:
+    Canvas *m_image{};
+    // The part of the rectangle that is moved, on the canvas and landing on it. Worked out on execute.
+    unsigned int m_sourceX, m_sourceY, m_movedWidth, m_movedHeight;
+    unsigned int m_targetX, m_targetY;
+    // Whether whole tiles are moved, then m_prevTiles keeps the tiles under the destination row by row,
+    // otherwise m_prevColors keeps their pixels
+    bool m_tiles;
+    vector<sf::Color> m_prevColors;
+    vector<vector<sf::Color>> m_prevTiles;
+
+    static string generateCommandDescription(unsigned int left, unsigned int top, unsigned int width,
+                                             unsigned int height, int offsetX, int offsetY, bool move);
+
+    // Clips the rectangle, returns false if nothing of it lands on the canvas
+    bool clip();
+    bool alignedWithTiles() const;
+
+    // Moves or copies whole tiles, or rows of pixels
+    void executeTiles();
+    void executeRows();
+
+public:
+    Selection(Canvas *image, unsigned int left, unsigned int top, unsigned int width, unsigned int height,
+              int offsetX, int offsetY, bool move, sf::Color eraseColor);
+
+    //Destructor
+    ~Selection() override;
+
+    bool operator==(Command &cmd) const override;
+
+    bool execute() override;
+    bool undo() override;
+
+    // These are safe to expose without a getter/setter because they are constant
+    const unsigned int m_left, m_top, m_width, m_height;
+    const int m_offsetX, m_offsetY;
+    // Whether the pixels are moved rather than copied, and the colour left behind if so
+    const bool m_move;
+    const sf::Color m_eraseColor;
+};
+
+#endif
@@ -0,0 +1,54 @@
+/**
+ *  @file   ServerMetrics.hpp
+ *  @brief  Counters of a server's traffic, for capacity alerts.
+ *  @author Ellah
+ *  @date   2021-12-24
+ ***********************************************/
+#ifndef SERVERMETRICS_HPP
+#define SERVERMETRICS_HPP
+
+// Include our Third-Party SFML Header
+#include <SFML/System.hpp>
+
+// Include standard library C++ libraries.
+#include <string>
+#include <map>
+using namespace std;
+
+// What one client sent the server and was sent by it, kept after it leaves
+struct ClientMetrics {
+    unsigned long messagesIn = 0;
+    unsigned long bytesIn = 0;
+    unsigned long messagesOut = 0;
+    unsigned long bytesOut = 0;
+    // Sends that did not go through, e.g. because the client was gone
+    unsigned long sendFailures = 0;
+    // Messages relayed to the client that it has not acknowledged yet, while it is connected. Sends
+    // block, so these are what is still on its way or waiting to be drawn rather than queued here.
+    unsigned long unacknowledged = 0;
+};
+
+// Everything the server counted since it started, plus its history and clients when taken
+struct ServerMetrics {
+    unsigned long accepts = 0;
+    unsigned long disconnects = 0;
+    unsigned long messagesIn = 0;
+    unsigned long bytesIn = 0;
+    unsigned long messagesOut = 0;
+    unsigned long bytesOut = 0;
+    // Commands sent to everyone else, the time that took in all and the slowest one, in microseconds
+    unsigned long broadcasts = 0;
+    sf::Int64 broadcastTime = 0;
+    sf::Int64 slowestBroadcast = 0;
+    unsigned long clients = 0;
+    unsigned long historySize = 0;
+    unsigned long historyBytes = 0;
+    // By username
+    map<string, ClientMetrics> perClient;
+
+    // One line for the server and one per client, in the InfluxDB line protocol with a time in
+    // nanoseconds since the epoch
+    string toLineProtocol(const string &server, sf::Int64 time) const;
+};
+
+#endif
@@ -0,0 +1,69 @@
+/**
+ *  @file   SessionRecorder.hpp
+ *  @brief  Records the messages of a session to a file, for replaying it later.
+ *  @author Ellah
+ *  @date   2021-12-22
+ ***********************************************/
+#ifndef SESSIONRECORDER_HPP
+#define SESSIONRECORDER_HPP
+
+// Include our Third-Party SFML Header
+#include <SFML/Network.hpp>
+
+// Include standard library C++ libraries.
+#include <string>
+#include <vector>
+#include <fstream>
+using namespace std;
+
+// Where a recorded message came from
+enum TraceKind : sf::Uint8 {
+    // Sent by the local user, who drew it straight away
+    TRACE_LOCAL,
+    // Received from the server by a client, or from a client by the server and relayed
+    TRACE_RECEIVED
+};
+
+// One recorded message, without the server's sequence number
+struct TraceEntry {
+    TraceKind kind;
+    // Microseconds since recording started
+    sf::Int64 time;
+    sf::Packet packet;
+};
+
+// A trace starts with MAGIC and VERSION. Each entry is its kind byte, the microseconds since the entry
+// before it and the message size, both as variable length integers of 7 bits per byte, then the message.
+// Most entries therefore take 3 or 4 bytes more than the message.
+class SessionRecorder {
+private:
+    ofstream m_file;
+    sf::Clock m_clock;
+    // Time of the last entry written
+    sf::Int64 m_last;
+    // Entries written since the file was last flushed
+    unsigned int m_unflushed;
+
+    void writeNumber(sf::Uint64 value);
+    static bool readNumber(istream &in, sf::Uint64 &value);
+
+public:
+    static constexpr char MAGIC[4] = {'C', 'P', 'T', 'R'};
+    sf::Uint8 static constexpr VERSION = 1;
+    // Entries written between two flushes, so a crash loses at most this many
+    unsigned static int const FLUSH_INTERVAL = 64;
+
+    // Starts recording to the file, replacing it
+    explicit SessionRecorder(const string &path);
+    ~SessionRecorder();
+
+    bool isOpen() const;
+    // Writes a message, timed from when recording started
+    void record(TraceKind kind, const sf::Packet &packet);
+
+    // Reads every entry of a trace. Returns false if it is not a trace or ends part way through an entry,
+    // the entries before that are still read.
+    static bool load(const string &path, vector<TraceEntry> &entries);
+};
+
+#endif
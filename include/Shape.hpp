@@ -0,0 +1,112 @@
+/**
+ *  @file   Shape.hpp
+ *  @brief  Lines, rectangles and ellipses, each drawn as a single command.
+ *  @author Ellah
+ *  @date   2021-12-26
+ ***********************************************/
+#ifndef SHAPE_HPP
+#define SHAPE_HPP
+
+// Include standard library C++ libraries.
+#include <string>
+#include <vector>
+// Project header files
+#include "Command.hpp"
+#include "Canvas.hpp"
+#include "Blend.hpp"
+using namespace std;
+
+// Pixels of a row a shape covers, may reach past the canvas
+struct ShapeSpan {
+    int x, y, length;
+};
+
+// A shape between two corners, or two ends for a line, blended with its colour like a brush dab. Subclasses
+// only give the spans of each row they cover. The shape works them out once, clipped to the canvas with no
+// pixel in two spans, keeps the pixels under them when executed and puts those back on undo. A shape is a
+// single command and a single message whatever its size, and costs as much pixel work as it covers.
+class Shape : public Command {
+private:
+    Canvas *m_image{};
+    // Covered pixels of each row, top to bottom and left to right, and the colours under them. Worked
+    // out on the first execute, as rasterize cannot be called while constructing.
+    vector<ShapeSpan> m_spans;
+    vector<sf::Color> m_prevColors;
+    bool m_rasterized;
+
+protected:
+    // Adds the spans the shape covers, in any order and overlapping as they come
+    virtual void rasterize(vector<ShapeSpan> &spans) const = 0;
+
+    static string generateCommandDescription(const char *name, unsigned int x0, unsigned int y0, unsigned int x1,
+                                             unsigned int y1);
+    static unsigned int squareRoot(sf::Uint64 value);
+
+public:
+    // Corners and ends are kept on the canvas's largest size, so the rasterizers' products fit 64 bits
+    Shape(string commandDescription, Canvas *image, unsigned int x0, unsigned int y0, unsigned int x1,
+          unsigned int y1, unsigned int thickness, sf::Color newColor, sf::Uint8 opacity, BlendMode mode, bool filled);
+
+    //Destructor
+    ~Shape() override;
+
+    bool operator==(Command &cmd) const override;
+
+    bool execute() override;
+    bool undo() override;
+
+    // Spans covered once executed
+    const vector<ShapeSpan> &getSpans() const;
+
+    // Makes a shape from a LINE, RECT or ELLIPSE message's values, or returns nullptr for any other header
+    static Shape *create(sf::Uint8 header, Canvas *image, unsigned int x0, unsigned int y0, unsigned int x1,
+                         unsigned int y1, unsigned int thickness, sf::Color newColor, sf::Uint8 opacity,
+                         BlendMode mode, bool filled);
+
+    // These are safe to expose without a getter/setter because they are constant
+    const unsigned int m_x0, m_y0, m_x1, m_y1;
+    // Width of a line or outline in pixels
+    const unsigned int m_thickness;
+    const sf::Color m_newColor;
+    const sf::Uint8 m_opacity;
+    const BlendMode m_mode;
+    // Whether a rectangle or ellipse is filled rather than outlined
+    const bool m_filled;
+};
+
+// A straight line of m_thickness pixels, a square of that size stepped along it a pixel at a time
+class Line : public Shape {
+protected:
+    void rasterize(vector<ShapeSpan> &spans) const override;
+
+public:
+    Line(Canvas *image, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, unsigned int thickness,
+         sf::Color newColor, sf::Uint8 opacity = 255, BlendMode mode = BLEND_NORMAL);
+};
+
+// A rectangle with corners on both given pixels
+class Rect : public Shape {
+protected:
+    void rasterize(vector<ShapeSpan> &spans) const override;
+
+public:
+    Rect(Canvas *image, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, unsigned int thickness,
+         sf::Color newColor, sf::Uint8 opacity = 255, BlendMode mode = BLEND_NORMAL, bool filled = false);
+};
+
+// The ellipse fitting in the rectangle with corners on both given pixels, covering the pixels whose centre
+// is inside it. Its outline is what is left out of the ellipse m_thickness pixels smaller on every side.
+class Ellipse : public Shape {
+private:
+    // Sets left and right to the pixels of row y inside the ellipse in the given box, returns false if none
+    static bool getRow(int left, int top, int right, int bottom, int y, int &rowLeft, int &rowRight);
+
+protected:
+    void rasterize(vector<ShapeSpan> &spans) const override;
+
+public:
+    Ellipse(Canvas *image, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, unsigned int thickness,
+            sf::Color newColor, sf::Uint8 opacity = 255, BlendMode mode = BLEND_NORMAL, bool filled = false);
+};
+
+#endif
@@ -16,15 +16,37 @@
 // Other standard libraries
 #include <string>
 #include <vector>
+#include <queue>
 using namespace std;
 
-// DRAWBRUSH   Will also hold the x, y positions, newcolor, and radius
-// CLEARSCREEN Will also hold the newcolor for the background
+// DRAWBRUSH   Will also hold the x, y positions, newcolor (see Palette), radius, opacity and BlendMode
+// CLEARSCREEN Will also hold the newcolor for the background, encoded the same way
 // ERASER      Will also hold the x, y positions
+// NON_COMMAND Sent once on join, the server replies with the whole history
+// ACK         Will also hold the last sequence number the client received. From the server, it tells the
+//             sender the sequence number its command was given instead of sending the command back.
+// RESUME      Will also hold the last sequence number the client received, the server replies with what was missed
+// PRESENCE    Will also hold the x, y cursor position. The server relays only the latest one per client, with the
+//             client's session number instead of its username, and sequence number 0 as it is not part of history.
+// LAYER       Will also hold the layer the sender's following commands draw on, see LayerStack
+// STATS       Asks the server for its metrics, only answered on the server's own machine. The reply has sequence
+//             number 0 and holds them as text, see ServerMetrics.
+// FLOODFILL   Will also hold the x, y seed position, newcolor (see Palette) and tolerance. Receivers fill from the
+//             seed themselves, see FloodFill.
+// LINE        Will also hold the x, y positions of both ends, newcolor (see Palette), thickness, opacity, BlendMode
+//             and whether it is filled, which lines ignore. See Shape.
+// RECT        Will also hold the x, y positions of two corners, then the same as LINE
+// ELLIPSE     Will also hold the x, y positions of two corners of its box, then the same as LINE
+// SELECTION   Will also hold the left, top, width and height of a rectangle, the x, y offset its pixels go by and
+//             whether they are moved rather than copied. Receivers copy from their own canvas, see Selection.
 enum HeaderType : sf::Uint8 {
-    DRAWBRUSH, START_BRUSHSTROKE, END_BRUSHSTROKE, CLEARSCREEN, ERASER, START_ERASERSTROKE, END_ERASERSTROKE, UNDO, REDO, NON_COMMAND
+    DRAWBRUSH, START_BRUSHSTROKE, END_BRUSHSTROKE, CLEARSCREEN, ERASER, START_ERASERSTROKE, END_ERASERSTROKE, UNDO, REDO, NON_COMMAND,
+    ACK, RESUME, PRESENCE, LAYER, STATS, FLOODFILL, LINE, RECT, ELLIPSE, SELECTION
 };
 
+// Cursor position meaning the client left
+sf::Uint16 const PRESENCE_GONE = 0xFFFF;
+
 // Create a non-blocking TCPClient
 class TCPClient {
 
@@ -42,9 +64,39 @@ private:
     // A TCP Socket for our client to create an end-to-end communication
     // with another machine in the world.
     sf::TcpSocket m_socket;
+    // Lets waitForData sleep on the socket
+    sf::SocketSelector m_selector;
     sf::Packet m_packet;
+    // Whether the last send or receive found the connection alive
+    bool m_connected;
+    // Sequence number of the last message relayed to us by the server
+    sf::Uint32 m_lastSequence;
+    // Messages received since our last ACK
+    unsigned int m_unacknowledged;
+    // Messages received from the server but not yet handed out by receiveData
+    queue<sf::Packet> m_inbox;
+    // Messages we tried to send while disconnected, sent again after resuming
+    queue<sf::Packet> m_outbox;
+    // Time since our last reconnect attempt, and whether it still waits for the server to accept it
+    sf::Clock m_reconnectClock;
+    bool m_connecting;
+    // Time since we last sent our cursor position, the position sent and the minimum time between two
+    sf::Clock m_presenceClock;
+    sf::Vector2<sf::Uint16> m_presence;
+    sf::Time m_presenceInterval;
+
+    // Move every message waiting on the socket into m_inbox
+    void pollSocket();
+    // Tell the server the last sequence number we received
+    void acknowledge();
 
 public:
+    // Number of received messages between two ACKs
+    unsigned static int const ACK_INTERVAL = 32;
+    // Minimum time between two reconnect attempts, and how long each may take
+    unsigned static int const RECONNECT_INTERVAL_MS = 250;
+    // Default number of cursor positions sent per second
+    unsigned static int const PRESENCE_RATE = 10;
 
     // Default Constructor
     TCPClient(string username, unsigned short port);
@@ -52,10 +104,17 @@ public:
     ~TCPClient();
     // Handles client attempting to join server
     int joinServer(sf::IpAddress serverAddress, unsigned short serverPort);
+    // Reconnects to the last server joined and asks only for the messages we missed. Returns 0 once resumed,
+    // it does not wait for the connection.
+    int resumeSession();
     // Send data to server
     void sendCommand(sf::Packet packet);
     // Receive data from the server
     sf::Packet receiveData();
+    // Send our cursor position, unless it was sent less than the presence interval ago or has not moved
+    void sendPresence(sf::Uint16 x, sf::Uint16 y);
+    // Sleep until the server sends something or the timeout passes. Returns true if there is data to receive.
+    bool waitForData(sf::Time timeout);
 
     // Check is client is connected to server
     bool diconnected();
@@ -63,8 +122,14 @@ public:
     //Getters
     int getPort() const;
     string getUsername();
+    sf::Uint32 getLastSequence() const;
+    // Messages received but not yet handed out by receiveData
+    unsigned long getInboxSize() const;
     sf::IpAddress getIpAddress();
     sf::TcpSocket *getSocket();
+
+    //Setters
+    void setPresenceRate(unsigned int perSecond);
 };
 
 #endif
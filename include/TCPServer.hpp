@@ -12,11 +12,15 @@
 
 // Our Command library
 #include "Command.hpp"
+#include "SessionRecorder.hpp"
+#include "EventTrace.hpp"
+#include "ServerMetrics.hpp"
 
 // Other standard libraries
 #include <string>
 #include <vector>
 #include <map>
+#include <fstream>
 using namespace std;
 
 // Create a non-blocking TCP server
@@ -25,7 +29,19 @@ class TCPServer {
 private:
 
     // What to do when the client joins the server
-    int joiningClient(sf::TcpSocket *client);
+    int joiningClient(sf::TcpSocket *client, const string &username);
+
+    // What to do when a client reconnects, sends them only what they missed
+    int resumingClient(sf::TcpSocket *client, const string &username, sf::Uint32 lastSequence);
+
+    // Tells the sender of a command which sequence number it was given
+    int acknowledgeCommand(sf::TcpSocket *client, const string &username, sf::Uint32 sequence);
+
+    // Associate a username with the socket it now talks through
+    void registerClient(const string &username, sf::TcpSocket *client);
+
+    // Relay the latest cursor position of every client that moved, at most every PRESENCE_INTERVAL_MS
+    void flushPresence();
 
     // What to do when the client leaves the server
     int removeClient(sf::TcpSocket *socket);
@@ -33,6 +49,18 @@ private:
     // Sends a new packet to all connected clients
     int broadcastCommandPacket(const string &username, sf::Packet packet);
 
+    // Sends a packet to a client, counting it
+    sf::Socket::Status sendTo(const string &username, sf::TcpSocket *client, sf::Packet &packet);
+
+    // Answers a STATS message, if it came from this machine
+    void answerStats(sf::TcpSocket *client);
+
+    // Appends the metrics to the stats file if it is time to
+    void dumpStats();
+
+    // Copies what is left to read of a packet to another as it is
+    static void relayRemainder(sf::Packet &from, sf::Packet &to);
+
     // Information about the server
     int m_status;
     string m_name;
@@ -52,15 +80,44 @@ private:
 
     // A data structure to hold all of the clients.
     map<string, sf::TcpSocket *> m_activeClients;
-    // A data structure to hold all of the packets
-    vector<sf::Packet> m_packetHistory;
+    // A data structure to hold all of the packets, with who sent them.
+    // Every packet starts with its sequence number, which is its index in here plus one.
+    vector<pair<string, sf::Packet>> m_packetHistory;
+    // Sequence number of the last packet relayed
+    sf::Uint32 m_sequence;
+    // Last sequence number each client acknowledged
+    map<string, sf::Uint32> m_acknowledged;
+    // Session number of each client, shorter than its username in presence updates
+    map<string, sf::Uint16> m_sessions;
+    sf::Uint16 m_nextSession;
+    // Latest cursor position of each client not yet relayed, later positions replace earlier ones
+    map<string, sf::Vector2<sf::Uint16>> m_presence;
+    // Time since presence was last relayed
+    sf::Clock m_presenceClock;
     // A data structure to hold all of the messages sent
     vector<Command> m_commandshistory;
+    // Set while the commands relayed are recorded, see SessionRecorder
+    SessionRecorder *m_recorder;
+    // Messages relayed from each user, for following them across processes. See EventTrace.
+    map<string, unsigned long> m_flowCounts;
+    // What was counted so far. The gauges in it are only filled in by getMetrics.
+    ServerMetrics m_metrics;
+    // Bytes of the packets and usernames in m_packetHistory
+    unsigned long m_historyBytes;
+    // Where the metrics are appended every m_statsInterval, while open
+    ofstream m_statsFile;
+    sf::Time m_statsInterval;
+    sf::Clock m_statsClock;
 
 public:
     //Member Variables
     bool m_start;
 
+    // Time between two presence relays, also the longest the server waits before checking for one
+    unsigned static int const PRESENCE_INTERVAL_MS = 100;
+    // Longest queryStats waits to connect, and then for the answer
+    unsigned static int const STATS_TIMEOUT_MS = 2000;
+
     //Member Functions
     // Default Constructor
     TCPServer();
@@ -77,6 +134,22 @@ public:
     //Getters
     int getClients();
     unsigned short getPort() const;
+    sf::Uint32 getSequence() const;
+    sf::Uint32 getAcknowledged(const string &username);
+    // Everything counted so far, with the current clients and history. Not safe while the server runs
+    // in another thread, ask it with queryStats instead.
+    ServerMetrics getMetrics();
+    // The metrics in the line protocol, one line for the server and one per client
+    string getStats();
+
+    //Setters
+    // Records every command relayed from now on, in the order relayed, or stops recording with nullptr
+    void setRecorder(SessionRecorder *recorder);
+    // Appends the metrics to a file every interval from now on. Returns false if it could not be opened.
+    bool setStatsFile(const string &path, sf::Time interval);
+
+    // Asks the server on this machine at the given port for its metrics, as getStats gives them
+    static bool queryStats(sf::IpAddress address, unsigned short port, string &stats);
 
 };
 
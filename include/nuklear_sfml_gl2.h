@@ -19,6 +19,7 @@ NK_API struct nk_context*   nk_sfml_init(sf::Window* window);
 NK_API void                 nk_sfml_font_stash_begin(struct nk_font_atlas** atlas);
 NK_API void                 nk_sfml_font_stash_end(void);
 NK_API int                  nk_sfml_handle_event(sf::Event* event);
+NK_API int                  nk_sfml_changed(void);
 NK_API void                 nk_sfml_render(enum nk_anti_aliasing);
 NK_API void                 nk_sfml_shutdown(void);
 
@@ -32,10 +33,24 @@ NK_API void                 nk_sfml_shutdown(void);
  */
 #ifdef NK_SFML_GL2_IMPLEMENTATION
 
+/* Size of the fixed memory the context's commands are kept in */
+#ifndef NK_SFML_MEMORY_SIZE
+#define NK_SFML_MEMORY_SIZE (256 * 1024)
+#endif
+
 struct nk_sfml_device {
     struct nk_buffer cmds;
+    struct nk_buffer last;
+    /* Vertices and elements of this frame and the previous one. They keep their memory between frames,
+     * so converting does not allocate once they are big enough. */
+    struct nk_buffer vbuf[2], ebuf[2];
+    int current;
+    /* Buffer objects the vertices and elements are kept in on the GPU, and how many bytes each can hold */
+    GLuint vbo, ebo;
+    nk_size vbo_size, ebo_size;
     struct nk_draw_null_texture null;
     GLuint font_tex;
+    void* memory;
 };
 
 struct nk_sfml_vertex {
@@ -51,6 +66,36 @@ static struct nk_sfml {
     struct nk_font_atlas atlas;
 } sfml;
 
+/* Brings a buffer object up to date with this frame's data. Only the bytes between the first and the
+ * last difference from the previous frame are sent, which for an idle panel is often nothing. */
+NK_INTERN void
+nk_sfml_device_upload(GLenum target, GLuint object, nk_size* capacity,
+                      const struct nk_buffer* now, const struct nk_buffer* before)
+{
+    const nk_byte* data = (const nk_byte*)nk_buffer_memory_const(now);
+    const nk_byte* old = (const nk_byte*)nk_buffer_memory_const(before);
+    nk_size size = now->allocated;
+    nk_size common = NK_MIN(size, before->allocated);
+    nk_size first = 0, last = size;
+
+    glBindBuffer(target, object);
+    if (size > *capacity) {
+        /* leave room to grow so a panel that gets bigger does not reallocate every frame */
+        *capacity = size * 2;
+        glBufferData(target, (GLsizeiptr)*capacity, NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(target, 0, (GLsizeiptr)size, data);
+        return;
+    }
+
+    while (first < common && data[first] == old[first])
+        first++;
+    if (size == before->allocated)
+        while (last > first && data[last - 1] == old[last - 1])
+            last--;
+    if (last > first)
+        glBufferSubData(target, (GLintptr)first, (GLsizeiptr)(last - first), data + first);
+}
+
 NK_INTERN void
 nk_sfml_device_upload_atlas(const void* image, int width, int height)
 {
@@ -63,6 +108,24 @@ nk_sfml_device_upload_atlas(const void* image, int width, int height)
                 GL_RGBA, GL_UNSIGNED_BYTE, image);
 }
 
+/* Compares this frame's commands with the last ones rendered. Needs NK_ZERO_COMMAND_MEMORY so padding
+ * inside commands is zero. If nothing changed 0 is returned, so the caller can call nk_clear instead of
+ * nk_sfml_render and skip the buffer swap. */
+NK_API int
+nk_sfml_changed(void)
+{
+    struct nk_sfml_device* dev = &sfml.ogl;
+    const void* cmds = nk_buffer_memory_const(&sfml.ctx.memory);
+    nk_size size = sfml.ctx.memory.allocated;
+
+    if (size == dev->last.allocated && !memcmp(cmds, nk_buffer_memory_const(&dev->last), size)) {
+        return 0;
+    }
+    nk_buffer_clear(&dev->last);
+    nk_buffer_push(&dev->last, NK_BUFFER_FRONT, cmds, size, 1);
+    return 1;
+}
+
 NK_API void
 nk_sfml_render(enum nk_anti_aliasing AA)
 {
@@ -103,8 +166,9 @@ nk_sfml_render(enum nk_anti_aliasing AA)
 
         /* convert from command queue into draw  list and draw to screen */
         const struct nk_draw_command* cmd;
-        const nk_draw_index* offset = NULL;
-        struct nk_buffer vbuf, ebuf;
+        nk_size offset = 0;
+        struct nk_buffer* vbuf = &dev->vbuf[dev->current];
+        struct nk_buffer* ebuf = &dev->ebuf[dev->current];
 
         /* fill converting configuration */
         struct nk_convert_config config;
@@ -126,19 +190,19 @@ nk_sfml_render(enum nk_anti_aliasing AA)
         config.shape_AA = AA;
         config.line_AA = AA;
 
-        /* convert shapes into vertices */
-        nk_buffer_init_default(&vbuf);
-        nk_buffer_init_default(&ebuf);
-        nk_convert(&sfml.ctx, &dev->cmds, &vbuf, &ebuf, &config);
+        /* convert shapes into vertices, reusing the memory of the frame before last */
+        nk_buffer_clear(vbuf);
+        nk_buffer_clear(ebuf);
+        nk_convert(&sfml.ctx, &dev->cmds, vbuf, ebuf, &config);
 
-        /* setup vertex buffer pointer */
-        const void* vertices = nk_buffer_memory_const(&vbuf);
-        glVertexPointer(2, GL_FLOAT, vs, (const void*)((const nk_byte*)vertices + vp));
-        glTexCoordPointer(2, GL_FLOAT, vs, (const void*)((const nk_byte*)vertices + vt));
-        glColorPointer(4, GL_UNSIGNED_BYTE, vs, (const void*)((const nk_byte*)vertices + vc));
+        /* send what changed since the previous frame and point at the buffer objects */
+        nk_sfml_device_upload(GL_ARRAY_BUFFER, dev->vbo, &dev->vbo_size, vbuf, &dev->vbuf[!dev->current]);
+        nk_sfml_device_upload(GL_ELEMENT_ARRAY_BUFFER, dev->ebo, &dev->ebo_size, ebuf, &dev->ebuf[!dev->current]);
+        glVertexPointer(2, GL_FLOAT, vs, (const void*)vp);
+        glTexCoordPointer(2, GL_FLOAT, vs, (const void*)vt);
+        glColorPointer(4, GL_UNSIGNED_BYTE, vs, (const void*)vc);
 
         /* iterate over and execute each draw command */
-        offset = (const nk_draw_index*)nk_buffer_memory_const(&ebuf);
         nk_draw_foreach(cmd, &sfml.ctx, &dev->cmds)
         {
             if(!cmd->elem_count) continue;
@@ -148,18 +212,20 @@ nk_sfml_render(enum nk_anti_aliasing AA)
                 (GLint)((window_height - (GLint)(cmd->clip_rect.y + cmd->clip_rect.h))),
                 (GLint)(cmd->clip_rect.w),
                 (GLint)(cmd->clip_rect.h));
-            glDrawElements(GL_TRIANGLES, (GLsizei)cmd->elem_count, GL_UNSIGNED_SHORT, offset);
-            offset += cmd->elem_count;
+            glDrawElements(GL_TRIANGLES, (GLsizei)cmd->elem_count, GL_UNSIGNED_SHORT, (const void*)offset);
+            offset += cmd->elem_count * sizeof(nk_draw_index);
         }
         nk_clear(&sfml.ctx);
-        nk_buffer_free(&vbuf);
-        nk_buffer_free(&ebuf);
+        nk_buffer_clear(&dev->cmds);
+        dev->current = !dev->current;
     }
 
     /* default OpenGL state */
     glDisableClientState(GL_VERTEX_ARRAY);
     glDisableClientState(GL_TEXTURE_COORD_ARRAY);
     glDisableClientState(GL_COLOR_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
     glDisable(GL_CULL_FACE);
     glDisable(GL_DEPTH_TEST);
@@ -214,11 +280,19 @@ NK_API struct nk_context*
 nk_sfml_init(sf::Window* window)
 {
     sfml.window = window;
-    nk_init_default(&sfml.ctx, 0);
+    sfml.ogl.memory = malloc(NK_SFML_MEMORY_SIZE);
+    nk_init_fixed(&sfml.ctx, sfml.ogl.memory, NK_SFML_MEMORY_SIZE, 0);
     sfml.ctx.clip.copy = nk_sfml_clipboard_copy;
     sfml.ctx.clip.paste = nk_sfml_clipboard_paste;
     sfml.ctx.clip.userdata = nk_handle_ptr(0);
     nk_buffer_init_default(&sfml.ogl.cmds);
+    nk_buffer_init_default(&sfml.ogl.last);
+    for (int i = 0; i < 2; i++) {
+        nk_buffer_init_default(&sfml.ogl.vbuf[i]);
+        nk_buffer_init_default(&sfml.ogl.ebuf[i]);
+    }
+    glGenBuffers(1, &sfml.ogl.vbo);
+    glGenBuffers(1, &sfml.ogl.ebo);
     return &sfml.ctx;
 }
 
@@ -353,6 +427,14 @@ void nk_sfml_shutdown(void)
     nk_free(&sfml.ctx);
     glDeleteTextures(1, &dev->font_tex);
     nk_buffer_free(&dev->cmds);
+    nk_buffer_free(&dev->last);
+    for (int i = 0; i < 2; i++) {
+        nk_buffer_free(&dev->vbuf[i]);
+        nk_buffer_free(&dev->ebuf[i]);
+    }
+    glDeleteBuffers(1, &dev->vbo);
+    glDeleteBuffers(1, &dev->ebo);
+    free(dev->memory);
     memset(&sfml, 0, sizeof(sfml));
 }
 
@@ -0,0 +1,103 @@
+/**
+ *  @file   AllocationCounter.cpp
+ *  @brief  AllocationCounter implementation, and the operator new and delete that count
+ *  @author Ellah
+ *  @date   2021-12-24
+ ***********************************************/
+
+// Include standard library C++ libraries.
+#include <cstdlib>
+#include <new>
+// Project header files
+#include "AllocationCounter.hpp"
+using namespace std;
+
+#ifdef COUNT_ALLOCATIONS
+// Each thread counts its own, so a server running in another thread does not disturb a probe
+static thread_local AllocationCount t_count;
+
+/*! \brief 	Allocates with malloc, counting the allocation. The array and nothrow forms call this one.
+*
+*/
+void *operator new(size_t size) {
+    t_count.allocations++;
+    t_count.bytes += size;
+    void *memory = malloc(size ? size : 1);
+    if (!memory) {
+        throw bad_alloc();
+    }
+    return memory;
+}
+
+/*! \brief 	Frees memory from operator new, counting it
+*
+*/
+void operator delete(void *memory) noexcept {
+    if (memory) {
+        t_count.deallocations++;
+        free(memory);
+    }
+}
+
+/*! \brief 	Frees memory from operator new, counting it
+*
+*/
+void operator delete(void *memory, size_t) noexcept {
+    operator delete(memory);
+}
+#endif
+
+/*! \brief 	Returns whether allocations are counted in this build
+*
+*/
+bool AllocationCounter::isEnabled() {
+#ifdef COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*! \brief 	Returns what the calling thread allocated so far
+*
+*/
+AllocationCount AllocationCounter::get() {
+#ifdef COUNT_ALLOCATIONS
+    return t_count;
+#else
+    return AllocationCount();
+#endif
+}
+
+/*! \brief 	Constructor, starts counting
+*
+*/
+AllocationProbe::AllocationProbe() : m_start(AllocationCounter::get()) {}
+
+/*! \brief 	Returns the allocations since the probe was made or reset
+*
+*/
+unsigned long AllocationProbe::getAllocations() const {
+    return AllocationCounter::get().allocations - m_start.allocations;
+}
+
+/*! \brief 	Returns the deallocations since the probe was made or reset
+*
+*/
+unsigned long AllocationProbe::getDeallocations() const {
+    return AllocationCounter::get().deallocations - m_start.deallocations;
+}
+
+/*! \brief 	Returns the bytes allocated since the probe was made or reset
+*
+*/
+unsigned long AllocationProbe::getBytes() const {
+    return AllocationCounter::get().bytes - m_start.bytes;
+}
+
+/*! \brief 	Starts counting again from now
+*
+*/
+void AllocationProbe::reset() {
+    m_start = AllocationCounter::get();
+}
@@ -13,6 +13,7 @@
 #define NK_INCLUDE_VERTEX_BUFFER_OUTPUT
 #define NK_INCLUDE_FONT_BAKING
 #define NK_INCLUDE_DEFAULT_FONT
+#define NK_ZERO_COMMAND_MEMORY
 #define NK_IMPLEMENTATION
 #define NK_SFML_GL2_IMPLEMENTATION
 
@@ -30,6 +31,9 @@
 // Include standard library C++ libraries.
 #include <cassert>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
 #include <SFML/OpenGL.hpp>
 #include <ClearScreen.hpp>
 
@@ -37,6 +41,10 @@
 #include "App.hpp"
 #include "CompositeCommand.hpp"
 #include "DrawStroke.hpp"
+#include "DrawBrush.hpp"
+#include "BrushStroke.hpp"
+#include "Eraser.hpp"
+#include "EraserStroke.hpp"
 
 using namespace std;
 
@@ -51,6 +59,44 @@ const vector<Mode> App::PRESET_MODES = { // NOLINT(cert-err58-cpp)
         {
                 .label = "Erase",
                 .mode = ERASE_MODE
+        },
+        {
+                .label = "Fill",
+                .mode = FILL_MODE
+        },
+        {
+                .label = "Line",
+                .mode = LINE_MODE
+        },
+        {
+                .label = "Rect",
+                .mode = RECT_MODE
+        },
+        {
+                .label = "Ellipse",
+                .mode = ELLIPSE_MODE
+        },
+        {
+                .label = "Select",
+                .mode = SELECT_MODE
+        }
+};
+const vector<Mode> App::BLEND_MODES = { // NOLINT(cert-err58-cpp)
+        {
+                .label = "Normal",
+                .mode = BLEND_NORMAL
+        },
+        {
+                .label = "Multiply",
+                .mode = BLEND_MULTIPLY
+        },
+        {
+                .label = "Screen",
+                .mode = BLEND_SCREEN
+        },
+        {
+                .label = "Erase alpha",
+                .mode = BLEND_ERASE
         }
 };
 const vector<PresetColor> App::PRESET_COLORS = { // NOLINT(cert-err58-cpp,cppcoreguidelines-interfaces-global-init)
@@ -90,7 +136,7 @@ const vector<PresetColor> App::PRESET_COLORS = { // NOLINT(cert-err58-cpp,cppcor
 
 /*! \brief App Constructor
  */
-App::App(void (*updateFunction)(App *), void (*drawFunction)(App *)) {
+App::App(void (*updateFunction)(App *), void (*drawFunction)(App *), WindowLayout layout) {
     m_updateFunc = updateFunction;
     m_drawFunc = drawFunction;
     selectedColor = sf::Color::Black;
@@ -102,37 +148,54 @@ App::App(void (*updateFunction)(App *), void (*drawFunction)(App *)) {
     brushRadius = 1;
 
     m_window = nullptr;
-    m_image = new sf::Image;
-    m_sprite = new sf::Sprite;
-    m_texture = new sf::Texture;
+    m_client = nullptr;
+    m_reconciler = nullptr;
+    m_recorder = nullptr;
+    m_canvasDirty = true;
+    m_guiFrames = GUI_SETTLE_FRAMES;
+    m_singleWindow = layout == SINGLE_WINDOW;
+    m_headless = layout == HEADLESS;
+    m_closed = false;
+    m_showProfiler = false;
+    m_layers = new LayerStack;
+    m_tileFrame = 0;
+    m_zoom = 1;
     m_clock = new sf::Clock;
+    gui_window = nullptr;
+
+    // Create an image which stores the pixels we will update
+    m_layers->create(App::WINDOW_WIDTH, App::WINDOW_HEIGHT, sf::Color::White);
+    assert(m_layers != nullptr && "m_layers != nullptr");
+
+    // Without windows there is no OpenGL context, so neither the GUI nor tile textures are set up
+    if (m_headless) {
+        return;
+    }
 
     // Setup the context
     sf::ContextSettings settings(24, 8, 4, 2, 2);
     // Create our window
-    m_window = new sf::RenderWindow(sf::VideoMode(App::WINDOW_WIDTH, App::WINDOW_HEIGHT), "Mini-Paint alpha 0.0.2",
-                                    sf::Style::Titlebar);
+    if (m_singleWindow) {
+        // The GUI is drawn with OpenGL in the same context, so it needs the GUI's context settings
+        m_window = new sf::RenderWindow(sf::VideoMode(GUI_WIDTH + App::WINDOW_WIDTH, App::WINDOW_HEIGHT),
+                                        "Mini-Paint alpha 0.0.2", sf::Style::Titlebar, settings);
+    } else {
+        m_window = new sf::RenderWindow(sf::VideoMode(App::WINDOW_WIDTH, App::WINDOW_HEIGHT),
+                                        "Mini-Paint alpha 0.0.2", sf::Style::Titlebar);
+    }
     m_window->setVerticalSyncEnabled(true);
 
-    // Create an image which stores the pixels we will update
-    m_image->create(App::WINDOW_WIDTH, App::WINDOW_HEIGHT, sf::Color::White);
-    assert(m_image != nullptr && "m_image != nullptr");
-
-    // Create a texture which lives in the GPU and will render our image
-    m_texture->loadFromImage(*m_image);
-    assert(m_texture != nullptr && "m_texture != nullptr");
-
-    // Create a sprite which is the entity that can be textured
-    m_sprite->setTexture(*m_texture);
-    assert(m_sprite != nullptr && "m_sprite != nullptr");
-
-    // Create a GUI window to draw to
-    gui_window = new sf::RenderWindow(
-            sf::VideoMode(GUI_WIDTH, WINDOW_HEIGHT),
-            "",
-            sf::Style::Default, settings
-    );
-    gui_window->setVerticalSyncEnabled(true);
+    // Create a GUI window to draw to, unless it shares the canvas window
+    if (m_singleWindow) {
+        gui_window = m_window;
+    } else {
+        gui_window = new sf::RenderWindow(
+                sf::VideoMode(GUI_WIDTH, WINDOW_HEIGHT),
+                "",
+                sf::Style::Default, settings
+        );
+        gui_window->setVerticalSyncEnabled(true);
+    }
     gui_window->setActive(true);
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wdeprecated-declarations"
@@ -154,16 +217,30 @@ App::App(void (*updateFunction)(App *), void (*drawFunction)(App *)) {
 *
 */
 void App::drawLayout() {
+    ProfileScope layout(&m_profiler, PROFILE_LAYOUT);
+    sf::Packet packet;
+    sf::Uint8 header_undo = UNDO, header_redo = REDO, header_clear = CLEARSCREEN;
+    string username = m_client ? m_client->getUsername() : "";
+
     if (nk_begin(ctx, "Settings", nk_rect(0, 0, GUI_WIDTH, WINDOW_HEIGHT),
                  NK_WINDOW_BORDER | NK_WINDOW_TITLE)) {
 
         // Undo + Redo
         nk_layout_row_static(ctx, 30, 90, 2);
         if (nk_button_label(ctx, "Undo")) {
-            undoCommand();
+            packet << header_undo << username;
+            sendCommand(packet);
+            // When the server's order is authoritative, the undo is drawn once it comes back sequenced
+            if (!m_reconciler) {
+                undoCommand();
+            }
         }
         if (nk_button_label(ctx, "Redo")) {
-            redoCommand();
+            packet << header_redo << username;
+            sendCommand(packet);
+            if (!m_reconciler) {
+                redoCommand();
+            }
         }
 
         // Spacer
@@ -179,6 +256,17 @@ void App::drawLayout() {
             }
         }
 
+        // Any other colour, sent through our palette
+        nk_layout_row_dynamic(ctx, 25, 1);
+        struct nk_colorf picked = {selectedColor.r / 255.0f, selectedColor.g / 255.0f, selectedColor.b / 255.0f,
+                                   selectedColor.a / 255.0f};
+        if (nk_combo_begin_color(ctx, nk_rgb_cf(picked), nk_vec2(GUI_WIDTH - 20, 250))) {
+            nk_layout_row_dynamic(ctx, 120, 1);
+            picked = nk_color_picker(ctx, picked, NK_RGBA);
+            selectedColor = sf::Color(picked.r * 255, picked.g * 255, picked.b * 255, picked.a * 255);
+            nk_combo_end(ctx);
+        }
+
         // Spacer
         nk_layout_row_dynamic(ctx, 20, 1);
 
@@ -194,6 +282,28 @@ void App::drawLayout() {
             incrementBrushRadius();
         }
 
+        // Brush opacity and how it blends with what is under it
+        nk_layout_row_dynamic(ctx, 20, 1);
+        nk_label(ctx, "Opacity:", NK_TEXT_LEFT);
+        int opacity = brushOpacity;
+        if (nk_slider_int(ctx, 0, &opacity, 255, 1)) {
+            brushOpacity = opacity;
+        }
+        nk_layout_row_dynamic(ctx, 25, 2);
+        for (Mode mode: BLEND_MODES) {
+            if (nk_option_label(ctx, mode.label, blendMode == mode.mode)) {
+                blendMode = (BlendMode)mode.mode;
+            }
+        }
+
+        // How close a colour has to be to the clicked one to be filled
+        nk_layout_row_dynamic(ctx, 20, 1);
+        nk_label(ctx, "Fill Tolerance:", NK_TEXT_LEFT);
+        int tolerance = fillTolerance;
+        if (nk_slider_int(ctx, 0, &tolerance, 255, 1)) {
+            fillTolerance = tolerance;
+        }
+
         // Spacer
         nk_layout_row_dynamic(ctx, 20, 1);
 
@@ -202,10 +312,18 @@ void App::drawLayout() {
         nk_label(ctx, "Mode:", NK_TEXT_LEFT);
         nk_layout_row_dynamic(ctx, 30, 2);
         for (Mode mode: PRESET_MODES) {
-            if (nk_option_label(ctx, mode.label, selectedMode == mode.mode)) {
+            if (nk_option_label(ctx, mode.label, selectedMode == mode.mode) && selectedMode != mode.mode) {
                 selectedMode = mode.mode;
+                // The selection is only outlined while selecting
+                invalidateCanvas();
             }
         }
+        // Rectangles and ellipses are as thick as the brush size unless filled
+        nk_layout_row_dynamic(ctx, 25, 1);
+        int filled = fillShapes;
+        if (nk_checkbox_label(ctx, "Filled Shapes", &filled)) {
+            fillShapes = filled;
+        }
 
         // Spacer
         nk_layout_row_dynamic(ctx, 20, 1);
@@ -213,12 +331,107 @@ void App::drawLayout() {
         // Clear Screen
         nk_layout_row_static(ctx, 30, 190, 1);
         if (nk_button_label(ctx, "Clear Screen")) {
+            packet << header_clear << username;
+            getPalette(username).write(packet, selectedColor);
             addCommand(new ClearScreen(this));
+            sendCommand(packet);
+        }
+
+        // Layers, the top one first. Which are shown and how is only up to us.
+        nk_layout_row_dynamic(ctx, 20, 1);
+        nk_label(ctx, "Layers:", NK_TEXT_LEFT);
+        float layerRow[] = {0.35f, 0.15f, 0.5f};
+        for (unsigned int layer = LayerStack::LAYER_COUNT; layer-- > 0;) {
+            nk_layout_row(ctx, NK_DYNAMIC, 25, 3, layerRow);
+            if (nk_option_label(ctx, ("Layer " + to_string(layer + 1)).c_str(), getLayer() == layer)) {
+                selectLayer(layer);
+            }
+            int visible = m_layers->isVisible(layer);
+            if (nk_checkbox_label(ctx, "", &visible)) {
+                m_layers->setVisible(layer, visible);
+                invalidateCanvas();
+            }
+            int opacity = m_layers->getOpacity(layer);
+            if (nk_slider_int(ctx, 0, &opacity, 255, 1)) {
+                m_layers->setOpacity(layer, opacity);
+                invalidateCanvas();
+            }
+        }
+
+        // Server Order
+        nk_layout_row_dynamic(ctx, 30, 1);
+        int reconcile = m_reconciler != nullptr;
+        if (nk_checkbox_label(ctx, "Server order", &reconcile)) {
+            setReconcile(reconcile);
+        }
+
+        // Where frame time goes, for finding out why drawing lags
+        int showProfiler = m_showProfiler;
+        if (nk_checkbox_label(ctx, "Profiler", &showProfiler)) {
+            m_showProfiler = showProfiler;
+        }
+        if (m_showProfiler) {
+            drawProfiler();
         }
     }
     nk_end(ctx);
 }
 
+/*! \brief 	Lays out the frame time graph and histogram, each stage's times, what was uploaded and
+*		how many messages wait, for the frames the profiler kept
+*
+*/
+void App::drawProfiler() {
+    vector<sf::Int64> frames = m_profiler.getHistory(PROFILE_FRAME);
+    if (frames.empty()) {
+        return;
+    }
+    sf::Int64 slowest = max<sf::Int64>(1000, *max_element(frames.begin(), frames.end()));
+
+    nk_layout_row_dynamic(ctx, 20, 1);
+    nk_labelf(ctx, NK_TEXT_LEFT, "Frame time, up to %.1f ms:", slowest / 1000.0);
+    nk_layout_row_dynamic(ctx, 60, 1);
+    if (nk_chart_begin(ctx, NK_CHART_LINES, (int)frames.size(), 0, (float)slowest)) {
+        for (sf::Int64 time: frames) {
+            nk_chart_push(ctx, (float)time);
+        }
+        nk_chart_end(ctx);
+    }
+
+    // Frames by the bit length of their time, so each column is twice as slow as the one before
+    vector<unsigned long> histogram = m_profiler.getHistogram(PROFILE_FRAME);
+    nk_layout_row_dynamic(ctx, 20, 1);
+    nk_labelf(ctx, NK_TEXT_LEFT, "Frames by time, up to %.1f ms:", ((sf::Int64)1 << (histogram.size() - 1)) / 1000.0);
+    nk_layout_row_dynamic(ctx, 40, 1);
+    if (nk_chart_begin(ctx, NK_CHART_COLUMN, (int)histogram.size(), 0, (float)frames.size())) {
+        for (unsigned long count: histogram) {
+            nk_chart_push(ctx, (float)count);
+        }
+        nk_chart_end(ctx);
+    }
+
+    // Average, 95th percentile and slowest time of each stage, in milliseconds
+    float columns[] = {0.34f, 0.22f, 0.22f, 0.22f};
+    nk_layout_row(ctx, NK_DYNAMIC, 16, 4, columns);
+    nk_label(ctx, "ms", NK_TEXT_LEFT);
+    nk_label(ctx, "avg", NK_TEXT_RIGHT);
+    nk_label(ctx, "p95", NK_TEXT_RIGHT);
+    nk_label(ctx, "max", NK_TEXT_RIGHT);
+    for (unsigned int stage = 0; stage < PROFILE_STAGE_COUNT; stage++) {
+        nk_label(ctx, Profiler::STAGE_NAMES[stage], NK_TEXT_LEFT);
+        nk_labelf(ctx, NK_TEXT_RIGHT, "%.2f", m_profiler.getAverage((ProfileStage)stage) / 1000.0);
+        nk_labelf(ctx, NK_TEXT_RIGHT, "%.2f", m_profiler.getPercentile((ProfileStage)stage, 0.95) / 1000.0);
+        nk_labelf(ctx, NK_TEXT_RIGHT, "%.2f", m_profiler.getPercentile((ProfileStage)stage, 1) / 1000.0);
+    }
+
+    vector<sf::Int64> uploads = m_profiler.getHistory(PROFILE_UPLOAD_BYTES);
+    sf::Int64 uploaded = accumulate(uploads.begin(), uploads.end(), (sf::Int64)0);
+    nk_layout_row_dynamic(ctx, 16, 1);
+    nk_labelf(ctx, NK_TEXT_LEFT, "Uploaded %.1f KiB in %lu frames", uploaded / 1024.0, (unsigned long)uploads.size());
+    nk_labelf(ctx, NK_TEXT_LEFT, "Received, not drawn: %ld", (long)m_profiler.getLast(PROFILE_INBOX));
+    nk_labelf(ctx, NK_TEXT_LEFT, "Sent, not ordered: %ld", (long)m_profiler.getLast(PROFILE_PENDING));
+}
+
 /*! \brief 	Add a new command to the queue,
 * execute it, and clear undo history.
 *
@@ -236,8 +449,10 @@ void App::addCommand(Command *c) {
 *
 */
 void App::startComposite(const string &username, CompositeCommand *c) {
-    m_inProgressCommands.emplace(pair<string, CompositeCommand *>(username, c));
-
+    // A stroke whose end never arrived is dropped, so the new one does not continue from it
+    CompositeCommand *&composite = m_inProgressCommands[username];
+    delete composite;
+    composite = c;
 }
 
 /*! \brief End and destroy the CompositeCommand associated with the given username
@@ -247,8 +462,52 @@ void App::endComposite(const string &username) {
     map<string, CompositeCommand *>::iterator it;
     it = m_inProgressCommands.find(username);
     if (it != m_inProgressCommands.end()) {
+        CompositeCommand *composite = it->second;
         m_inProgressCommands.erase(it);
-        m_commands.push_front(it->second);
+        m_commands.push_front(composite);
+    }
+}
+
+/*! \brief 	Keeps a user's stroke in step with a command the reconciler already drew, so their following
+*		brushes are interpolated from it like they are on the base canvas
+*
+*/
+void App::followStroke(sf::Uint8 header, const string &username, sf::Packet &packet) {
+    map<string, CompositeCommand *>::iterator it;
+    Command *command;
+
+    switch (header) {
+        case START_BRUSHSTROKE:
+            startComposite(username, new BrushStroke());
+            break;
+        case START_ERASERSTROKE:
+            startComposite(username, new EraserStroke());
+            break;
+        case END_BRUSHSTROKE:
+        case END_ERASERSTROKE:
+            endComposite(username);
+            break;
+        case DRAWBRUSH:
+        case ERASER:
+            it = m_inProgressCommands.find(username);
+            if (it == m_inProgressCommands.end()) {
+                break;
+            }
+            command = Reconciler::decodeCommand(header, username, packet, getLayers(), getBGColor(),
+                                                getPalette(username));
+            if (BrushStroke *brushStroke = dynamic_cast<BrushStroke *>(it->second)) {
+                if (DrawBrush *drawn = dynamic_cast<DrawBrush *>(command)) {
+                    brushStroke->continueFrom(*drawn);
+                }
+            } else if (EraserStroke *eraserStroke = dynamic_cast<EraserStroke *>(it->second)) {
+                if (Eraser *erased = dynamic_cast<Eraser *>(command)) {
+                    eraserStroke->continueFrom(*erased);
+                }
+            }
+            delete command;
+            break;
+        default:
+            break;
     }
 }
 
@@ -256,9 +515,12 @@ void App::endComposite(const string &username) {
 *
 */
 void App::addToComposite(const string &username, Command *c) {
+    ProfileScope commands(&m_profiler, PROFILE_COMMANDS);
+    TraceSpan span("execute", "command");
     try {
         CompositeCommand *composite = m_inProgressCommands.at(username);
         composite->addAndExecuteCommand(c);
+        invalidateCanvas();
     } catch (out_of_range) {
         cerr << username << " has no CompositeCommand to add to" << endl;
     }
@@ -269,6 +531,8 @@ void App::addToComposite(const string &username, Command *c) {
 *
 */
 void App::executeCommand(Command *c) {
+    ProfileScope commands(&m_profiler, PROFILE_COMMANDS);
+    TraceSpan span("execute", "command");
     if (!m_commands.empty()) {
         // If new command is the same as the front of the deque, exit to avoid duplication
         if (c == m_commands.front()) {
@@ -293,18 +557,22 @@ void App::executeCommand(Command *c) {
     // push & execute
     m_commands.push_front(c);
     c->execute();
+    invalidateCanvas();
 }
 
 /*! \brief 	Undo the most recently performed command
 *
 */
 void App::undoCommand() {
+    ProfileScope commands(&m_profiler, PROFILE_COMMANDS);
+    TraceSpan span("undo", "command");
 
     if (!m_commands.empty()) {
         m_commands.front()->undo();
 
         m_undo.push(m_commands.front());
         m_commands.pop_front();
+        invalidateCanvas();
     }
 }
 
@@ -319,20 +587,154 @@ void App::redoCommand() {
     }
 }
 
+/*! \brief 	Applies the next command received from the server, recording it first. Returns false if there was none.
+*
+*/
+bool App::executeReceivedCommand() {
+    if (!m_client) {
+        return false;
+    }
+
+    sf::Packet p;
+    {
+        ProfileScope network(&m_profiler, PROFILE_NETWORK);
+        TraceSpan span("receive", "network");
+        // Pick up where we left off instead of rejoining and replaying the whole session
+        if (m_client->diconnected()) {
+            m_client->resumeSession();
+        }
+        p = m_client->receiveData();
+    }
+    if (p.getDataSize() == 0) {
+        return false;
+    }
+    if (m_recorder) {
+        m_recorder->record(TRACE_RECEIVED, p);
+    }
+    applyCommand(p);
+    return true;
+}
+
+/*! \brief 	Applies a command from someone, as received from the server without its sequence number.
+*		Only what changes the pixels or the cursors invalidates the canvas, not e.g. an ACK.
+*
+*/
+void App::applyCommand(sf::Packet p) {
+    ProfileScope commands(&m_profiler, PROFILE_COMMANDS);
+    TraceSpan span("apply", "command");
+    sf::Uint8 header, selected;
+    string username;
+    Command *command;
+
+    // Reading moves through the packet, so keep it whole for the reconciler
+    sf::Packet received = p;
+    p >> header;
+
+    // Cursors are only drawn over the canvas, so they skip the history and the reconciler
+    if (header == PRESENCE) {
+        sf::Uint16 session, x, y;
+        p >> session >> x >> y;
+        setCursor(session, x, y);
+        return;
+    }
+    p >> username;
+    // The server relays each user's messages in the order they were sent, so this is their number
+    if (header != ACK) {
+        EventTrace::flow(FLOW_APPLIED, username, m_flowCounts[username]++);
+    }
+
+    // When the server's order is authoritative, everything goes through the base canvas first
+    if (m_reconciler) {
+        if (header == ACK) {
+            // The server sequenced our oldest pending command
+            if (m_reconciler->commitLocal()) {
+                m_reconciler->rebuild(getLayers());
+                invalidateCanvas();
+            }
+            return;
+        }
+        if (m_reconciler->addRemote(received)) {
+            // It was ordered before commands we already drew, so draw those again on top of it. Its
+            // stroke still starts, continues or ends for the commands drawn directly after it.
+            m_reconciler->rebuild(getLayers());
+            invalidateCanvas();
+            followStroke(header, username, p);
+            return;
+        }
+    }
+
+    switch (header) {
+        case START_BRUSHSTROKE:
+            // Remote strokes are rebuilt locally so only the raw mouse samples travel over the network
+            startComposite(username, new BrushStroke());
+            break;
+        case START_ERASERSTROKE:
+            startComposite(username, new EraserStroke());
+            break;
+        case END_BRUSHSTROKE:
+        case END_ERASERSTROKE:
+            endComposite(username);
+            break;
+        case LAYER:
+            p >> selected;
+            getLayers().select(username, selected);
+            break;
+        case UNDO:
+            undoCommand();
+            break;
+        case REDO:
+            redoCommand();
+            break;
+        default:
+            // Read the same way the reconciler reads it onto the base canvas
+            command = Reconciler::decodeCommand(header, username, p, getLayers(), getBGColor(), getPalette(username));
+            if (command && (header == DRAWBRUSH || header == ERASER) && m_inProgressCommands.count(username)) {
+                // Interpolates from the previous sample exactly like the sender's own stroke, which keeps its own copy
+                addToComposite(username, command);
+                delete command;
+            } else if (command) {
+                // Kept in the history like a finished stroke
+                executeCommand(command);
+            }
+            break;
+    }
+}
+
+
 /*! \brief 	Return a reference to our m_image, so that
 *		we do not have to publicly expose it.
 *
 */
-sf::Image &App::getImage() {
-    return *m_image;
+Canvas &App::getImage() {
+    return m_layers->getLayer(getLayer());
 }
 
-/*! \brief 	Return a reference to our m_Texture so that
-*		we do not have to publicly expose it.
+/*! \brief 	Returns every layer, with the composite shown in the window
+*
+*/
+LayerStack &App::getLayers() {
+    return *m_layers;
+}
+
+/*! \brief 	Returns the layer we draw on
+*
+*/
+unsigned int App::getLayer() const {
+    return m_layers->getSelected(getLocalName());
+}
+
+/*! \brief 	Returns the colour erasing paints on the layer we draw on
 *
 */
-sf::Texture &App::getTexture() {
-    return *m_texture;
+sf::Color App::getEraseColor() const {
+    return LayerStack::getEraseColor(getLayer(), backgroundColor);
+}
+
+/*! \brief 	Returns our username, layers and palettes are kept by it
+*
+*/
+string App::getLocalName() const {
+    return m_client ? m_client->getUsername() : "";
 }
 
 /*! \brief 	Return a reference to our m_window so that we
@@ -343,6 +745,13 @@ sf::RenderWindow &App::getWindow() {
     return *m_window;
 }
 
+/*! \brief 	Returns whether the App runs without windows
+*
+*/
+bool App::isHeadless() const {
+    return m_headless;
+}
+
 /*! \brief 	Return a reference to our m_clock so that we
 *		do not have to publicly expose it.
 *
@@ -351,6 +760,13 @@ sf::Clock &App::getClock() {
     return *m_clock;
 }
 
+/*! \brief 	Returns the times of the last frames' stages
+*
+*/
+Profiler &App::getProfiler() {
+    return m_profiler;
+}
+
 /*! \brief Gets the selectedColor of the app
  *
  */
@@ -383,20 +799,31 @@ void App::setMode(int newMode) {
 *
 */
 void App::destroy() {
-    delete m_image;
-    delete m_sprite;
-    delete m_texture;
+    delete m_reconciler;
+    delete m_layers;
+    m_tileTextures.clear();
 }
 
-/*! \brief Handles GUI input
+/*! \brief Handles GUI input, returns true if there was any
  */
-void App::handleGUIInput() {
+bool App::handleGUIInput() {
     // Capture events in our main window
     sf::Event event; // NOLINT(cppcoreguidelines-pro-type-member-init)
+    bool input = false;
 
     // Capture input from the nuklear GUI
     nk_input_begin(ctx);
     while (gui_window->pollEvent(event)) {
+        // Sharing the window, the update function gets everything not aimed at the GUI
+        if (m_singleWindow) {
+            int canvasLeft = getCanvasOffset();
+            bool overGUI = (event.type == sf::Event::MouseButtonPressed && event.mouseButton.x < canvasLeft) ||
+                           (event.type == sf::Event::MouseMoved && event.mouseMove.x < canvasLeft) ||
+                           (event.type == sf::Event::MouseWheelScrolled && event.mouseWheelScroll.x < canvasLeft);
+            if (!overGUI) {
+                m_events.push(event);
+            }
+        }
         if (event.type == sf::Event::KeyReleased) {
             if (event.key.code == sf::Keyboard::Escape) {
                 nk_sfml_shutdown();
@@ -405,10 +832,12 @@ void App::handleGUIInput() {
             }
         }
         nk_sfml_handle_event(&event);
+        input = true;
     }
 
     // Complete input from nuklear GUI
     nk_input_end(ctx);
+    return input;
 }
 
 /*! \brief 	The main loop function which handles initialization
@@ -418,33 +847,173 @@ void App::handleGUIInput() {
 *
 */
 void App::loop() {
-    // Start the main rendering loop
-    while (m_window->isOpen() && gui_window->isOpen()) {
-        drawLayout();
+    if (m_headless) {
+        loopHeadless();
+        return;
+    }
+
+    // Start the main rendering loop. Each window is only rendered again when what it shows changed.
+    while (!m_closed && m_window->isOpen() && gui_window->isOpen()) {
+        bool laidOut = false, guiChanged = false, canvasChanged = m_canvasDirty;
+        sf::Clock frame;
+
+        {
+            ProfileScope input(&m_profiler, PROFILE_INPUT);
+            if (handleGUIInput()) {
+                invalidateGUI();
+            }
+        }
+        // The profiler section shows live numbers, so it is laid out again every so often while shown
+        if (m_showProfiler && m_profilerClock.getElapsedTime() >= sf::milliseconds(PROFILER_REFRESH_MS)) {
+            m_profilerClock.restart();
+            invalidateGUI();
+        }
+        if (m_guiFrames > 0) {
+            m_guiFrames--;
+            drawLayout();
+            laidOut = true;
+            // Input often leaves the panel looking the same, e.g. moving over empty space
+            guiChanged = nk_sfml_changed();
+        }
+        // Updates specified by the user
+        {
+            ProfileScope update(&m_profiler, PROFILE_UPDATE);
+            m_updateFunc(this);
+        }
+        if (m_canvasDirty) {
+            m_canvasDirty = false;
+            canvasChanged = true;
+            // Additional drawing specified by user, may invalidate the canvas again to be called next frame
+            ProfileScope draw(&m_profiler, PROFILE_DRAW);
+            m_drawFunc(this);
+        }
+
+        if (m_singleWindow && (guiChanged || canvasChanged)) {
+            // The whole window is drawn again, so the GUI is needed even if it did not change
+            if (!laidOut) {
+                drawLayout();
+            }
+            renderCanvas();
+            renderGUI();
+            display(m_window);
+        } else if (!m_singleWindow && (guiChanged || canvasChanged)) {
+            if (guiChanged) {
+                renderGUI();
+                display(gui_window);
+            }
+            if (canvasChanged) {
+                renderCanvas();
+                display(m_window);
+            }
+        }
+
+        // The idle wait below is not part of the frame
+        sampleQueues();
+        m_profiler.add(PROFILE_FRAME, frame.getElapsedTime().asMicroseconds());
+        m_profiler.endFrame();
+
+        if (laidOut && !guiChanged && !canvasChanged) {
+            nk_clear(ctx);
+        } else if (m_guiFrames == 0 && !laidOut && !canvasChanged) {
+            // Nothing to show, so sleep until the server sends something or it is time to check for input
+            if (m_client) {
+                m_client->waitForData(sf::milliseconds(IDLE_WAIT_MS));
+            } else {
+                sf::sleep(sf::milliseconds(IDLE_WAIT_MS));
+            }
+        }
+    }
+}
+
+/*! \brief 	Calls the update and draw functions like loop does, without any input or rendering,
+*		until close is called. Sleeps while nothing happens or no frame is due, like loop.
+*
+*/
+void App::loopHeadless() {
+    while (!m_closed) {
+        sf::Clock frame;
+        {
+            ProfileScope update(&m_profiler, PROFILE_UPDATE);
+            m_updateFunc(this);
+        }
+        bool drawn = false;
+        if (m_canvasDirty) {
+            m_canvasDirty = false;
+            ProfileScope draw(&m_profiler, PROFILE_DRAW);
+            m_drawFunc(this);
+            // The draw function invalidates the canvas again when it is too soon for another frame, which
+            // is no reason to skip the wait
+            drawn = !m_canvasDirty;
+        }
+        sampleQueues();
+        m_profiler.add(PROFILE_FRAME, frame.getElapsedTime().asMicroseconds());
+        m_profiler.endFrame();
+
+        if (!drawn && m_client) {
+            m_client->waitForData(sf::milliseconds(IDLE_WAIT_MS));
+        } else if (!drawn) {
+            sf::sleep(sf::milliseconds(IDLE_WAIT_MS));
+        }
+    }
+}
+
+/*! \brief 	Samples how many messages wait to be drawn and to be ordered by the server, for the profiler
+*
+*/
+void App::sampleQueues() {
+    m_profiler.set(PROFILE_INBOX, m_client ? (sf::Int64)m_client->getInboxSize() : 0);
+    m_profiler.set(PROFILE_PENDING, m_reconciler ? (sf::Int64)m_reconciler->getPendingCount() : 0);
+}
+
+/*! \brief 	Makes loop return once the current frame is done
+*
+*/
+void App::close() {
+    m_closed = true;
+}
+
+/*! \brief 	Draws the GUI's commands with OpenGL. With a single window it is drawn over the canvas.
+*
+*/
+void App::renderGUI() {
+    ProfileScope render(&m_profiler, PROFILE_RENDER);
+    gui_window->setActive(true);
+    if (!m_singleWindow) {
         // OpenGL is the background rendering engine,
         // so we are going to clear our GUI graphics system.
-        gui_window->setActive(true);
         gui_window->clear();
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wdeprecated-declarations"
         glClearColor(bg.r, bg.g, bg.b, bg.a);
         glClear(GL_COLOR_BUFFER_BIT);
 #pragma clang diagnostic pop
-        nk_sfml_render(NK_ANTI_ALIASING_ON);
-        gui_window->display();
-        // Clear the window
-        m_window->clear();
-        // Updates specified by the user
-        m_updateFunc(this);
-        handleGUIInput();
-        // Additional drawing specified by user
-        m_drawFunc(this);
-        // Update the texture
-        // Draw to the canvas
-        m_window->draw(*m_sprite);
-        // Display the canvas
-        m_window->display();
     }
+    nk_sfml_render(NK_ANTI_ALIASING_ON);
+}
+
+/*! \brief 	Shows what was rendered into a window, which may wait for the display
+*
+*/
+void App::display(sf::RenderWindow *window) {
+    ProfileScope display(&m_profiler, PROFILE_DISPLAY);
+    window->display();
+}
+
+/*! \brief 	Draws the canvas and the other users' cursors
+*
+*/
+void App::renderCanvas() {
+    ProfileScope render(&m_profiler, PROFILE_RENDER);
+    // Keep SFML's OpenGL states apart from the ones the GUI sets
+    m_window->setActive(true);
+    m_window->pushGLStates();
+    // Clear the window
+    m_window->clear();
+    // Draw to the canvas
+    drawTiles();
+    drawCursors();
+    drawSelection();
+    m_window->popGLStates();
 }
 
 /*! \brief Adds a client to the app
@@ -460,28 +1029,338 @@ TCPClient *App::getClient() {
     return m_client;
 }
 
-/*! \brief Returns number associated with a specific color
- */
-sf::Uint8 App::getColorNumber(sf::Color color) {
-    if (color == sf::Color::Black) {
-        return 1;
-    } else if (color == sf::Color::White) {
-        return 2;
-    } else if (color == sf::Color::Red) {
-        return 3;
-    } else if (color == sf::Color::Green) {
-        return 4;
-    } else if (color == sf::Color::Blue) {
-        return 5;
-    } else if (color == sf::Color::Yellow) {
-        return 6;
-    } else if (color == sf::Color::Magenta) {
-        return 7;
-    } else if (color == sf::Color::Cyan) {
-        return 8;
+/*! \brief Sends a command packet to the server, remembering it as pending while the server's order is authoritative.
+ *  It is recorded too while a recorder is set.
+ */
+void App::sendCommand(const sf::Packet &packet) {
+    TraceSpan span("send", "network");
+    EventTrace::flow(FLOW_SENT, getLocalName(), m_flowCounts[getLocalName()]++);
+    if (m_recorder) {
+        m_recorder->record(TRACE_LOCAL, packet);
+    }
+    if (m_client) {
+        m_client->sendCommand(packet);
+    }
+    if (m_reconciler) {
+        m_reconciler->addLocal(packet);
+    }
+}
+
+/*! \brief Records the commands we send and receive from now on, or stops recording with nullptr
+ */
+void App::setRecorder(SessionRecorder *recorder) {
+    m_recorder = recorder;
+}
+
+/*! \brief Returns the reconciler, or nullptr while commands are drawn in the order they arrive
+ */
+Reconciler *App::getReconciler() {
+    return m_reconciler;
+}
+
+/*! \brief Turns server-ordered reconciliation on or off. The current canvas becomes the starting point.
+ */
+void App::setReconcile(bool reconcile) {
+    delete m_reconciler;
+    m_reconciler = nullptr;
+
+    if (reconcile) {
+        m_reconciler = new Reconciler(getLocalName(), *m_layers, backgroundColor, m_palettes);
+    }
+}
+
+/*! \brief Returns the next event for the canvas. With a single window, the GUI already took its own events.
+ */
+bool App::pollEvent(sf::Event &event) {
+    if (!m_singleWindow && !m_headless) {
+        return m_window->pollEvent(event);
+    }
+    if (m_events.empty()) {
+        return false;
+    }
+    event = m_events.front();
+    m_events.pop();
+    return true;
+}
+
+/*! \brief Returns the mouse position on the canvas, which is right of the GUI in a single window.
+ *  Headless there is no mouse, so it is left of and above the canvas.
+ */
+sf::Vector2i App::getMousePosition() {
+    if (m_headless) {
+        return sf::Vector2i(-1, -1);
+    }
+    sf::Vector2i position = sf::Mouse::getPosition(*m_window);
+    position.x -= getCanvasOffset();
+    return position;
+}
+
+/*! \brief Returns how far right of the window's left edge the canvas is
+ */
+int App::getCanvasOffset() const {
+    return m_singleWindow ? GUI_WIDTH : 0;
+}
+
+/*! \brief Starts a blank canvas of the given size, up to Canvas::MAX_SIZE on each side
+ */
+void App::setCanvasSize(unsigned int width, unsigned int height) {
+    m_layers->create(width, height, backgroundColor);
+    resetView();
+}
+
+/*! \brief Draws on another layer from now on. Others draw our commands on the same layer, so it is sent
+ *  in order with them.
+ */
+void App::selectLayer(unsigned int layer) {
+    if (layer >= LayerStack::LAYER_COUNT || layer == getLayer()) {
+        return;
+    }
+    m_layers->select(getLocalName(), layer);
+
+    sf::Packet packet;
+    sf::Uint8 header = LAYER, index = layer;
+    packet << header << getLocalName() << index;
+    sendCommand(packet);
+}
+
+/*! \brief Returns the canvas position under a position in the canvas area of the window
+ */
+sf::Vector2f App::toCanvas(sf::Vector2i position) const {
+    return sf::Vector2f(m_viewOrigin.x + position.x / m_zoom, m_viewOrigin.y + position.y / m_zoom);
+}
+
+/*! \brief Returns where in the canvas area of the window a canvas position is shown
+ */
+sf::Vector2f App::toWindow(sf::Vector2f position) const {
+    return sf::Vector2f((position.x - m_viewOrigin.x) * m_zoom, (position.y - m_viewOrigin.y) * m_zoom);
+}
+
+/*! \brief Zooms in or out about a position in the canvas area, within MIN_ZOOM and MAX_ZOOM
+ */
+void App::zoomAt(sf::Vector2i position, float factor) {
+    sf::Vector2f anchor = toCanvas(position);
+    m_zoom = max(MIN_ZOOM, min(MAX_ZOOM, m_zoom * factor));
+    m_viewOrigin = sf::Vector2f(anchor.x - position.x / m_zoom, anchor.y - position.y / m_zoom);
+    invalidateCanvas();
+}
+
+/*! \brief Moves the view by a number of window pixels
+ */
+void App::pan(float dx, float dy) {
+    m_viewOrigin.x += dx / m_zoom;
+    m_viewOrigin.y += dy / m_zoom;
+    invalidateCanvas();
+}
+
+/*! \brief Shows the canvas from its top left corner at its actual size
+ */
+void App::resetView() {
+    m_zoom = 1;
+    m_viewOrigin = sf::Vector2f(0, 0);
+    invalidateCanvas();
+}
+
+/*! \brief Returns the number of window pixels per canvas pixel
+ */
+float App::getZoom() const {
+    return m_zoom;
+}
+
+/*! \brief Returns the pyramid level with at least one of its pixels per window pixel, so zoomed out
+ *  views neither upload nor draw more tiles than fit in the window
+ */
+unsigned int App::getViewLevel() const {
+    unsigned int level = 0;
+    while (level + 1 < m_layers->getLayer(0).getLevels() && m_zoom * (2 << level) <= 1) {
+        level++;
+    }
+    return level;
+}
+
+/*! \brief Returns the number of tile textures on the GPU
+ */
+unsigned long App::getTileTextureCount() const {
+    return m_tileTextures.size();
+}
+
+/*! \brief Identifies a tile of a level, the three fit in 16 bits each as the canvas is at most 512 tiles wide
+ */
+sf::Uint64 App::tileKey(unsigned int level, unsigned int column, unsigned int row) {
+    return (sf::Uint64)level << 32 | (sf::Uint64)row << 16 | column;
+}
+
+/*! \brief Returns the columns and rows of the tiles of a level that are in view
+ */
+sf::IntRect App::getVisibleTiles(unsigned int level) const {
+    float span = Canvas::TILE_SIZE << level;
+    sf::Vector2u grid = m_layers->getLayer(0).getTileGrid(level);
+    sf::Vector2f end = toCanvas(sf::Vector2i(WINDOW_WIDTH, WINDOW_HEIGHT));
+
+    int left = max(0, (int)floor(m_viewOrigin.x / span));
+    int top = max(0, (int)floor(m_viewOrigin.y / span));
+    int right = min((int)grid.x, (int)ceil(end.x / span));
+    int bottom = min((int)grid.y, (int)ceil(end.y / span));
+    return sf::IntRect(left, top, max(0, right - left), max(0, bottom - top));
+}
+
+/*! \brief Uploads the tiles in view whose pixels changed since they were last uploaded, then drops
+ *  the textures shown least recently while there are more than MAX_TILE_TEXTURES. Headless, the
+ *  layers are still composited but nothing is uploaded.
+ */
+void App::updateTiles() {
+    Canvas &composite = m_layers->composite();
+    if (m_headless) {
+        return;
+    }
+    ProfileScope upload(&m_profiler, PROFILE_UPLOAD);
+    TraceSpan span("upload", "render");
+    unsigned int level = getViewLevel();
+    sf::IntRect visible = getVisibleTiles(level);
+    m_tileFrame++;
+
+    for (int row = visible.top; row < visible.top + visible.height; row++) {
+        for (int column = visible.left; column < visible.left + visible.width; column++) {
+            sf::Uint64 key = tileKey(level, column, row);
+            const vector<sf::Color> &pixels = composite.getTile(level, column, row);
+
+            // Blank tiles are drawn as part of the background
+            if (pixels.empty()) {
+                m_tileTextures.erase(key);
+                continue;
+            }
+
+            sf::Uint64 version = composite.getTileVersion(level, column, row);
+            auto it = m_tileTextures.find(key);
+            if (it == m_tileTextures.end()) {
+                it = m_tileTextures.emplace(key, TileTexture()).first;
+                it->second.texture.create(Canvas::TILE_SIZE, Canvas::TILE_SIZE);
+                it->second.version = version - 1;
+            }
+            if (it->second.version != version) {
+                it->second.texture.update(reinterpret_cast<const sf::Uint8 *>(pixels.data()));
+                it->second.version = version;
+                m_profiler.add(PROFILE_UPLOAD_BYTES, (sf::Int64)(pixels.size() * sizeof(sf::Color)));
+            }
+            it->second.lastShown = m_tileFrame;
+        }
+    }
+
+    if (m_tileTextures.size() > MAX_TILE_TEXTURES) {
+        vector<pair<sf::Uint64, sf::Uint64>> shown;
+        for (auto &tile: m_tileTextures) {
+            shown.emplace_back(tile.second.lastShown, tile.first);
+        }
+        sort(shown.begin(), shown.end());
+        for (unsigned long i = 0; i < shown.size() - MAX_TILE_TEXTURES; i++) {
+            m_tileTextures.erase(shown[i].second);
+        }
+    }
+}
+
+/*! \brief Draws the canvas background, then the uploaded tiles in view scaled to the zoom
+ */
+void App::drawTiles() {
+    Canvas &composite = m_layers->composite();
+    unsigned int level = getViewLevel();
+    float scale = m_zoom * (1 << level);
+    float span = Canvas::TILE_SIZE << level;
+    float offset = getCanvasOffset();
+
+    sf::Vector2f origin = toWindow(sf::Vector2f(0, 0));
+    sf::RectangleShape background(sf::Vector2f(composite.getSize().x * m_zoom, composite.getSize().y * m_zoom));
+    background.setPosition(origin.x + offset, origin.y);
+    background.setFillColor(Blend::unpremultiply(composite.getBackground()));
+    m_window->draw(background);
+
+    sf::IntRect visible = getVisibleTiles(level);
+    sf::Sprite sprite;
+    sprite.setScale(scale, scale);
+    // Tiles are premultiplied, so their colour is added as it is rather than scaled by their alpha again
+    sf::RenderStates premultiplied(sf::BlendMode(sf::BlendMode::One, sf::BlendMode::OneMinusSrcAlpha));
+    for (int row = visible.top; row < visible.top + visible.height; row++) {
+        for (int column = visible.left; column < visible.left + visible.width; column++) {
+            auto it = m_tileTextures.find(tileKey(level, column, row));
+            if (it == m_tileTextures.end()) {
+                continue;
+            }
+            // Tiles on the right and bottom edges hold pixels past the canvas, those are cut off
+            sf::Vector2f corner(column * span, row * span);
+            int width = min<int>(Canvas::TILE_SIZE, (composite.getSize().x - corner.x + (1 << level) - 1) / (1 << level));
+            int height = min<int>(Canvas::TILE_SIZE, (composite.getSize().y - corner.y + (1 << level) - 1) / (1 << level));
+            sprite.setTexture(it->second.texture);
+            sprite.setTextureRect(sf::IntRect(0, 0, width, height));
+            sf::Vector2f position = toWindow(corner);
+            sprite.setPosition(position.x + offset, position.y);
+            m_window->draw(sprite, premultiplied);
+        }
+    }
+}
+
+/*! \brief Marks the canvas as changed, so it is rendered again next frame
+ */
+void App::invalidateCanvas() {
+    m_canvasDirty = true;
+}
+
+/*! \brief Marks the GUI as changed, so it is laid out and rendered again for the next few frames
+ */
+void App::invalidateGUI() {
+    m_guiFrames = GUI_SETTLE_FRAMES;
+}
+
+/*! \brief Moves another user's cursor, or hides it once they left
+ */
+void App::setCursor(sf::Uint16 session, sf::Uint16 x, sf::Uint16 y) {
+    if (x == PRESENCE_GONE && y == PRESENCE_GONE) {
+        m_cursors.erase(session);
     } else {
-        return -1;
+        m_cursors[session] = sf::Vector2i(x, y);
+    }
+    invalidateCanvas();
+}
+
+/*! \brief Returns the other users' cursors by session number
+ */
+const map<sf::Uint16, sf::Vector2i> &App::getCursors() const {
+    return m_cursors;
+}
+
+/*! \brief Draws a ring at each of the other users' cursors, coloured by their session
+ */
+void App::drawCursors() {
+    sf::CircleShape ring(CURSOR_RADIUS);
+    ring.setFillColor(sf::Color::Transparent);
+    ring.setOutlineThickness(2);
+    ring.setOrigin(CURSOR_RADIUS, CURSOR_RADIUS);
+
+    for (auto &cursor: m_cursors) {
+        ring.setOutlineColor(PRESET_COLORS[cursor.first % PRESET_COLORS.size()].color);
+        sf::Vector2f position = toWindow(sf::Vector2f(cursor.second.x, cursor.second.y));
+        ring.setPosition(position.x + getCanvasOffset(), position.y);
+        m_window->draw(ring);
+    }
+}
+
+/*! \brief Outlines the selected rectangle over the canvas while the select tool is in use
+ */
+void App::drawSelection() {
+    if (selectedMode != SELECT_MODE || selection.width <= 0 || selection.height <= 0) {
+        return;
     }
+
+    sf::Vector2f topLeft = toWindow(sf::Vector2f(selection.left, selection.top));
+    sf::RectangleShape outline(sf::Vector2f(selection.width * m_zoom, selection.height * m_zoom));
+    outline.setFillColor(sf::Color::Transparent);
+    outline.setOutlineThickness(1);
+    outline.setOutlineColor(sf::Color(128, 128, 128));
+    outline.setPosition(topLeft.x + getCanvasOffset(), topLeft.y);
+    m_window->draw(outline);
+}
+
+/*! \brief Returns the colour table the given user's messages are encoded with
+ */
+Palette &App::getPalette(const string &username) {
+    return m_palettes[username];
 }
 
 /*! \brief Returns the current radius
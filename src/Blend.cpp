@@ -0,0 +1,442 @@
+/**
+ *  @file   Blend.cpp
+ *  @brief  Blend implementation, with scalar, SSE4.1 and AVX2 kernels
+ *  @author Ellah
+ *  @date   2021-12-20
+ ***********************************************/
+
+// Include standard library C++ libraries.
+#include <algorithm>
+#include <cstring>
+// Project header files
+#include "Blend.hpp"
+using namespace std;
+
+// The vectorised kernels are compiled for their instruction set function by function, so the rest of the
+// program still runs on any x86 processor, and only when the compiler can do that
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define BLEND_X86
+#include <immintrin.h>
+#endif
+
+// Spans are blended as arrays of packed RGBA bytes
+static_assert(sizeof(sf::Color) == 4, "sf::Color is packed RGBA");
+
+typedef void (*ColorSpanKernel)(BlendMode, sf::Color *, const sf::Uint8 *, unsigned int, sf::Color);
+typedef void (*PixelSpanKernel)(sf::Color *, const sf::Color *, unsigned int, sf::Uint8);
+
+/*! \brief 	Returns x / 255 rounded to nearest, for x up to 255 * 255. Every kernel rounds the same way.
+*
+*/
+static inline unsigned int div255(unsigned int x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+/*! \brief 	Blends one channel. s and d are the channel, sa and da the alpha of the source and destination.
+*
+*/
+static inline sf::Uint8 blendChannel(BlendMode mode, unsigned int s, unsigned int d, unsigned int sa,
+                                     unsigned int da) {
+    unsigned int out;
+    switch (mode) {
+        case BLEND_MULTIPLY:
+            out = div255(s * d) + div255(s * (255 - da)) + div255(d * (255 - sa));
+            break;
+        case BLEND_SCREEN:
+            out = s + d - div255(s * d);
+            break;
+        case BLEND_ERASE:
+            out = div255(d * (255 - sa));
+            break;
+        default:
+            out = s + div255(d * (255 - sa));
+            break;
+    }
+    return min(out, 255u);
+}
+
+/*! \brief 	Blends a colour into a pixel at the given coverage
+*
+*/
+static inline void blendPixel(BlendMode mode, sf::Color &dst, sf::Color color, unsigned int coverage) {
+    unsigned int r = div255(color.r * coverage), g = div255(color.g * coverage), b = div255(color.b * coverage);
+    unsigned int a = div255(color.a * coverage), da = dst.a;
+    dst.r = blendChannel(mode, r, dst.r, a, da);
+    dst.g = blendChannel(mode, g, dst.g, a, da);
+    dst.b = blendChannel(mode, b, dst.b, a, da);
+    dst.a = blendChannel(mode, a, da, a, da);
+}
+
+/*! \brief 	Scalar colour span, also used for what is left after the vectorised kernels' last full block
+*
+*/
+static void colorSpanScalar(BlendMode mode, sf::Color *dst, const sf::Uint8 *coverage, unsigned int count,
+                            sf::Color color) {
+    for (unsigned int i = 0; i < count; i++) {
+        if (coverage[i]) {
+            blendPixel(mode, dst[i], color, coverage[i]);
+        }
+    }
+}
+
+/*! \brief 	Scalar pixel span, also used for what is left after the vectorised kernels' last full block
+*
+*/
+static void pixelSpanScalar(sf::Color *dst, const sf::Color *src, unsigned int count, sf::Uint8 opacity) {
+    for (unsigned int i = 0; i < count; i++) {
+        if (src[i].a) {
+            blendPixel(BLEND_NORMAL, dst[i], src[i], opacity);
+        }
+    }
+}
+
+#ifdef BLEND_X86
+
+// Both vectorised kernels widen pixels to 16 bits per channel, where every product of two channels fits,
+// and blend two pixels per 128 bits with the same formulas as blendChannel.
+
+/*! \brief 	div255 on each 16 bit lane
+*
+*/
+__attribute__((target("sse4.1"))) static inline __m128i div255x8(__m128i x) {
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+/*! \brief 	Copies each pixel's alpha lane over its colour lanes
+*
+*/
+__attribute__((target("sse4.1"))) static inline __m128i alphax8(__m128i x) {
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xFF), 0xFF);
+}
+
+/*! \brief 	Blends two widened pixels. s is the source already scaled by its coverage.
+*
+*/
+template<int Mode>
+__attribute__((target("sse4.1"))) static inline __m128i blendx8(__m128i s, __m128i d) {
+    const __m128i full = _mm_set1_epi16(255);
+    __m128i inverse = _mm_sub_epi16(full, alphax8(s));
+    switch (Mode) {
+        case BLEND_MULTIPLY:
+            return _mm_add_epi16(_mm_add_epi16(div255x8(_mm_mullo_epi16(s, d)),
+                                               div255x8(_mm_mullo_epi16(s, _mm_sub_epi16(full, alphax8(d))))),
+                                 div255x8(_mm_mullo_epi16(d, inverse)));
+        case BLEND_SCREEN:
+            return _mm_sub_epi16(_mm_add_epi16(s, d), div255x8(_mm_mullo_epi16(s, d)));
+        case BLEND_ERASE:
+            return div255x8(_mm_mullo_epi16(d, inverse));
+        default:
+            return _mm_add_epi16(s, div255x8(_mm_mullo_epi16(d, inverse)));
+    }
+}
+
+/*! \brief 	SSE4.1 colour span, four pixels at a time
+*
+*/
+template<int Mode>
+__attribute__((target("sse4.1"))) static void colorSpanSSE41(sf::Color *dst, const sf::Uint8 *coverage,
+                                                             unsigned int count, sf::Color color) {
+    const __m128i color16 = _mm_setr_epi16(color.r, color.g, color.b, color.a, color.r, color.g, color.b, color.a);
+    // Repeats each of four coverage bytes over the four channels of its pixel
+    const __m128i spread = _mm_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3);
+    unsigned int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        sf::Uint32 covered;
+        memcpy(&covered, coverage + i, sizeof(covered));
+        if (!covered) {
+            continue;
+        }
+        __m128i cover = _mm_shuffle_epi8(_mm_cvtsi32_si128((int)covered), spread);
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+
+        __m128i low = blendx8<Mode>(div255x8(_mm_mullo_epi16(color16, _mm_cvtepu8_epi16(cover))),
+                                    _mm_cvtepu8_epi16(pixels));
+        __m128i high = blendx8<Mode>(div255x8(_mm_mullo_epi16(color16, _mm_cvtepu8_epi16(_mm_srli_si128(cover, 8)))),
+                                     _mm_cvtepu8_epi16(_mm_srli_si128(pixels, 8)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(low, high));
+    }
+
+    colorSpanScalar((BlendMode)Mode, dst + i, coverage + i, count - i, color);
+}
+
+/*! \brief 	SSE4.1 pixel span, four pixels at a time
+*
+*/
+__attribute__((target("sse4.1"))) static void pixelSpanSSE41(sf::Color *dst, const sf::Color *src, unsigned int count,
+                                                            sf::Uint8 opacity) {
+    const __m128i opacity16 = _mm_set1_epi16(opacity);
+    unsigned int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i source = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        // Transparent pixels, e.g. most of a sparsely painted layer, change nothing
+        if (_mm_testz_si128(source, source)) {
+            continue;
+        }
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+
+        __m128i low = blendx8<BLEND_NORMAL>(div255x8(_mm_mullo_epi16(_mm_cvtepu8_epi16(source), opacity16)),
+                                            _mm_cvtepu8_epi16(pixels));
+        __m128i high = blendx8<BLEND_NORMAL>(
+                div255x8(_mm_mullo_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(source, 8)), opacity16)),
+                _mm_cvtepu8_epi16(_mm_srli_si128(pixels, 8)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(low, high));
+    }
+
+    pixelSpanScalar(dst + i, src + i, count - i, opacity);
+}
+
+/*! \brief 	Picks the SSE4.1 colour span for a mode
+*
+*/
+static void colorSpanSSE41(BlendMode mode, sf::Color *dst, const sf::Uint8 *coverage, unsigned int count,
+                           sf::Color color) {
+    switch (mode) {
+        case BLEND_MULTIPLY:
+            colorSpanSSE41<BLEND_MULTIPLY>(dst, coverage, count, color);
+            break;
+        case BLEND_SCREEN:
+            colorSpanSSE41<BLEND_SCREEN>(dst, coverage, count, color);
+            break;
+        case BLEND_ERASE:
+            colorSpanSSE41<BLEND_ERASE>(dst, coverage, count, color);
+            break;
+        default:
+            colorSpanSSE41<BLEND_NORMAL>(dst, coverage, count, color);
+            break;
+    }
+}
+
+/*! \brief 	div255 on each 16 bit lane
+*
+*/
+__attribute__((target("avx2"))) static inline __m256i div255x16(__m256i x) {
+    x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+/*! \brief 	Copies each pixel's alpha lane over its colour lanes
+*
+*/
+__attribute__((target("avx2"))) static inline __m256i alphax16(__m256i x) {
+    return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(x, 0xFF), 0xFF);
+}
+
+/*! \brief 	Blends four widened pixels. s is the source already scaled by its coverage.
+*
+*/
+template<int Mode>
+__attribute__((target("avx2"))) static inline __m256i blendx16(__m256i s, __m256i d) {
+    const __m256i full = _mm256_set1_epi16(255);
+    __m256i inverse = _mm256_sub_epi16(full, alphax16(s));
+    switch (Mode) {
+        case BLEND_MULTIPLY:
+            return _mm256_add_epi16(
+                    _mm256_add_epi16(div255x16(_mm256_mullo_epi16(s, d)),
+                                     div255x16(_mm256_mullo_epi16(s, _mm256_sub_epi16(full, alphax16(d))))),
+                    div255x16(_mm256_mullo_epi16(d, inverse)));
+        case BLEND_SCREEN:
+            return _mm256_sub_epi16(_mm256_add_epi16(s, d), div255x16(_mm256_mullo_epi16(s, d)));
+        case BLEND_ERASE:
+            return div255x16(_mm256_mullo_epi16(d, inverse));
+        default:
+            return _mm256_add_epi16(s, div255x16(_mm256_mullo_epi16(d, inverse)));
+    }
+}
+
+/*! \brief 	Packs two blocks of four widened pixels back into eight pixels in order
+*
+*/
+__attribute__((target("avx2"))) static inline __m256i packx16(__m256i low, __m256i high) {
+    // Packing works within each 128 bit half, which leaves the pixel pairs as 0-1, 4-5, 2-3, 6-7
+    return _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), 0xD8);
+}
+
+/*! \brief 	AVX2 colour span, eight pixels at a time
+*
+*/
+template<int Mode>
+__attribute__((target("avx2"))) static void colorSpanAVX2(sf::Color *dst, const sf::Uint8 *coverage,
+                                                          unsigned int count, sf::Color color) {
+    const __m256i color16 = _mm256_setr_epi16(color.r, color.g, color.b, color.a, color.r, color.g, color.b, color.a,
+                                              color.r, color.g, color.b, color.a, color.r, color.g, color.b, color.a);
+    const __m128i spread = _mm_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3);
+    unsigned int i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        sf::Uint32 covered[2];
+        memcpy(covered, coverage + i, sizeof(covered));
+        if (!covered[0] && !covered[1]) {
+            continue;
+        }
+        __m128i lowCover = _mm_shuffle_epi8(_mm_cvtsi32_si128((int)covered[0]), spread);
+        __m128i highCover = _mm_shuffle_epi8(_mm_cvtsi32_si128((int)covered[1]), spread);
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+
+        __m256i low = blendx16<Mode>(div255x16(_mm256_mullo_epi16(color16, _mm256_cvtepu8_epi16(lowCover))),
+                                     _mm256_cvtepu8_epi16(_mm256_castsi256_si128(pixels)));
+        __m256i high = blendx16<Mode>(div255x16(_mm256_mullo_epi16(color16, _mm256_cvtepu8_epi16(highCover))),
+                                      _mm256_cvtepu8_epi16(_mm256_extracti128_si256(pixels, 1)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), packx16(low, high));
+    }
+
+    colorSpanScalar((BlendMode)Mode, dst + i, coverage + i, count - i, color);
+}
+
+/*! \brief 	AVX2 pixel span, eight pixels at a time
+*
+*/
+__attribute__((target("avx2"))) static void pixelSpanAVX2(sf::Color *dst, const sf::Color *src, unsigned int count,
+                                                         sf::Uint8 opacity) {
+    const __m256i opacity16 = _mm256_set1_epi16(opacity);
+    unsigned int i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256i source = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        if (_mm256_testz_si256(source, source)) {
+            continue;
+        }
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+
+        __m256i low = blendx16<BLEND_NORMAL>(
+                div255x16(_mm256_mullo_epi16(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(source)), opacity16)),
+                _mm256_cvtepu8_epi16(_mm256_castsi256_si128(pixels)));
+        __m256i high = blendx16<BLEND_NORMAL>(
+                div255x16(_mm256_mullo_epi16(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(source, 1)), opacity16)),
+                _mm256_cvtepu8_epi16(_mm256_extracti128_si256(pixels, 1)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), packx16(low, high));
+    }
+
+    pixelSpanScalar(dst + i, src + i, count - i, opacity);
+}
+
+/*! \brief 	Picks the AVX2 colour span for a mode
+*
+*/
+static void colorSpanAVX2(BlendMode mode, sf::Color *dst, const sf::Uint8 *coverage, unsigned int count,
+                          sf::Color color) {
+    switch (mode) {
+        case BLEND_MULTIPLY:
+            colorSpanAVX2<BLEND_MULTIPLY>(dst, coverage, count, color);
+            break;
+        case BLEND_SCREEN:
+            colorSpanAVX2<BLEND_SCREEN>(dst, coverage, count, color);
+            break;
+        case BLEND_ERASE:
+            colorSpanAVX2<BLEND_ERASE>(dst, coverage, count, color);
+            break;
+        default:
+            colorSpanAVX2<BLEND_NORMAL>(dst, coverage, count, color);
+            break;
+    }
+}
+
+#endif
+
+// The kernels in use, chosen on first use
+static ColorSpanKernel s_colorSpan = nullptr;
+static PixelSpanKernel s_pixelSpan = nullptr;
+static BlendKernel s_kernel = KERNEL_SCALAR;
+
+/*! \brief 	Uses the fastest kernel the processor supports, unless one was set already
+*
+*/
+static void chooseKernel() {
+    if (s_colorSpan) {
+        return;
+    }
+    if (!Blend::setKernel(KERNEL_AVX2) && !Blend::setKernel(KERNEL_SSE41)) {
+        Blend::setKernel(KERNEL_SCALAR);
+    }
+}
+
+/*! \brief 	Blends a colour into a span of pixels by their coverage
+*
+*/
+void Blend::colorSpan(BlendMode mode, sf::Color *dst, const sf::Uint8 *coverage, unsigned int count,
+                      sf::Color color) {
+    chooseKernel();
+    s_colorSpan(mode, dst, coverage, count, color);
+}
+
+/*! \brief 	Blends a span of pixels over another at an opacity
+*
+*/
+void Blend::pixelSpan(sf::Color *dst, const sf::Color *src, unsigned int count, sf::Uint8 opacity) {
+    chooseKernel();
+    s_pixelSpan(dst, src, count, opacity);
+}
+
+/*! \brief 	Scales a colour by its alpha
+*
+*/
+sf::Color Blend::premultiply(sf::Color color) {
+    return sf::Color(div255(color.r * color.a), div255(color.g * color.a), div255(color.b * color.a), color.a);
+}
+
+/*! \brief 	Undoes premultiply, as near as 8 bits allow
+*
+*/
+sf::Color Blend::unpremultiply(sf::Color color) {
+    if (color.a == 255) {
+        return color;
+    }
+    if (color.a == 0) {
+        return sf::Color::Transparent;
+    }
+    return sf::Color(min(255, (color.r * 255 + color.a / 2) / color.a),
+                     min(255, (color.g * 255 + color.a / 2) / color.a),
+                     min(255, (color.b * 255 + color.a / 2) / color.a), color.a);
+}
+
+/*! \brief 	Returns whether the processor can run a kernel
+*
+*/
+bool Blend::isSupported(BlendKernel kernel) {
+    switch (kernel) {
+        case KERNEL_SCALAR:
+            return true;
+#ifdef BLEND_X86
+        case KERNEL_SSE41:
+            return __builtin_cpu_supports("sse4.1");
+        case KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+/*! \brief 	Switches kernel, e.g. to compare them
+*
+*/
+bool Blend::setKernel(BlendKernel kernel) {
+    if (!isSupported(kernel)) {
+        return false;
+    }
+
+    s_kernel = kernel;
+    s_colorSpan = colorSpanScalar;
+    s_pixelSpan = pixelSpanScalar;
+#ifdef BLEND_X86
+    if (kernel == KERNEL_SSE41) {
+        s_colorSpan = colorSpanSSE41;
+        s_pixelSpan = pixelSpanSSE41;
+    } else if (kernel == KERNEL_AVX2) {
+        s_colorSpan = colorSpanAVX2;
+        s_pixelSpan = pixelSpanAVX2;
+    }
+#endif
+    return true;
+}
+
+/*! \brief 	Returns the kernel in use
+*
+*/
+BlendKernel Blend::getKernel() {
+    chooseKernel();
+    return s_kernel;
+}
@@ -26,7 +26,7 @@ bool BrushStroke::operator==(Command &cmd) const {
 
     // Dynamic cast to get the other BrushStroke's collection of DrawBrushes
     BrushStroke *other = dynamic_cast<BrushStroke *>(&cmd);
-    deque<DrawBrush> otherDraws = other->getDraws();
+    const deque<DrawBrush> &otherDraws = other->m_draws;
 
     if (m_draws.size() != otherDraws.size()) {
         return false;
@@ -48,7 +48,7 @@ bool BrushStroke::operator==(Command &cmd) const {
 *
 */
 bool BrushStroke::execute() {
-    for (DrawBrush draw: m_draws) {
+    for (DrawBrush &draw: m_draws) {
         draw.execute();
     }
 
@@ -59,34 +59,30 @@ bool BrushStroke::execute() {
 *
 */
 bool BrushStroke::undo() {
-    stack<DrawBrush> drawStack;
-
-    for (DrawBrush draw: m_draws) {
-        drawStack.push(draw);
-    }
-
-    while (!drawStack.empty()) {
-        drawStack.top().undo();
-        drawStack.pop();
+    // Last drawn first, so each brush puts back what was there before it
+    for (auto draw = m_draws.rbegin(); draw != m_draws.rend(); draw++) {
+        draw->undo();
     }
 
     return true;
 }
 
-deque<DrawBrush> BrushStroke::getDraws() {
-    return deque(m_draws);
+const deque<DrawBrush> &BrushStroke::getDraws() const {
+    return m_draws;
 }
 
-void BrushStroke::addAndExecuteDraw(DrawBrush newDraw) {
-    if (!m_draws.empty()) {
-        DrawBrush previousDraw = m_draws.back();
-        if (newDraw == previousDraw) {
-            return;
-        }
+void BrushStroke::addAndExecuteDraw(const DrawBrush &newDraw) {
+    m_draws.push_back(newDraw);
+    executeNewestDraw();
+}
+
+void BrushStroke::executeNewestDraw() {
+    if (m_draws.size() > 1 && m_draws.back() == m_draws[m_draws.size() - 2]) {
+        m_draws.pop_back();
+        return;
     }
 
-    m_draws.push_back(newDraw);
-    newDraw.execute();
+    m_draws.back().execute();
 }
 
 [[maybe_unused]] void BrushStroke::addAndExecuteCommand(Command *command) {
@@ -100,32 +96,40 @@ void BrushStroke::addAndExecuteDraw(DrawBrush newDraw) {
     }
 }
 
-void BrushStroke::interpolate(DrawBrush newestDraw) {
+void BrushStroke::continueFrom(const DrawBrush &drawn) {
+    m_draws.push_back(drawn);
+    if (m_draws.size() > 1 && m_draws.back() == m_draws[m_draws.size() - 2]) {
+        m_draws.pop_back();
+    }
+}
+
+void BrushStroke::interpolate(const DrawBrush &newestDraw) {
+    TraceSpan span("interpolate", "stroke");
     if (m_draws.size() < 2) {
         return;
     }
 
-    DrawBrush previousDraw = m_draws.back();
-    unsigned int x1 = previousDraw.m_posX;
-    unsigned int x2 = newestDraw.m_posX;
-    unsigned int y1 = previousDraw.m_posY;
-    unsigned int y2 = newestDraw.m_posY;
+    // Positions in steps of 1 / SUBPIXEL_STEPS of a pixel, so the dabs in between follow the line exactly
+    const DrawBrush &previousDraw = m_draws.back();
+    int steps = DrawBrush::SUBPIXEL_STEPS;
+    int x1 = static_cast<int>(previousDraw.m_posX) * steps + previousDraw.m_subX;
+    int x2 = static_cast<int>(newestDraw.m_posX) * steps + newestDraw.m_subX;
+    int y1 = static_cast<int>(previousDraw.m_posY) * steps + previousDraw.m_subY;
+    int y2 = static_cast<int>(newestDraw.m_posY) * steps + newestDraw.m_subY;
 
-    int distX = static_cast<int>(x1 - x2);
-    int distY = static_cast<int>(y1 - y2);
-    double distance = sqrt(pow(distX, 2) + pow(distY, 2) * 1.0);
+    int distX = x1 - x2;
+    int distY = y1 - y2;
+    double distance = sqrt(pow(distX, 2) + pow(distY, 2) * 1.0) / steps;
 
     for (int i = 1; i <= distance; i++) {
-        int newX = distX == 0 ?
-                   static_cast<int>(x1) :
-                   static_cast<int>(x1 - round(i * distX / distance));
-        int newY = distY == 0 ?
-                   static_cast<int>(y1) :
-                   static_cast<int>(y1 - round(i * distY / distance));
-
-        DrawBrush interDraw = DrawBrush(newestDraw.getImage(), newX, newY, newestDraw.m_radius, newestDraw.m_newColor);
-
-        addAndExecuteDraw(interDraw);
+        int newX = x1 - static_cast<int>(lround(i * distX / distance));
+        int newY = y1 - static_cast<int>(lround(i * distY / distance));
+
+        // Made in place, copying a DrawBrush copies what was under it
+        m_draws.emplace_back(newestDraw.getImage(), newX / steps, newY / steps, newestDraw.m_radius,
+                             newestDraw.m_newColor, newestDraw.m_opacity, newestDraw.m_mode, newX % steps,
+                             newY % steps);
+        executeNewestDraw();
     }
 }
 
@@ -0,0 +1,412 @@
+/**
+ *  @file   Canvas.cpp
+ *  @brief  Canvas implementation
+ *  @author Ellah
+ *  @date   2021-12-18
+ ***********************************************/
+
+// Include standard library C++ libraries.
+#include <algorithm>
+#include <cstring>
+// Project header files
+#include "Canvas.hpp"
+using namespace std;
+
+// Rows of a tile are copied straight into texture memory
+static_assert(sizeof(sf::Color) == 4, "sf::Color is packed RGBA");
+
+sf::Uint64 Canvas::s_version = 0;
+
+/*! \brief 	Canvas constructor, an empty canvas until created
+*
+*/
+Canvas::Canvas() : m_width(0), m_height(0), m_levels(0), m_recreated(true) {}
+
+/*! \brief 	Drops every tile, so clearing is as cheap as the tile table however much was drawn
+*
+*/
+void Canvas::create(unsigned int width, unsigned int height, sf::Color background) {
+    m_width = min(width, MAX_SIZE);
+    m_height = min(height, MAX_SIZE);
+    m_background = background;
+
+    m_levels = 1;
+    while (getTileGrid(m_levels - 1).x > 1 || getTileGrid(m_levels - 1).y > 1) {
+        m_levels++;
+    }
+
+    m_tiles.assign(m_levels, {});
+    m_stale.assign(m_levels, {});
+    m_reported.assign(m_levels, {});
+    m_versions.assign(m_levels, {});
+    for (unsigned int level = 0; level < m_levels; level++) {
+        unsigned int count = getTileGrid(level).x * getTileGrid(level).y;
+        m_tiles[level].resize(count);
+        m_stale[level].resize(count);
+        m_reported[level].resize(count);
+        // Versions keep counting up, so copies made before this still see every tile as changed
+        m_versions[level].assign(count, ++s_version);
+    }
+
+    m_changed.clear();
+    m_listed.assign(m_tiles[0].size(), false);
+    m_recreated = true;
+}
+
+/*! \brief 	Returns where a tile is kept within its level
+*
+*/
+unsigned int Canvas::tileIndex(unsigned int level, unsigned int column, unsigned int row) const {
+    return row * getTileGrid(level).x + column;
+}
+
+/*! \brief 	Marks the tiles above a changed level 0 tile as stale, stopping at the first that already is
+*
+*/
+void Canvas::markChanged(unsigned int column, unsigned int row) {
+    for (unsigned int level = 0; level + 1 < m_levels; level++) {
+        unsigned int index = tileIndex(level, column, row);
+        if (m_reported[level][index]) {
+            return;
+        }
+        m_reported[level][index] = true;
+        column /= 2;
+        row /= 2;
+        m_stale[level + 1][tileIndex(level + 1, column, row)] = true;
+    }
+}
+
+/*! \brief 	Paints a pixel, allocating its tile the first time it differs from the background
+*
+*/
+void Canvas::setPixel(unsigned int x, unsigned int y, sf::Color color) {
+    if (x >= m_width || y >= m_height) {
+        return;
+    }
+
+    unsigned int column = x / TILE_SIZE, row = y / TILE_SIZE;
+    unsigned int index = tileIndex(0, column, row);
+    vector<sf::Color> &tile = m_tiles[0][index];
+    if (tile.empty()) {
+        if (color == m_background) {
+            return;
+        }
+        tile.assign(TILE_SIZE * TILE_SIZE, m_background);
+    }
+    tile[(y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE] = color;
+    touch(column, row);
+}
+
+/*! \brief 	Gives a changed level 0 tile a new version and marks it for the levels above and takeChangedTiles
+*
+*/
+void Canvas::touch(unsigned int column, unsigned int row) {
+    unsigned int index = tileIndex(0, column, row);
+    m_versions[0][index] = ++s_version;
+    if (!m_reported[0][index]) {
+        markChanged(column, row);
+    }
+    if (!m_listed[index]) {
+        m_listed[index] = true;
+        m_changed.push_back(index);
+    }
+}
+
+/*! \brief 	Replaces a whole level 0 tile, leaving it blank if no pixels are given
+*
+*/
+void Canvas::setTile(unsigned int column, unsigned int row, const vector<sf::Color> &pixels) {
+    vector<sf::Color> &tile = m_tiles[0][tileIndex(0, column, row)];
+    if (tile.empty() && pixels.empty()) {
+        return;
+    }
+    tile = pixels;
+    touch(column, row);
+}
+
+/*! \brief 	Copies a level 0 tile from another canvas. Keeping its version tells later copies that the two
+*		tiles are the same.
+*
+*/
+void Canvas::copyTile(const Canvas &other, unsigned int column, unsigned int row) {
+    unsigned int index = tileIndex(0, column, row);
+    if (m_versions[0][index] == other.m_versions[0][index]) {
+        return;
+    }
+    m_tiles[0][index] = other.m_tiles[0][index];
+    touch(column, row);
+    m_versions[0][index] = other.m_versions[0][index];
+}
+
+/*! \brief 	Hands out the level 0 tiles changed since the last call, so a copy can follow only those
+*
+*/
+bool Canvas::takeChangedTiles(vector<unsigned int> &tiles) {
+    bool recreated = m_recreated;
+    for (unsigned int index: m_changed) {
+        m_listed[index] = false;
+    }
+    if (!recreated) {
+        tiles.insert(tiles.end(), m_changed.begin(), m_changed.end());
+    }
+    m_changed.clear();
+    m_recreated = false;
+    return recreated;
+}
+
+/*! \brief 	Gives direct access to part of a row, so a dab can be blended a span at a time
+*
+*/
+sf::Color *Canvas::editSpan(unsigned int x, unsigned int y, unsigned int &count) {
+    unsigned int column = x / TILE_SIZE, row = y / TILE_SIZE;
+    vector<sf::Color> &tile = m_tiles[0][tileIndex(0, column, row)];
+    if (tile.empty()) {
+        tile.assign(TILE_SIZE * TILE_SIZE, m_background);
+    }
+    count = min(count, TILE_SIZE - x % TILE_SIZE);
+    touch(column, row);
+    return &tile[(y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE];
+}
+
+/*! \brief 	Gives direct access to part of a row for reading, without allocating its tile
+*
+*/
+const sf::Color *Canvas::readSpan(unsigned int x, unsigned int y, unsigned int &count) const {
+    const vector<sf::Color> &tile = m_tiles[0][tileIndex(0, x / TILE_SIZE, y / TILE_SIZE)];
+    count = min(count, TILE_SIZE - x % TILE_SIZE);
+    if (tile.empty()) {
+        return nullptr;
+    }
+    return &tile[(y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE];
+}
+
+/*! \brief 	Returns the colour of a pixel
+*
+*/
+sf::Color Canvas::getPixel(unsigned int x, unsigned int y) const {
+    if (x >= m_width || y >= m_height) {
+        return m_background;
+    }
+
+    const vector<sf::Color> &tile = m_tiles[0][tileIndex(0, x / TILE_SIZE, y / TILE_SIZE)];
+    if (tile.empty()) {
+        return m_background;
+    }
+    return tile[(y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE];
+}
+
+/*! \brief 	Copies a region to RGBA pixels a row of tiles at a time. Outside the canvas is background.
+*
+*/
+void Canvas::copyTo(sf::Uint8 *pixels, unsigned int left, unsigned int top, unsigned int width,
+                    unsigned int height, unsigned int stride) const {
+    for (unsigned int row = 0; row < height; row++) {
+        unsigned int y = top + row;
+        sf::Color *out = reinterpret_cast<sf::Color *>(pixels) + row * stride;
+
+        for (unsigned int column = 0; column < width;) {
+            unsigned int x = left + column;
+            // Pixels left in this tile's row, or in the region
+            unsigned int run = min(width - column, TILE_SIZE - x % TILE_SIZE);
+
+            const vector<sf::Color> *tile = nullptr;
+            if (x < m_width && y < m_height) {
+                tile = &m_tiles[0][tileIndex(0, x / TILE_SIZE, y / TILE_SIZE)];
+                run = min(run, m_width - x);
+            }
+
+            if (tile && !tile->empty()) {
+                memcpy(out + column, &(*tile)[(y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE], run * sizeof(sf::Color));
+            } else {
+                fill(out + column, out + column + run, m_background);
+            }
+            column += run;
+        }
+    }
+}
+
+/*! \brief 	Copies RGBA pixels into a region a row of tiles at a time, the reverse of copyTo
+*
+*/
+void Canvas::copyFrom(const sf::Uint8 *pixels, unsigned int left, unsigned int top, unsigned int width,
+                      unsigned int height, unsigned int stride) {
+    for (unsigned int row = 0; row < height; row++) {
+        unsigned int y = top + row;
+        const sf::Color *in = reinterpret_cast<const sf::Color *>(pixels) + row * stride;
+
+        for (unsigned int column = 0; column < width;) {
+            unsigned int x = left + column;
+            unsigned int run = min(width - column, TILE_SIZE - x % TILE_SIZE);
+
+            // A blank tile stays blank where only background is copied into it
+            if (m_tiles[0][tileIndex(0, x / TILE_SIZE, y / TILE_SIZE)].empty() &&
+                all_of(in + column, in + column + run, [this](const sf::Color &color) {
+                    return memcmp(&color, &m_background, sizeof(sf::Color)) == 0;
+                })) {
+                column += run;
+                continue;
+            }
+
+            memcpy(editSpan(x, y, run), in + column, run * sizeof(sf::Color));
+            column += run;
+        }
+    }
+}
+
+/*! \brief 	Fills a region a span at a time. Filling with the background drops the tiles it covers whole
+*		and leaves blank tiles alone.
+*
+*/
+void Canvas::fillRect(unsigned int left, unsigned int top, unsigned int width, unsigned int height,
+                      sf::Color color) {
+    unsigned int right = min(left + width, m_width), bottom = min(top + height, m_height);
+    bool background = color == m_background;
+
+    for (unsigned int y = top; y < bottom; y++) {
+        for (unsigned int x = left; x < right;) {
+            unsigned int count = right - x;
+            unsigned int column = x / TILE_SIZE, row = y / TILE_SIZE;
+
+            if (background) {
+                bool whole = x % TILE_SIZE == 0 && y % TILE_SIZE == 0 && right >= min(x + TILE_SIZE, m_width) &&
+                             bottom >= min(y + TILE_SIZE, m_height);
+                if (whole) {
+                    setTile(column, row, {});
+                }
+                // The rest of the tile's rows find it blank
+                if (whole || m_tiles[0][tileIndex(0, column, row)].empty()) {
+                    x += min(count, TILE_SIZE - x % TILE_SIZE);
+                    continue;
+                }
+            }
+
+            sf::Color *span = editSpan(x, y, count);
+            fill(span, span + count, color);
+            x += count;
+        }
+    }
+}
+
+/*! \brief 	Returns a tile, rebuilding it from the level below if that changed since it was last built
+*
+*/
+const vector<sf::Color> &Canvas::getTile(unsigned int level, unsigned int column, unsigned int row) {
+    unsigned int index = tileIndex(level, column, row);
+    if (m_stale[level][index]) {
+        rebuild(level, column, row);
+    }
+    return m_tiles[level][index];
+}
+
+/*! \brief 	Averages each 2x2 block of the four tiles below into one quarter of this tile
+*
+*/
+void Canvas::rebuild(unsigned int level, unsigned int column, unsigned int row) {
+    unsigned int index = tileIndex(level, column, row);
+    unsigned int const half = TILE_SIZE / 2;
+    sf::Vector2u below = getTileGrid(level - 1);
+    vector<sf::Color> &tile = m_tiles[level][index];
+    tile.clear();
+
+    for (unsigned int quarter = 0; quarter < 4; quarter++) {
+        unsigned int childColumn = column * 2 + quarter % 2, childRow = row * 2 + quarter / 2;
+        if (childColumn >= below.x || childRow >= below.y) {
+            continue;
+        }
+
+        const vector<sf::Color> &child = getTile(level - 1, childColumn, childRow);
+        m_reported[level - 1][tileIndex(level - 1, childColumn, childRow)] = false;
+        if (child.empty()) {
+            continue;
+        }
+
+        if (tile.empty()) {
+            tile.assign(TILE_SIZE * TILE_SIZE, m_background);
+        }
+        sf::Color *out = &tile[(quarter / 2) * half * TILE_SIZE + (quarter % 2) * half];
+        for (unsigned int y = 0; y < half; y++) {
+            for (unsigned int x = 0; x < half; x++) {
+                const sf::Color *in = &child[2 * y * TILE_SIZE + 2 * x];
+                const sf::Color *next = in + TILE_SIZE;
+                out[y * TILE_SIZE + x] = sf::Color((in[0].r + in[1].r + next[0].r + next[1].r + 2) / 4,
+                                                   (in[0].g + in[1].g + next[0].g + next[1].g + 2) / 4,
+                                                   (in[0].b + in[1].b + next[0].b + next[1].b + 2) / 4,
+                                                   (in[0].a + in[1].a + next[0].a + next[1].a + 2) / 4);
+            }
+        }
+    }
+
+    m_stale[level][index] = false;
+    m_versions[level][index] = ++s_version;
+}
+
+/*! \brief 	Returns the canvas size in pixels
+*
+*/
+sf::Vector2u Canvas::getSize() const {
+    return sf::Vector2u(m_width, m_height);
+}
+
+/*! \brief 	Returns the colour of every pixel that was never painted
+*
+*/
+sf::Color Canvas::getBackground() const {
+    return m_background;
+}
+
+/*! \brief 	Returns the number of tiles holding painted pixels
+*
+*/
+unsigned long Canvas::getTileCount() const {
+    if (m_tiles.empty()) {
+        return 0;
+    }
+    return count_if(m_tiles[0].begin(), m_tiles[0].end(), [](const vector<sf::Color> &tile) { return !tile.empty(); });
+}
+
+/*! \brief 	Returns the number of levels in the pyramid, including the canvas itself
+*
+*/
+unsigned int Canvas::getLevels() const {
+    return m_levels;
+}
+
+/*! \brief 	Returns how many tiles across and down a level has
+*
+*/
+sf::Vector2u Canvas::getTileGrid(unsigned int level) const {
+    unsigned int span = TILE_SIZE << level;
+    return sf::Vector2u((m_width + span - 1) / span, (m_height + span - 1) / span);
+}
+
+/*! \brief 	Returns the version of a tile, which changes whenever its pixels do
+*
+*/
+sf::Uint64 Canvas::getTileVersion(unsigned int level, unsigned int column, unsigned int row) const {
+    return m_versions[level][tileIndex(level, column, row)];
+}
+
+/*! \brief 	Returns a hash of the canvas size and its pixels row by row, blank tiles counting as background
+*
+*/
+sf::Uint64 Canvas::getHash() const {
+    sf::Uint64 hash = 14695981039346656037ull;
+    auto add = [&hash](sf::Uint32 value) {
+        for (int i = 0; i < 4; i++) {
+            hash = (hash ^ ((value >> (8 * i)) & 0xFF)) * 1099511628211ull;
+        }
+    };
+
+    add(m_width);
+    add(m_height);
+    for (unsigned int y = 0; y < m_height; y++) {
+        for (unsigned int x = 0; x < m_width; x += TILE_SIZE) {
+            const vector<sf::Color> &tile = m_tiles[0][tileIndex(0, x / TILE_SIZE, y / TILE_SIZE)];
+            unsigned int end = min(m_width - x, (unsigned int)TILE_SIZE);
+            for (unsigned int i = 0; i < end; i++) {
+                add((tile.empty() ? m_background : tile[(y % TILE_SIZE) * TILE_SIZE + i]).toInteger());
+            }
+        }
+    }
+    return hash;
+}
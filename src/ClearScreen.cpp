@@ -12,14 +12,15 @@
 // Project header files
 #include "App.hpp"
 #include "ClearScreen.hpp"
+#include "Blend.hpp"
 using namespace std;
 
 ClearScreen::ClearScreen(App *app) : ClearScreen(
         &app->getImage(),
-        app->getBGColor(),
+        app->getEraseColor(),
         app->selectedColor) {}
 
-ClearScreen::ClearScreen(sf::Image *image, sf::Color prevColor, sf::Color newColor) :
+ClearScreen::ClearScreen(Canvas *image, sf::Color prevColor, sf::Color newColor) :
         Command(generateCommandDescription(prevColor, newColor)),
         m_image(image), m_prevColor(prevColor), m_newColor(newColor) {}
 
@@ -48,7 +49,8 @@ bool ClearScreen::operator==(Command &cmd) const {
 *
 */
 bool ClearScreen::execute() {
-    m_image->create(App::WINDOW_WIDTH, App::WINDOW_HEIGHT, m_newColor);
+    // The colour is picked straight, the canvas keeps it premultiplied
+    m_image->create(m_image->getSize().x, m_image->getSize().y, Blend::premultiply(m_newColor));
 
     return true;
 }
@@ -57,7 +59,7 @@ bool ClearScreen::execute() {
 *
 */
 bool ClearScreen::undo() {
-    m_image->create(App::WINDOW_WIDTH, App::WINDOW_HEIGHT, m_prevColor);
+    m_image->create(m_image->getSize().x, m_image->getSize().y, m_prevColor);
 
     return true;
 }
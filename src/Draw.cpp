@@ -22,10 +22,10 @@ Draw::Draw(App *app) : Draw(
         app->mouseY,
         app->selectedColor) {}
 
-Draw::Draw(sf::Image *image, unsigned int posX, unsigned int posY, sf::Color newColor) :
+Draw::Draw(Canvas *image, unsigned int posX, unsigned int posY, sf::Color newColor) :
         Draw(image, posX, posY, image->getPixel(posX, posY), newColor) {}
 
-Draw::Draw(sf::Image *image, unsigned int posX, unsigned int posY, sf::Color prevColor, sf::Color newColor) :
+Draw::Draw(Canvas *image, unsigned int posX, unsigned int posY, sf::Color prevColor, sf::Color newColor) :
         Command(generateCommandDescription(posX, posY, prevColor, newColor)),
         m_image(image), m_posX(posX), m_posY(posY), m_prevColor(prevColor), m_newColor(newColor) {}
 
@@ -82,7 +82,7 @@ bool Draw::undo() {
 *		we do not have to publicly expose it.
 *
 */
-sf::Image *Draw::getImage() {
+Canvas *Draw::getImage() {
     return m_image;
 }
 
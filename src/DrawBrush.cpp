@@ -8,8 +8,8 @@
 // Include our Third-Party SFML header
 #include <SFML/Graphics/Color.hpp>
 // Include standard library C++ libraries.
-#include <sstream>
-#include <cmath>
+#include <cstdio>
+#include <algorithm>
 // Project header files
 #include "App.hpp"
 #include "DrawBrush.hpp"
@@ -21,42 +21,104 @@ DrawBrush::DrawBrush(App *app) : DrawBrush(
         app->mouseX,
         app->mouseY,
         app->brushRadius,
-        app->selectedColor) {}
+        app->selectedColor,
+        app->brushOpacity,
+        app->blendMode) {}
 
-DrawBrush::DrawBrush(sf::Image *image, unsigned int posX, unsigned int posY, unsigned int rad, sf::Color newColor) :
+DrawBrush::DrawBrush(Canvas *image, unsigned int posX, unsigned int posY, unsigned int rad, sf::Color newColor,
+                     sf::Uint8 opacity, BlendMode mode, sf::Uint8 subX, sf::Uint8 subY) :
         Command(generateCommandDescription(posX, posY, rad, newColor)),
         m_image(image), m_posX(posX), m_posY(posY), m_radius(rad), //m_prevColors(prevColors),
-        m_newColor(newColor) {
+        m_newColor(newColor), m_opacity(opacity), m_mode(mode),
+        m_subX(subX % SUBPIXEL_STEPS), m_subY(subY % SUBPIXEL_STEPS) {
 
-    unsigned int minX = m_posX - m_radius;
-    unsigned int minY = m_posY - m_radius;
+    int minX = (int)m_posX - (int)m_radius;
+    int minY = (int)m_posY - (int)m_radius;
+    unsigned int size = 2 * rad + 2;
+    const vector<sf::Uint8> &mask = getMask(m_radius, m_subX, m_subY);
 
-    m_prevColors.resize(2 * rad, vector<sf::Color>(2 * rad));
+    // One block for the whole square, a dab is made for every step of a stroke
+    m_prevColors.resize(size * size);
 
-    for (unsigned int i = 0; i < 2 * rad; i++) {
-        for (unsigned int j = 0; j < 2 * rad; j++) {
-            if (sqrt((i - m_radius) * (i - m_radius) + (j - m_radius) * (j - m_radius)) <= m_radius
-                && minX + i >= 0 && minX + i < App::WINDOW_WIDTH && minY + j >= 0 && minY + j < App::WINDOW_HEIGHT) {
-                m_prevColors[i][j] = m_image->getPixel(minX + i, minY + j);
+    for (unsigned int i = 0; i < size; i++) {
+        for (unsigned int j = 0; j < size; j++) {
+            if (mask[j * size + i]
+                && minX + (int)i >= 0 && minX + i < m_image->getSize().x
+                && minY + (int)j >= 0 && minY + j < m_image->getSize().y) {
+                m_prevColors[j * size + i] = m_image->getPixel(minX + i, minY + j);
             }
         }
     }
 
 }
 
+map<unsigned int, vector<sf::Uint8>> DrawBrush::s_masks;
+
+/*! \brief 	Returns the coverage of the 2 * radius + 2 square of pixels starting radius pixels above and
+*		left of the dab's pixel. A pixel is covered where its centre is more than a pixel inside the
+*		circle, and not at all where it is outside, ramping in between.
+*		Worked out once per radius and phase in fixed point, so every client gets the same mask.
+*
+*/
+const vector<sf::Uint8> &DrawBrush::getMask(unsigned int radius, unsigned int subX, unsigned int subY) {
+    unsigned int key = (radius << (2 * SUBPIXEL_BITS)) | (subY << SUBPIXEL_BITS) | subX;
+    auto found = s_masks.find(key);
+    if (found != s_masks.end()) {
+        return found->second;
+    }
+
+    unsigned int size = 2 * radius + 2;
+    vector<sf::Uint8> &mask = s_masks[key];
+    mask.resize(size * size);
+
+    // Offsets of the dab's centre from the first pixel's centre, and its edge, in fixed point
+    sf::Int64 centreX = ((sf::Int64)radius << FIXED_BITS) + (subX << (FIXED_BITS - SUBPIXEL_BITS));
+    sf::Int64 centreY = ((sf::Int64)radius << FIXED_BITS) + (subY << (FIXED_BITS - SUBPIXEL_BITS));
+    sf::Int64 edge = (sf::Int64)radius << FIXED_BITS;
+
+    for (unsigned int j = 0; j < size; j++) {
+        sf::Int64 dy = ((sf::Int64)j << FIXED_BITS) - centreY;
+        for (unsigned int i = 0; i < size; i++) {
+            sf::Int64 dx = ((sf::Int64)i << FIXED_BITS) - centreX;
+            sf::Int64 inside = edge - squareRoot(dx * dx + dy * dy);
+            inside = max<sf::Int64>(0, min<sf::Int64>(FIXED_ONE, inside));
+            mask[j * size + i] = (inside * 255 + FIXED_ONE / 2) >> FIXED_BITS;
+        }
+    }
+    return mask;
+}
+
+/*! \brief 	Returns the integer square root of a value, rounded down
+*
+*/
+unsigned int DrawBrush::squareRoot(sf::Uint64 value) {
+    sf::Uint64 root = 0;
+    sf::Uint64 bit = (sf::Uint64)1 << 62;
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (unsigned int)root;
+}
+
 /*! \brief 	Helper function for building a commmand description string
-* using the a Draw's member variables
+* using the a Draw's member variables. Formatted in place, so the string is the only allocation.
 *
 */
 string DrawBrush::generateCommandDescription(
         unsigned int posX, unsigned int posY, unsigned int rad, sf::Color newColor) {
-    stringstream ss;
-    ss << "Color pixel (x=" << to_string(posX)
-       << ", y=" << to_string(posY)
-       << ") to (r=" << to_string(newColor.r) << ", g=" << to_string(newColor.g) << ", b="
-       << to_string(newColor.b) << ")"
-       << "with radius " << to_string(rad);
-    return ss.str();
+    char description[128];
+    snprintf(description, sizeof(description), "Color pixel (x=%u, y=%u) to (r=%u, g=%u, b=%u)with radius %u",
+             posX, posY, (unsigned int)newColor.r, (unsigned int)newColor.g, (unsigned int)newColor.b, rad);
+    return description;
 }
 
 /*! \brief 	Compares two commands to see if they're equal
@@ -74,23 +136,45 @@ bool DrawBrush::operator==(Command &cmd) const {
             this->m_posX == other->m_posX &&
             this->m_posY == other->m_posY &&
             this->m_radius == other->m_radius &&
-            this->m_newColor == other->m_newColor;
+            this->m_newColor == other->m_newColor &&
+            this->m_opacity == other->m_opacity &&
+            this->m_mode == other->m_mode &&
+            this->m_subX == other->m_subX &&
+            this->m_subY == other->m_subY;
 }
 
-/*! \brief 	Executes a drawbrush command
+/*! \brief 	Executes a drawbrush command, blending the dab a row span at a time by its coverage
 *
 */
 bool DrawBrush::execute() {
-    unsigned int minX = m_posX - m_radius;
-    unsigned int minY = m_posY - m_radius;
-    unsigned int size = m_radius + m_radius;
+    int minX = (int)m_posX - (int)m_radius;
+    int minY = (int)m_posY - (int)m_radius;
+    int size = (int)(2 * m_radius + 2);
+    const vector<sf::Uint8> &mask = getMask(m_radius, m_subX, m_subY);
+
+    // The opacity only scales the colour's own alpha, and the kernels take premultiplied colours
+    sf::Color color = m_newColor;
+    color.a = (color.a * m_opacity + 127) / 255;
+    color = Blend::premultiply(color);
+
+    // Clip the dab's square to the canvas
+    int left = max(0, -minX), right = min(size, (int)m_image->getSize().x - minX);
+    int top = max(0, -minY), bottom = min(size, (int)m_image->getSize().y - minY);
+
+    for (int j = top; j < bottom; j++) {
+        const sf::Uint8 *row = &mask[j * size];
+        int i = left;
+        for (; i < right && !row[i]; i++) {
+        }
+        int end = right;
+        for (; end > i && !row[end - 1]; end--) {
+        }
 
-    for (unsigned int i = 0; i < size; i++) {
-        for (unsigned int j = 0; j < size; j++) {
-            if (sqrt((i - m_radius) * (i - m_radius) + (j - m_radius) * (j - m_radius)) <= m_radius
-                && minX + i >= 0 && minX + i < App::WINDOW_WIDTH && minY + j >= 0 && minY + j < App::WINDOW_HEIGHT) {
-                m_image->setPixel(minX + i, minY + j, m_newColor);
-            }
+        while (i < end) {
+            unsigned int count = end - i;
+            sf::Color *span = m_image->editSpan(minX + i, minY + j, count);
+            Blend::colorSpan(m_mode, span, row + i, count, color);
+            i += (int)count;
         }
     }
 
@@ -102,14 +186,17 @@ bool DrawBrush::execute() {
 */
 bool DrawBrush::undo() {
 
-    unsigned int minX = m_posX - m_radius;
-    unsigned int minY = m_posY - m_radius;
-    unsigned int size = 2 * m_radius;
+    int minX = (int)m_posX - (int)m_radius;
+    int minY = (int)m_posY - (int)m_radius;
+    unsigned int size = 2 * m_radius + 2;
+    const vector<sf::Uint8> &mask = getMask(m_radius, m_subX, m_subY);
 
     for (unsigned int i = 0; i < size; i++) {
         for (unsigned int j = 0; j < size; j++) {
-            if (sqrt((i - m_radius) * (i - m_radius) + (j - m_radius) * (j - m_radius)) <= m_radius) {
-                m_image->setPixel(minX + i, minY + j, m_prevColors[i][j]);
+            if (mask[j * size + i]
+                && minX + (int)i >= 0 && minX + i < m_image->getSize().x
+                && minY + (int)j >= 0 && minY + j < m_image->getSize().y) {
+                m_image->setPixel(minX + i, minY + j, m_prevColors[j * size + i]);
             }
         }
     }
@@ -121,7 +208,7 @@ bool DrawBrush::undo() {
 *		we do not have to publicly expose it.
 *
 */
-sf::Image *DrawBrush::getImage() {
+Canvas *DrawBrush::getImage() const {
     return m_image;
 }
 
@@ -22,9 +22,9 @@ Eraser::Eraser(App *app) : Eraser(
         app->mouseX,
         app->mouseY,
         app->brushRadius,
-        app->backgroundColor) {}
+        app->getEraseColor()) {}
 
-Eraser::Eraser(sf::Image *image, unsigned int posX, unsigned int posY, unsigned int rad, sf::Color newColor) :
+Eraser::Eraser(Canvas *image, unsigned int posX, unsigned int posY, unsigned int rad, sf::Color newColor) :
         Command(generateCommandDescription_b(posX, posY, rad, newColor)), m_image(image), m_posX(posX), m_posY(posY),
         m_radius(rad), m_newColor(newColor) {
     unsigned int minX = m_posX - m_radius;
@@ -35,14 +35,15 @@ Eraser::Eraser(sf::Image *image, unsigned int posX, unsigned int posY, unsigned
     for (unsigned int i = 0; i < 2 * rad; i++) {
         for (unsigned int j = 0; j < 2 * rad; j++) {
             if (sqrt((i - m_radius) * (i - m_radius) + (j - m_radius) * (j - m_radius)) <= m_radius
-                && minX + i >= 0 && minX + i < App::WINDOW_WIDTH && minY + j >= 0 && minY + j < App::WINDOW_HEIGHT) {
+                && minX + i >= 0 && minX + i < m_image->getSize().x
+                && minY + j >= 0 && minY + j < m_image->getSize().y) {
                 m_prevColors[i][j] = m_image->getPixel(minX + i, minY + j);
             }
         }
     }
 }
 
-Eraser::Eraser(sf::Image *image, unsigned int posX, unsigned int posY, unsigned int rad, sf::Color prevColor, sf::Color newColor) :
+Eraser::Eraser(Canvas *image, unsigned int posX, unsigned int posY, unsigned int rad, sf::Color prevColor, sf::Color newColor) :
         Command(generateCommandDescription_a(posX, posY, rad, prevColor, newColor)),
         m_image(image), m_posX(posX), m_posY(posY), m_radius(rad), //m_prevColor(prevColor),
         m_newColor(newColor) {
@@ -111,7 +112,8 @@ bool Eraser::execute() {
     for (unsigned int i = 0; i < size; i++) {
         for (unsigned int j = 0; j < size; j++) {
             if (sqrt((i - m_radius) * (i - m_radius) + (j - m_radius) * (j - m_radius)) <= m_radius
-                && minX + i >= 0 && minX + i < App::WINDOW_WIDTH && minY + j >= 0 && minY + j < App::WINDOW_HEIGHT) {
+                && minX + i >= 0 && minX + i < m_image->getSize().x
+                && minY + j >= 0 && minY + j < m_image->getSize().y) {
                 m_image->setPixel(minX + i, minY + j, m_newColor);
             }
         }
@@ -145,7 +147,7 @@ bool Eraser::undo() {
 *		we do not have to publicly expose it.
 *
 */
-sf::Image *Eraser::getImage() {
+Canvas *Eraser::getImage() {
     return m_image;
 }
 
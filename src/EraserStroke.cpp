@@ -105,6 +105,16 @@ void EraserStroke::addAndExecuteDraw(Eraser newEraser) {
     }
 }
 
+/*! \brief 	Adds an eraser command that was already executed, to interpolate the next one from
+*
+*/
+void EraserStroke::continueFrom(const Eraser &erased) {
+    m_eraser.push_back(erased);
+    if (m_eraser.size() > 1 && m_eraser.back() == m_eraser[m_eraser.size() - 2]) {
+        m_eraser.pop_back();
+    }
+}
+
 void EraserStroke::interpolate(Eraser newestEraser) {
     if (m_eraser.size() < 2) {
         return;
@@ -0,0 +1,176 @@
+/**
+ *  @file   EventTrace.cpp
+ *  @brief  EventTrace implementation
+ *  @author Ellah
+ *  @date   2021-12-23
+ ***********************************************/
+
+// Include standard library C++ libraries.
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+// Project header files
+#include "EventTrace.hpp"
+using namespace std;
+
+mutex EventTrace::s_mutex;
+ofstream EventTrace::s_file;
+atomic<bool> EventTrace::s_enabled(false);
+sf::Uint32 EventTrace::s_process = 0;
+unsigned int EventTrace::s_unflushed = 0;
+
+// Phases of the flow events, in FlowPhase order
+static const char *const FLOW_PHASES[] = {"s", "t", "f"};
+
+/*! \brief 	Returns the 64 bit FNV-1a hash of some text
+*
+*/
+static sf::Uint64 hashText(const string &text) {
+    sf::Uint64 hash = 14695981039346656037ULL;
+    for (char c: text) {
+        hash = (hash ^ (sf::Uint8)c) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/*! \brief 	Opens the file, replacing it, and names this process in it
+*
+*/
+bool EventTrace::start(const string &path, const string &process) {
+    lock_guard<mutex> lock(s_mutex);
+    if (s_file.is_open()) {
+        s_file.close();
+    }
+    s_file.open(path, ios::trunc);
+    if (!s_file.is_open()) {
+        return false;
+    }
+
+    // Viewers want a positive 32 bit process id, which has to differ between the clients and the server
+    s_process = (sf::Uint32)(hashText(process) & 0x7FFFFFFF);
+    s_unflushed = 0;
+    s_file << "[\n";
+    s_file << R"({"name":"process_name","ph":"M","pid":)" << s_process << R"(,"tid":0,"args":{"name":")"
+           << escape(process) << "\"}},\n";
+    s_enabled = true;
+    return true;
+}
+
+/*! \brief 	Writes what is still buffered and closes the file. The closing bracket is optional in the
+*		array format, and leaving it out keeps traces easy to merge.
+*
+*/
+void EventTrace::stop() {
+    lock_guard<mutex> lock(s_mutex);
+    s_enabled = false;
+    if (s_file.is_open()) {
+        s_file.close();
+    }
+}
+
+/*! \brief 	Returns whether events are being written
+*
+*/
+bool EventTrace::isEnabled() {
+    return s_enabled;
+}
+
+/*! \brief 	Returns the microseconds since the epoch
+*
+*/
+sf::Int64 EventTrace::now() {
+    return chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/*! \brief 	Returns a number identifying the calling thread, given out in the order threads first ask
+*
+*/
+sf::Uint32 EventTrace::getThread() {
+    static atomic<sf::Uint32> threads(0);
+    thread_local sf::Uint32 thread = ++threads;
+    return thread;
+}
+
+/*! \brief 	Writes an event on its own line, flushing every FLUSH_INTERVAL events
+*
+*/
+void EventTrace::write(const string &event) {
+    lock_guard<mutex> lock(s_mutex);
+    if (!s_file.is_open()) {
+        return;
+    }
+    s_file << event << ",\n";
+    if (++s_unflushed >= FLUSH_INTERVAL) {
+        s_file.flush();
+        s_unflushed = 0;
+    }
+}
+
+/*! \brief 	Escapes the characters JSON strings cannot hold as they are
+*
+*/
+string EventTrace::escape(const string &text) {
+    string escaped;
+    for (char c: text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if ((sf::Uint8)c < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+/*! \brief 	Writes a complete span of the calling thread
+*
+*/
+void EventTrace::span(const char *name, const char *category, sf::Int64 start, sf::Int64 duration) {
+    if (!s_enabled) {
+        return;
+    }
+    stringstream event;
+    event << R"({"name":")" << name << R"(","cat":")" << category << R"(","ph":"X","ts":)" << start
+          << R"(,"dur":)" << duration << R"(,"pid":)" << s_process << R"(,"tid":)" << getThread() << "}";
+    write(event.str());
+}
+
+/*! \brief 	Writes a step of a message's way. Sending starts the flow at the span it is sent in,
+*		relaying and applying it bind to the span they happen in.
+*
+*/
+void EventTrace::flow(FlowPhase phase, const string &sender, unsigned long index) {
+    if (!s_enabled) {
+        return;
+    }
+    char id[24];
+    snprintf(id, sizeof(id), "0x%016llx", (unsigned long long)hashText(sender + '\n' + to_string(index)));
+
+    stringstream event;
+    event << R"({"name":"message","cat":"flow","ph":")" << FLOW_PHASES[phase] << R"(","id":")" << id
+          << R"(","ts":)" << now() << R"(,"pid":)" << s_process << R"(,"tid":)" << getThread();
+    if (phase != FLOW_SENT) {
+        event << R"(,"bp":"e")";
+    }
+    event << "}";
+    write(event.str());
+}
+
+/*! \brief 	Starts a span, if tracing
+*
+*/
+TraceSpan::TraceSpan(const char *name, const char *category) : m_name(name), m_category(category),
+                                                                m_start(EventTrace::isEnabled() ? EventTrace::now() : 0) {}
+
+/*! \brief 	Writes the span, if tracing since it started
+*
+*/
+TraceSpan::~TraceSpan() {
+    if (m_start != 0 && EventTrace::isEnabled()) {
+        EventTrace::span(m_name, m_category, m_start, EventTrace::now() - m_start);
+    }
+}
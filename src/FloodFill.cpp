@@ -0,0 +1,276 @@
+/**
+ *  @file   FloodFill.cpp
+ *  @brief  FloodFill implementation, a scanline fill on the canvas's spans.
+ *  @author Ellah
+ *  @date   2021-12-25
+ ***********************************************/
+
+// Include standard library C++ libraries.
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+// Project header files
+#include "App.hpp"
+#include "FloodFill.hpp"
+#include "Blend.hpp"
+using namespace std;
+
+FloodFill::FloodFill(App *app) : FloodFill(
+        &app->getImage(),
+        app->mouseX,
+        app->mouseY,
+        app->selectedColor,
+        app->fillTolerance) {}
+
+FloodFill::FloodFill(Canvas *image, unsigned int posX, unsigned int posY, sf::Color newColor, sf::Uint8 tolerance) :
+        Command(generateCommandDescription(posX, posY, newColor)),
+        m_image(image), m_fill(Blend::premultiply(newColor)), m_posX(posX), m_posY(posY), m_newColor(newColor),
+        m_tolerance(tolerance) {}
+
+/*! \brief 	Helper function for building a command description string using the FloodFill's member variables
+*
+*/
+string FloodFill::generateCommandDescription(unsigned int posX, unsigned int posY, sf::Color newColor) {
+    char description[96];
+    snprintf(description, sizeof(description), "Fill from x: %u y: %u color: %u %u %u %u", posX, posY,
+             newColor.r, newColor.g, newColor.b, newColor.a);
+    return description;
+}
+
+bool FloodFill::operator==(Command &cmd) const {
+    // Check if given Command is also a FloodFill
+    FloodFill *other = dynamic_cast<FloodFill *>(&cmd);
+    if (!other) {
+        return false;
+    }
+
+    return m_posX == other->m_posX && m_posY == other->m_posY && m_newColor == other->m_newColor &&
+           m_tolerance == other->m_tolerance;
+}
+
+/*! \brief 	Returns a colour as one integer. sf::Color's operator== is not inlined, and fills compare
+*		every pixel.
+*
+*/
+static inline sf::Uint32 pack(sf::Color color) {
+    return (sf::Uint32)color.r << 24 | (sf::Uint32)color.g << 16 | (sf::Uint32)color.b << 8 | color.a;
+}
+
+/*! \brief 	Returns whether a colour is within the tolerance of the seed's
+*
+*/
+bool FloodFill::matches(sf::Color color) const {
+    if (m_tolerance == 0) {
+        return pack(color) == pack(m_target);
+    }
+    return abs(color.r - m_target.r) <= m_tolerance && abs(color.g - m_target.g) <= m_tolerance &&
+           abs(color.b - m_target.b) <= m_tolerance && abs(color.a - m_target.a) <= m_tolerance;
+}
+
+/*! \brief 	Measures a run of pixels within a tile's span. Blank spans are all background, so unless filled
+*		pixels are marked they are all on the same side.
+*
+*/
+unsigned int FloodFill::measure(const sf::Color *span, unsigned int x, unsigned int y, unsigned int count,
+                                bool inside, bool backwards) const {
+    unsigned int run = 0;
+
+    if (!m_filled.empty()) {
+        vector<bool>::const_iterator filled = m_filled.begin() + y * m_image->getSize().x + x;
+        sf::Color background = m_image->getBackground();
+        for (unsigned int i = backwards ? count - 1 : 0; run < count; run++, backwards ? i-- : i++) {
+            if ((matches(span ? span[i] : background) && !filled[i]) != inside) {
+                break;
+            }
+        }
+    } else if (!span) {
+        run = matches(m_image->getBackground()) == inside ? count : 0;
+    } else if (m_tolerance == 0) {
+        // The common case, kept to one comparison a pixel
+        sf::Uint32 target = pack(m_target);
+        if (backwards) {
+            while (run < count && (pack(span[count - 1 - run]) == target) == inside) {
+                run++;
+            }
+        } else {
+            while (run < count && (pack(span[run]) == target) == inside) {
+                run++;
+            }
+        }
+    } else {
+        for (unsigned int i = backwards ? count - 1 : 0; run < count; run++, backwards ? i-- : i++) {
+            if (matches(span[i]) != inside) {
+                break;
+            }
+        }
+    }
+    return run;
+}
+
+/*! \brief 	Moves right from x over pixels that are inside the fill, or outside it, a tile's span at a time
+*
+*/
+unsigned int FloodFill::skip(unsigned int x, unsigned int y, unsigned int limit, bool inside) const {
+    while (x < limit) {
+        unsigned int count = limit - x;
+        const sf::Color *span = m_image->readSpan(x, y, count);
+        unsigned int run = measure(span, x, y, count, inside, false);
+        x += run;
+        if (run < count) {
+            return x;
+        }
+    }
+    return limit;
+}
+
+/*! \brief 	Moves left from x, which is inside the fill, for as long as the pixels are
+*
+*/
+unsigned int FloodFill::extendLeft(unsigned int x, unsigned int y) const {
+    while (x > 0) {
+        // The pixels left of x within its tile, or the whole tile to the left
+        unsigned int start = (x - 1) - (x - 1) % Canvas::TILE_SIZE;
+        unsigned int count = x - start;
+        const sf::Color *span = m_image->readSpan(start, y, count);
+        unsigned int run = measure(span, start, y, count, true, true);
+        x -= run;
+        if (run < count) {
+            return x;
+        }
+    }
+    return 0;
+}
+
+/*! \brief 	Remembers that length pixels from x of row y were of a colour, joining the previous span if it
+*		ends there with the same colour
+*
+*/
+void FloodFill::addSpan(unsigned int x, unsigned int y, unsigned int length, sf::Color color) {
+    if (!m_spans.empty()) {
+        FillSpan &last = m_spans.back();
+        if (last.y == y && last.x + last.length == x && pack(last.color) == pack(color)) {
+            last.length += length;
+            return;
+        }
+    }
+    m_spans.push_back({(sf::Uint16)x, (sf::Uint16)y, (sf::Uint16)length, color});
+}
+
+/*! \brief 	Paints the pixels of row y from left up to right, remembering what they were in runs of one colour
+*
+*/
+void FloodFill::fillSpan(unsigned int left, unsigned int right, unsigned int y) {
+    for (unsigned int x = left; x < right;) {
+        unsigned int count = right - x;
+        const sf::Color *previous = m_image->readSpan(x, y, count);
+
+        if (!previous) {
+            addSpan(x, y, count, m_image->getBackground());
+        } else if (m_tolerance == 0) {
+            // Only the seed's colour is filled
+            addSpan(x, y, count, m_target);
+        } else {
+            for (unsigned int i = 0, run; i < count; i += run) {
+                for (run = 1; i + run < count && pack(previous[i + run]) == pack(previous[i]); run++) {
+                }
+                addSpan(x + i, y, run, previous[i]);
+            }
+        }
+
+        sf::Color *span = m_image->editSpan(x, y, count);
+        fill(span, span + count, m_fill);
+        if (!m_filled.empty()) {
+            auto row = m_filled.begin() + y * m_image->getSize().x;
+            fill(row + x, row + x + count, true);
+        }
+        x += count;
+    }
+}
+
+/*! \brief 	Adds a seed for every run of pixels still to fill on row y from start up to end
+*
+*/
+void FloodFill::addSeeds(vector<FillSeed> &seeds, unsigned int start, unsigned int end, unsigned int y, int dy,
+                         unsigned int left, unsigned int right) const {
+    // Wraps past the top row
+    if (y >= m_image->getSize().y) {
+        return;
+    }
+    for (unsigned int x = skip(start, y, end, false); x < end; x = skip(x, y, end, false)) {
+        seeds.push_back({x, y, left, right, dy});
+        x = skip(x, y, end, true);
+    }
+}
+
+/*! \brief 	Fills from the seed. Each seed taken off the stack is widened to the whole run it is in, which
+*		is painted, and the runs of the rows above and below that touch it become seeds in turn. The
+*		row the seed was found from is only looked at past the span it was found next to.
+*
+*/
+bool FloodFill::execute() {
+    sf::Vector2u size = m_image->getSize();
+    m_spans.clear();
+    m_filled.clear();
+    if (m_posX >= size.x || m_posY >= size.y) {
+        return false;
+    }
+
+    m_target = m_image->getPixel(m_posX, m_posY);
+    if (matches(m_fill)) {
+        // Filling with the seed's own colour changes nothing
+        if (m_tolerance == 0) {
+            return true;
+        }
+        // Filled pixels would still be inside, so they are marked instead
+        m_filled.assign((size_t)size.x * size.y, false);
+    }
+
+    // The first seed was found next to nothing
+    vector<FillSeed> seeds = {{m_posX, m_posY, 0, 0, 1}};
+    while (!seeds.empty()) {
+        FillSeed seed = seeds.back();
+        seeds.pop_back();
+        // Filled since it was found
+        if (skip(seed.x, seed.y, seed.x + 1, true) == seed.x) {
+            continue;
+        }
+
+        unsigned int left = extendLeft(seed.x, seed.y);
+        unsigned int right = skip(seed.x, seed.y, size.x, true);
+        fillSpan(left, right, seed.y);
+
+        // Onwards the whole span, back towards the row it was found from only where it reaches past that span
+        addSeeds(seeds, left, right, seed.y + seed.dy, seed.dy, left, right);
+        addSeeds(seeds, left, min(right, seed.left), seed.y - seed.dy, -seed.dy, left, right);
+        addSeeds(seeds, max(left, seed.right), right, seed.y - seed.dy, -seed.dy, left, right);
+    }
+    m_filled.clear();
+    m_filled.shrink_to_fit();
+
+    return true;
+}
+
+/*! \brief 	Paints the spans the fill painted over with their colours again
+*
+*/
+bool FloodFill::undo() {
+    for (const FillSpan &filled: m_spans) {
+        for (unsigned int x = filled.x; x < (unsigned int)filled.x + filled.length;) {
+            unsigned int count = filled.x + filled.length - x;
+            sf::Color *span = m_image->editSpan(x, filled.y, count);
+            fill(span, span + count, filled.color);
+            x += count;
+        }
+    }
+
+    return true;
+}
+
+/*! \brief 	Returns the runs of pixels the last execute painted, with the colours they had
+*
+*/
+const vector<FillSpan> &FloodFill::getSpans() const {
+    return m_spans;
+}
+
+FloodFill::~FloodFill() = default;
@@ -0,0 +1,246 @@
+/**
+ *  @file   LayerStack.cpp
+ *  @brief  LayerStack implementation
+ *  @author Ellah
+ *  @date   2021-12-19
+ ***********************************************/
+
+// Include standard library C++ libraries.
+#include <algorithm>
+// Project header files
+#include "LayerStack.hpp"
+#include "Blend.hpp"
+using namespace std;
+
+/*! \brief 	LayerStack constructor, every layer shown fully opaque
+*
+*/
+LayerStack::LayerStack() : m_layers(LAYER_COUNT), m_visible(LAYER_COUNT, true), m_opacity(LAYER_COUNT, 255),
+                           m_recomposite(true) {}
+
+/*! \brief 	Starts over with the bottom layer filled with the background and the others transparent
+*
+*/
+void LayerStack::create(unsigned int width, unsigned int height, sf::Color background) {
+    for (unsigned int layer = 0; layer < LAYER_COUNT; layer++) {
+        m_layers[layer].create(width, height, getEraseColor(layer, background));
+    }
+    m_composite.create(width, height, getCompositeBackground());
+    m_recomposite = true;
+}
+
+/*! \brief 	Copies another stack's pixels and selections. The composite is only composited again if the two
+*   show their layers differently.
+*
+*/
+void LayerStack::assign(const LayerStack &other) {
+    m_layers = other.m_layers;
+    m_selected = other.m_selected;
+    m_composite = other.m_composite;
+    m_recomposite = other.m_recomposite || m_visible != other.m_visible || m_opacity != other.m_opacity;
+}
+
+/*! \brief 	Copies another stack's selections and the tiles that differ from it. Tiles keep their version
+*   when copied, so a tile changed on neither stack since the last copy has the same version on both.
+*
+*/
+void LayerStack::assignChanged(const LayerStack &other) {
+    for (unsigned int layer = 0; layer < LAYER_COUNT; layer++) {
+        if (m_layers[layer].getSize() != other.m_layers[layer].getSize() ||
+            m_layers[layer].getBackground() != other.m_layers[layer].getBackground()) {
+            assign(other);
+            return;
+        }
+    }
+
+    m_selected = other.m_selected;
+    sf::Vector2u grid = m_layers[0].getTileGrid(0);
+    for (unsigned int layer = 0; layer < LAYER_COUNT; layer++) {
+        for (unsigned int row = 0; row < grid.y; row++) {
+            for (unsigned int column = 0; column < grid.x; column++) {
+                m_layers[layer].copyTile(other.m_layers[layer], column, row);
+            }
+        }
+    }
+}
+
+/*! \brief 	Returns the colour of the composite where no layer is painted
+*
+*/
+sf::Color LayerStack::getCompositeBackground() const {
+    sf::Color background = sf::Color::Transparent;
+    for (unsigned int layer = 0; layer < LAYER_COUNT; layer++) {
+        if (m_visible[layer]) {
+            sf::Color color = m_layers[layer].getBackground();
+            Blend::pixelSpan(&background, &color, 1, m_opacity[layer]);
+        }
+    }
+    return background;
+}
+
+/*! \brief 	Brings the composite up to date. Only the tiles changed on a layer since the last call are
+*   composited, unless a layer was created again or shown differently.
+*
+*/
+Canvas &LayerStack::composite() {
+    sf::Color background = getCompositeBackground();
+    if (background != m_composite.getBackground()) {
+        m_composite.create(getSize().x, getSize().y, background);
+        m_recomposite = true;
+    }
+
+    vector<unsigned int> &changed = m_changedTiles;
+    changed.clear();
+    for (Canvas &layer: m_layers) {
+        if (layer.takeChangedTiles(changed)) {
+            m_recomposite = true;
+        }
+    }
+
+    unsigned int columns = m_composite.getTileGrid(0).x;
+    if (m_recomposite) {
+        // Only a tile painted on some layer, or on the composite before, can differ from the background
+        changed.clear();
+        unsigned int count = columns * m_composite.getTileGrid(0).y;
+        for (unsigned int index = 0; index < count; index++) {
+            unsigned int column = index % columns, row = index / columns;
+            bool painted = !m_composite.getTile(0, column, row).empty();
+            for (unsigned int layer = 0; layer < LAYER_COUNT && !painted; layer++) {
+                painted = !m_layers[layer].getTile(0, column, row).empty();
+            }
+            if (painted) {
+                changed.push_back(index);
+            }
+        }
+        m_recomposite = false;
+    } else {
+        // A tile changed on several layers is listed by each
+        sort(changed.begin(), changed.end());
+        changed.erase(unique(changed.begin(), changed.end()), changed.end());
+    }
+
+    for (unsigned int index: changed) {
+        compositeTile(index % columns, index / columns);
+    }
+    return m_composite;
+}
+
+/*! \brief 	Blends one tile of the visible layers, bottom first, into the composite
+*
+*/
+void LayerStack::compositeTile(unsigned int column, unsigned int row) {
+    bool painted = false;
+    for (unsigned int layer = 0; layer < LAYER_COUNT && !painted; layer++) {
+        painted = m_visible[layer] && !m_layers[layer].getTile(0, column, row).empty();
+    }
+    if (!painted) {
+        m_composite.setTile(column, row, {});
+        return;
+    }
+
+    unsigned int const count = Canvas::TILE_SIZE * Canvas::TILE_SIZE;
+    vector<sf::Color> &pixels = m_pixels;
+    pixels.assign(count, sf::Color::Transparent);
+    for (unsigned int layer = 0; layer < LAYER_COUNT; layer++) {
+        sf::Uint8 opacity = m_opacity[layer];
+        if (!m_visible[layer] || opacity == 0) {
+            continue;
+        }
+
+        const vector<sf::Color> &tile = m_layers[layer].getTile(0, column, row);
+        if (!tile.empty()) {
+            Blend::pixelSpan(pixels.data(), tile.data(), count, opacity);
+        } else if (m_layers[layer].getBackground().a > 0) {
+            // A blank tile is its background everywhere, blended like a colour covering it at the opacity
+            m_coverage.assign(count, opacity);
+            Blend::colorSpan(BLEND_NORMAL, pixels.data(), m_coverage.data(), count, m_layers[layer].getBackground());
+        }
+    }
+
+    // Blank again if the layers cancel out, e.g. a stroke erased on the layer above the background
+    sf::Color background = m_composite.getBackground();
+    if (all_of(pixels.begin(), pixels.end(), [background](sf::Color pixel) { return pixel == background; })) {
+        m_composite.setTile(column, row, {});
+    } else {
+        m_composite.setTile(column, row, pixels);
+    }
+}
+
+/*! \brief 	Makes a user's following commands draw on the given layer
+*
+*/
+void LayerStack::select(const string &username, unsigned int layer) {
+    if (layer < LAYER_COUNT) {
+        m_selected[username] = layer;
+    }
+}
+
+/*! \brief 	Returns the colour erasing paints on a layer, premultiplied like the layer's pixels
+*
+*/
+sf::Color LayerStack::getEraseColor(unsigned int layer, sf::Color background) {
+    return layer == 0 ? Blend::premultiply(background) : sf::Color::Transparent;
+}
+
+/*! \brief 	Returns a layer, 0 being the bottom one
+*
+*/
+Canvas &LayerStack::getLayer(unsigned int layer) {
+    return m_layers[layer];
+}
+
+/*! \brief 	Returns a layer, 0 being the bottom one
+*
+*/
+const Canvas &LayerStack::getLayer(unsigned int layer) const {
+    return m_layers[layer];
+}
+
+/*! \brief 	Returns the layer a user draws on, the bottom one until they select another
+*
+*/
+unsigned int LayerStack::getSelected(const string &username) const {
+    auto it = m_selected.find(username);
+    return it == m_selected.end() ? 0 : it->second;
+}
+
+/*! \brief 	Returns whether a layer is part of the composite
+*
+*/
+bool LayerStack::isVisible(unsigned int layer) const {
+    return m_visible[layer];
+}
+
+/*! \brief 	Returns how opaque a layer is in the composite
+*
+*/
+sf::Uint8 LayerStack::getOpacity(unsigned int layer) const {
+    return m_opacity[layer];
+}
+
+/*! \brief 	Returns the size of every layer
+*
+*/
+sf::Vector2u LayerStack::getSize() const {
+    return m_layers[0].getSize();
+}
+
+/*! \brief 	Shows or hides a layer
+*
+*/
+void LayerStack::setVisible(unsigned int layer, bool visible) {
+    if (m_visible[layer] != visible) {
+        m_visible[layer] = visible;
+        m_recomposite = true;
+    }
+}
+
+/*! \brief 	Sets how opaque a layer is in the composite
+*
+*/
+void LayerStack::setOpacity(unsigned int layer, sf::Uint8 opacity) {
+    if (m_opacity[layer] != opacity) {
+        m_opacity[layer] = opacity;
+        m_recomposite = true;
+    }
+}
@@ -0,0 +1,259 @@
+/**
+ *  @file   LoadGenerator.cpp
+ *  @brief  LoadGenerator implementation
+ *  @author Ellah
+ *  @date   2021-12-21
+ ***********************************************/
+
+// Include standard library C++ libraries.
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <utility>
+// Project header files
+#include "LoadGenerator.hpp"
+#include "App.hpp"
+using namespace std;
+
+/*! \brief 	Returns the latency below which the given fraction of them are, by nearest rank
+*
+*/
+sf::Int64 LoadReport::getLatency(double fraction) const {
+    if (latencies.empty()) {
+        return 0;
+    }
+    auto rank = (unsigned long)ceil(fraction * latencies.size());
+    return latencies[min<unsigned long>(latencies.size(), max<unsigned long>(1, rank)) - 1];
+}
+
+/*! \brief 	Returns the copies received per second
+*
+*/
+double LoadReport::getThroughput() const {
+    return elapsed > 0 ? received * 1000000.0 / elapsed : 0;
+}
+
+/*! \brief 	Returns the number of latencies of each bit length
+*
+*/
+vector<unsigned long> LoadReport::getHistogram() const {
+    vector<unsigned long> histogram;
+    for (sf::Int64 latency: latencies) {
+        unsigned int bucket = 0;
+        while (bucket < 63 && (latency >> bucket) > 0) {
+            bucket++;
+        }
+        if (histogram.size() <= bucket) {
+            histogram.resize(bucket + 1);
+        }
+        histogram[bucket]++;
+    }
+    return histogram;
+}
+
+/*! \brief 	Constructor, strokes are generated unless some are given to replay
+*
+*/
+LoadGenerator::LoadGenerator(LoadSettings settings) : m_settings(move(settings)), m_server(nullptr) {
+    if (m_settings.strokes.empty()) {
+        generateStrokes();
+    }
+}
+
+/*! \brief 	Destructor, leaves the server and stops it if it was started here
+*
+*/
+LoadGenerator::~LoadGenerator() {
+    for (auto &simulated: m_simulated) {
+        delete simulated.client;
+    }
+    stopServer();
+}
+
+/*! \brief 	Makes one random walk across the canvas for each client, always the same ones
+*
+*/
+void LoadGenerator::generateStrokes() {
+    mt19937 random(5500);
+    uniform_int_distribution<int> start(0, App::WINDOW_WIDTH - 1), step(-8, 8);
+
+    for (unsigned int i = 0; i < max(1u, m_settings.clients); i++) {
+        vector<sf::Vector2i> stroke;
+        sf::Vector2i position(start(random), start(random));
+        for (unsigned int j = 0; j < m_settings.strokeLength; j++) {
+            position.x = max(0, min((int)App::WINDOW_WIDTH - 1, position.x + step(random)));
+            position.y = max(0, min((int)App::WINDOW_HEIGHT - 1, position.y + step(random)));
+            stroke.push_back(position);
+        }
+        m_settings.strokes.push_back(stroke);
+    }
+}
+
+/*! \brief 	Starts a server on the local address in another thread and waits until it listens
+*
+*/
+void LoadGenerator::startServer() {
+    m_server = new TCPServer();
+    unsigned short port = m_settings.port;
+    TCPServer *server = m_server;
+    m_serverThread = thread([server, port]() {
+        server->connectServer("LoadServer", sf::IpAddress::getLocalAddress(), port);
+    });
+
+    sf::Clock clock;
+    while (!m_server->m_start && clock.getElapsedTime() < sf::milliseconds(DRAIN_TIMEOUT_MS)) {
+        sf::sleep(sf::milliseconds(1));
+    }
+    m_settings.server = sf::IpAddress::getLocalAddress();
+}
+
+/*! \brief 	Stops the server started here. Its thread notices within a presence interval and closes it.
+*
+*/
+void LoadGenerator::stopServer() {
+    if (m_server) {
+        m_server->m_start = false;
+        if (m_serverThread.joinable()) {
+            m_serverThread.join();
+        }
+        delete m_server;
+        m_server = nullptr;
+    }
+}
+
+/*! \brief 	Sends the next message of a client's current stroke: its start, one of its dabs or its end
+*
+*/
+void LoadGenerator::sendNext(Simulated &simulated, LoadReport &report) {
+    const vector<sf::Vector2i> &stroke = m_settings.strokes[simulated.stroke % m_settings.strokes.size()];
+    string username = simulated.client->getUsername();
+    sf::Packet packet;
+    sf::Uint8 header;
+
+    if (simulated.step == 0) {
+        header = START_BRUSHSTROKE;
+        packet << header << username;
+    } else if (simulated.step <= stroke.size()) {
+        sf::Vector2i position = stroke[simulated.step - 1];
+        sf::Uint8 radius = m_settings.radius, opacity = 255, mode = BLEND_NORMAL;
+        header = DRAWBRUSH;
+        packet << header << username << (sf::Int32)position.x << (sf::Int32)position.y;
+        simulated.palette.write(packet, sf::Color::Black);
+        packet << radius << opacity << mode;
+    } else {
+        header = END_BRUSHSTROKE;
+        packet << header << username;
+    }
+
+    simulated.sendTimes.push_back(m_clock.getElapsedTime().asMicroseconds());
+    simulated.client->sendCommand(packet);
+    report.sent++;
+
+    if (++simulated.step > stroke.size() + 1) {
+        simulated.step = 0;
+        simulated.stroke++;
+    }
+}
+
+/*! \brief 	Hands out every message the clients received, timing each against when its sender sent it
+*
+*/
+bool LoadGenerator::receive(LoadReport &report) {
+    bool any = false;
+
+    for (auto &simulated: m_simulated) {
+        sf::Packet packet = simulated.client->receiveData();
+        while (packet.getDataSize() > 0) {
+            sf::Int64 now = m_clock.getElapsedTime().asMicroseconds();
+            sf::Uint8 header;
+            string username;
+            packet >> header >> username;
+
+            auto sender = m_indices.find(username);
+            if (header != ACK && header != PRESENCE && sender != m_indices.end()) {
+                unsigned long index = simulated.receivedFrom[username]++;
+                const vector<sf::Int64> &sendTimes = m_simulated[sender->second].sendTimes;
+                if (index < sendTimes.size()) {
+                    report.latencies.push_back(now - sendTimes[index]);
+                    report.received++;
+                }
+            }
+            any = true;
+            packet = simulated.client->receiveData();
+        }
+    }
+    return any;
+}
+
+/*! \brief 	Joins every client, has each send at the set rate for the set duration, then waits for the
+*		last copies to arrive. Clients start a fraction of an interval apart so they do not all send at once.
+*
+*/
+LoadReport LoadGenerator::run() {
+    LoadReport report;
+
+    if (m_settings.server == sf::IpAddress::None) {
+        startServer();
+    }
+
+    for (unsigned int i = 0; i < m_settings.clients; i++) {
+        Simulated simulated;
+        simulated.client = new TCPClient("load" + to_string(i), m_settings.port);
+        simulated.nextSend = 0;
+        simulated.stroke = i;
+        simulated.step = 0;
+
+        sf::Clock join;
+        simulated.client->joinServer(m_settings.server, m_settings.port);
+        report.joins.push_back(join.getElapsedTime().asMicroseconds());
+
+        m_indices[simulated.client->getUsername()] = m_simulated.size();
+        m_simulated.push_back(simulated);
+    }
+
+    // Messages sent before a client is registered never reach it, so wait for the server to register all
+    if (m_server) {
+        sf::Clock clock;
+        while (m_server->getClients() < (int)m_settings.clients &&
+               clock.getElapsedTime() < sf::milliseconds(DRAIN_TIMEOUT_MS)) {
+            sf::sleep(sf::milliseconds(1));
+        }
+    } else {
+        sf::sleep(sf::milliseconds(DRAIN_TIMEOUT_MS / 10));
+    }
+
+    auto interval = (sf::Int64)(1000000 / max(0.001f, m_settings.rate));
+    for (unsigned int i = 0; i < m_simulated.size(); i++) {
+        m_simulated[i].nextSend = interval * i / m_simulated.size();
+    }
+
+    m_clock.restart();
+    sf::Int64 end = m_settings.duration.asMicroseconds();
+    while (m_clock.getElapsedTime().asMicroseconds() < end) {
+        sf::Int64 now = m_clock.getElapsedTime().asMicroseconds();
+        for (auto &simulated: m_simulated) {
+            if (now >= simulated.nextSend) {
+                sendNext(simulated, report);
+                simulated.nextSend += interval;
+            }
+        }
+        if (!receive(report)) {
+            sf::sleep(sf::microseconds(100));
+        }
+    }
+
+    // Everyone but the sender should get a copy of every message
+    unsigned long expected = report.sent * (m_simulated.empty() ? 0 : m_simulated.size() - 1);
+    sf::Clock drain;
+    while (report.received < expected && drain.getElapsedTime() < sf::milliseconds(DRAIN_TIMEOUT_MS)) {
+        if (receive(report)) {
+            report.elapsed = m_clock.getElapsedTime().asMicroseconds();
+        } else {
+            sf::sleep(sf::microseconds(100));
+        }
+    }
+    report.elapsed = max(report.elapsed, end);
+
+    sort(report.latencies.begin(), report.latencies.end());
+    return report;
+}
@@ -0,0 +1,97 @@
+/**
+ *  @file   Palette.cpp
+ *  @brief  Palette implementation
+ *  @author Ellah
+ *  @date   2021-12-17
+ ***********************************************/
+
+// Project header files
+#include "App.hpp"
+#include "Palette.hpp"
+using namespace std;
+
+/*! \brief 	Palette constructor, the preset colours keep the numbers they always had on the wire
+*
+*/
+Palette::Palette() : m_next(1) {
+    for (const PresetColor &preset: App::PRESET_COLORS) {
+        define(m_next, preset.color);
+    }
+}
+
+/*! \brief 	Sets an entry, replacing whatever colour it had
+*
+*/
+void Palette::define(sf::Uint8 entry, sf::Color color) {
+    auto old = m_entries.find(m_colors[entry].toInteger());
+    if (old != m_entries.end() && old->second == entry) {
+        m_entries.erase(old);
+    }
+
+    m_colors[entry] = color;
+    m_entries[color.toInteger()] = entry;
+
+    if (entry >= m_next) {
+        m_next = entry + 1;
+    }
+}
+
+/*! \brief 	Writes the colour as its entry number, or defines a new entry the first time it is used
+*
+*/
+void Palette::write(sf::Packet &packet, sf::Color color) {
+    auto entry = m_entries.find(color.toInteger());
+
+    if (entry != m_entries.end()) {
+        packet << entry->second;
+    } else if (m_next < SIZE) {
+        sf::Uint8 code = m_next | DEFINE;
+        define(m_next, color);
+        packet << code << color.toInteger();
+    } else {
+        packet << LITERAL << color.toInteger();
+    }
+}
+
+/*! \brief 	Reads a colour, out of range or unknown entries read as black instead of past the table
+*
+*/
+sf::Color Palette::read(sf::Packet &packet) {
+    sf::Uint8 code = LITERAL;
+    sf::Uint32 rgba = 0;
+    packet >> code;
+
+    if (code == LITERAL) {
+        packet >> rgba;
+        return sf::Color(rgba);
+    }
+
+    sf::Uint8 entry = code & ~DEFINE;
+    if (code & DEFINE) {
+        packet >> rgba;
+        define(entry, sf::Color(rgba));
+    }
+    return m_colors[entry];
+}
+
+/*! \brief 	Copies one colour from a packet to another, so the server does not need to track palettes
+*
+*/
+void Palette::relay(sf::Packet &from, sf::Packet &to) {
+    sf::Uint8 code = LITERAL;
+    sf::Uint32 rgba = 0;
+    from >> code;
+    to << code;
+
+    if (code == LITERAL || (code & DEFINE)) {
+        from >> rgba;
+        to << rgba;
+    }
+}
+
+/*! \brief 	Returns the number of entries defined, including the unused entry 0
+*
+*/
+sf::Uint8 Palette::getSize() const {
+    return m_next;
+}
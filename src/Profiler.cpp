@@ -0,0 +1,190 @@
+/**
+ *  @file   Profiler.cpp
+ *  @brief  Profiler implementation
+ *  @author Ellah
+ *  @date   2021-12-23
+ ***********************************************/
+
+// Include standard library C++ libraries.
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+// Project header files
+#include "Profiler.hpp"
+using namespace std;
+
+const char *const Profiler::STAGE_NAMES[PROFILE_STAGE_COUNT] = {
+        "Frame", "Input", "Layout", "Update", "Draw", "Upload", "Render", "Display", "Commands", "Network"
+};
+
+/*! \brief 	Constructor, nothing is kept until the first frame ends
+*
+*/
+Profiler::Profiler() : m_depth(), m_frames(0) {}
+
+/*! \brief 	Keeps the value of the frame in progress in place of the oldest one, and starts the next from 0
+*
+*/
+void Profiler::push(ProfileSeries &series) {
+    if (series.samples.size() < HISTORY_FRAMES) {
+        series.samples.push_back(series.current);
+    } else {
+        series.samples[series.next] = series.current;
+    }
+    series.next = (series.next + 1) % HISTORY_FRAMES;
+    series.current = 0;
+}
+
+/*! \brief 	Returns a series' values oldest first
+*
+*/
+vector<sf::Int64> Profiler::getHistory(const ProfileSeries &series) {
+    vector<sf::Int64> history(series.samples);
+    if (history.size() == HISTORY_FRAMES) {
+        rotate(history.begin(), history.begin() + series.next, history.end());
+    }
+    return history;
+}
+
+/*! \brief 	Adds time spent in a stage during the frame in progress
+*
+*/
+void Profiler::add(ProfileStage stage, sf::Int64 microseconds) {
+    m_stages[stage].current += microseconds;
+}
+
+/*! \brief 	Adds an amount to a counter of the frame in progress
+*
+*/
+void Profiler::add(ProfileCounter counter, sf::Int64 amount) {
+    m_counters[counter].current += amount;
+}
+
+/*! \brief 	Sets a counter of the frame in progress
+*
+*/
+void Profiler::set(ProfileCounter counter, sf::Int64 value) {
+    m_counters[counter].current = value;
+}
+
+/*! \brief 	Opens a scope of a stage, returns true unless one is open already
+*
+*/
+bool Profiler::enter(ProfileStage stage) {
+    return m_depth[stage]++ == 0;
+}
+
+/*! \brief 	Closes a scope of a stage, adding its time only if it was the outermost
+*
+*/
+void Profiler::leave(ProfileStage stage, sf::Int64 microseconds) {
+    if (--m_depth[stage] == 0) {
+        add(stage, microseconds);
+    }
+}
+
+/*! \brief 	Keeps every stage and counter of the frame in progress and starts the next
+*
+*/
+void Profiler::endFrame() {
+    for (ProfileSeries &series: m_stages) {
+        push(series);
+    }
+    for (ProfileSeries &series: m_counters) {
+        push(series);
+    }
+    m_frames++;
+}
+
+/*! \brief 	Returns the number of frames ended so far
+*
+*/
+unsigned long Profiler::getFrames() const {
+    return m_frames;
+}
+
+/*! \brief 	Returns a stage's times over the frames kept, oldest first
+*
+*/
+vector<sf::Int64> Profiler::getHistory(ProfileStage stage) const {
+    return getHistory(m_stages[stage]);
+}
+
+/*! \brief 	Returns a counter's values over the frames kept, oldest first
+*
+*/
+vector<sf::Int64> Profiler::getHistory(ProfileCounter counter) const {
+    return getHistory(m_counters[counter]);
+}
+
+/*! \brief 	Returns a counter's value in the last frame, or 0 before the first
+*
+*/
+sf::Int64 Profiler::getLast(ProfileCounter counter) const {
+    const ProfileSeries &series = m_counters[counter];
+    if (series.samples.empty()) {
+        return 0;
+    }
+    return series.samples[(series.next + HISTORY_FRAMES - 1) % HISTORY_FRAMES];
+}
+
+/*! \brief 	Returns the average time spent in a stage over the frames kept
+*
+*/
+sf::Int64 Profiler::getAverage(ProfileStage stage) const {
+    const vector<sf::Int64> &samples = m_stages[stage].samples;
+    if (samples.empty()) {
+        return 0;
+    }
+    return accumulate(samples.begin(), samples.end(), (sf::Int64)0) / (sf::Int64)samples.size();
+}
+
+/*! \brief 	Returns the time below which the given fraction of the frames kept spent in a stage, by nearest rank
+*
+*/
+sf::Int64 Profiler::getPercentile(ProfileStage stage, double fraction) const {
+    vector<sf::Int64> samples(m_stages[stage].samples);
+    if (samples.empty()) {
+        return 0;
+    }
+    auto rank = (unsigned long)ceil(fraction * samples.size());
+    rank = min<unsigned long>(samples.size(), max<unsigned long>(1, rank)) - 1;
+    nth_element(samples.begin(), samples.begin() + rank, samples.end());
+    return samples[rank];
+}
+
+/*! \brief 	Returns the number of frames kept whose time in a stage has each bit length
+*
+*/
+vector<unsigned long> Profiler::getHistogram(ProfileStage stage) const {
+    vector<unsigned long> histogram;
+    for (sf::Int64 time: m_stages[stage].samples) {
+        unsigned int bucket = 0;
+        while (bucket < 63 && (time >> bucket) > 0) {
+            bucket++;
+        }
+        if (histogram.size() <= bucket) {
+            histogram.resize(bucket + 1);
+        }
+        histogram[bucket]++;
+    }
+    return histogram;
+}
+
+/*! \brief 	Starts timing a stage
+*
+*/
+ProfileScope::ProfileScope(Profiler *profiler, ProfileStage stage) : m_profiler(profiler), m_stage(stage) {
+    if (m_profiler) {
+        m_profiler->enter(m_stage);
+    }
+}
+
+/*! \brief 	Adds the time since construction to the stage, unless another scope of it is still open
+*
+*/
+ProfileScope::~ProfileScope() {
+    if (m_profiler) {
+        m_profiler->leave(m_stage, m_clock.getElapsedTime().asMicroseconds());
+    }
+}
@@ -0,0 +1,281 @@
+/**
+ *  @file   Reconciler.cpp
+ *  @brief  Reconciler implementation
+ *  @author Ellah
+ *  @date   2021-12-16
+ ***********************************************/
+
+// Include standard library C++ libraries.
+#include <utility>
+// Project header files
+#include "App.hpp"
+#include "Reconciler.hpp"
+#include "BrushStroke.hpp"
+#include "EraserStroke.hpp"
+#include "ClearScreen.hpp"
+#include "FloodFill.hpp"
+#include "Shape.hpp"
+#include "Selection.hpp"
+#include "TCPClient.hpp"
+using namespace std;
+
+/*! \brief 	Reconciler constructor
+*
+*/
+Reconciler::Reconciler(string username, const LayerStack &layers, sf::Color background,
+                       map<string, Palette> palettes) :
+        m_username(move(username)), m_background(background), m_base(layers), m_palettes(move(palettes)) {}
+
+/*! \brief 	Reads the drawing command a packet carries for the layer its sender selected, without executing it.
+*		The App and the base canvas both read commands here, so they draw the same thing.
+*
+*/
+Command *Reconciler::decodeCommand(sf::Uint8 header, const string &username, sf::Packet &packet,
+                                   LayerStack &layers, sf::Color background, Palette &palette) {
+    sf::Uint8 radius, opacity, mode, tolerance, filled, moved;
+    sf::Color color;
+    sf::Vector2i pos, end, offset;
+    unsigned int layer = layers.getSelected(username);
+    Canvas *image = &layers.getLayer(layer);
+
+    switch (header) {
+        case DRAWBRUSH:
+            packet >> pos.x >> pos.y;
+            color = palette.read(packet);
+            packet >> radius >> opacity >> mode;
+            return new DrawBrush(image, pos.x, pos.y, radius, color, opacity, (BlendMode)mode);
+        case ERASER:
+            packet >> pos.x >> pos.y >> radius;
+            return new Eraser(image, pos.x, pos.y, radius, LayerStack::getEraseColor(layer, background));
+        case CLEARSCREEN:
+            color = palette.read(packet);
+            return new ClearScreen(image, LayerStack::getEraseColor(layer, background), color);
+        case FLOODFILL:
+            // Only the seed travels, the area is filled from our own canvas
+            packet >> pos.x >> pos.y;
+            color = palette.read(packet);
+            packet >> tolerance;
+            return new FloodFill(image, pos.x, pos.y, color, tolerance);
+        case LINE:
+        case RECT:
+        case ELLIPSE:
+            packet >> pos.x >> pos.y >> end.x >> end.y;
+            color = palette.read(packet);
+            packet >> radius >> opacity >> mode >> filled;
+            return Shape::create(header, image, pos.x, pos.y, end.x, end.y, radius, color, opacity, (BlendMode)mode,
+                                 filled);
+        case SELECTION:
+            // Only the rectangle and the offset travel, the pixels come from our own canvas
+            packet >> pos.x >> pos.y >> end.x >> end.y >> offset.x >> offset.y >> moved;
+            return new Selection(image, pos.x, pos.y, end.x, end.y, offset.x, offset.y, moved,
+                                 LayerStack::getEraseColor(layer, background));
+        default:
+            return nullptr;
+    }
+}
+
+/*! \brief 	Applies a command packet to layers the same way applyCommand applies it to the screen,
+*   with its own strokes and undo history so it does not touch the App's
+*
+*/
+void Reconciler::apply(sf::Packet packet, LayerStack *layers, sf::Color background, map<string, Palette> &palettes,
+                       map<string, CompositeCommand *> &strokes, deque<Command *> &commands, stack<Command *> &undo) {
+    sf::Uint8 header, selected;
+    string username;
+    Command *command = nullptr;
+    map<string, CompositeCommand *>::iterator it;
+
+    packet >> header >> username;
+    it = strokes.find(username);
+
+    switch (header) {
+        case START_BRUSHSTROKE:
+        case START_ERASERSTROKE:
+            if (it != strokes.end()) {
+                command = it->second;
+                strokes.erase(it);
+            }
+            if (header == START_BRUSHSTROKE) {
+                strokes.emplace(username, new BrushStroke());
+            } else {
+                strokes.emplace(username, new EraserStroke());
+            }
+            break;
+        case END_BRUSHSTROKE:
+        case END_ERASERSTROKE:
+            if (it != strokes.end()) {
+                command = it->second;
+                strokes.erase(it);
+            }
+            break;
+        case LAYER:
+            packet >> selected;
+            layers->select(username, selected);
+            break;
+        case UNDO:
+            if (!commands.empty()) {
+                commands.front()->undo();
+                undo.push(commands.front());
+                commands.pop_front();
+            }
+            break;
+        case REDO:
+            if (!undo.empty()) {
+                undo.top()->execute();
+                commands.push_front(undo.top());
+                undo.pop();
+            }
+            break;
+        default:
+            command = decodeCommand(header, username, packet, *layers, background, palettes[username]);
+            if (command && (header == DRAWBRUSH || header == ERASER) && it != strokes.end()) {
+                // The stroke keeps its own copy
+                it->second->addAndExecuteCommand(command);
+                delete command;
+                command = nullptr;
+            } else if (command) {
+                command->execute();
+            }
+            break;
+    }
+
+    // Finished commands join the history the same way App::addCommand does
+    if (command) {
+        if (commands.size() == App::MAX_REMEMBERED_COMMANDS) {
+            delete commands.back();
+            commands.pop_back();
+        }
+        commands.push_front(command);
+
+        while (!undo.empty()) {
+            delete undo.top();
+            undo.pop();
+        }
+    }
+}
+
+/*! \brief 	Remember a local command that is on screen but not yet sequenced
+*
+*/
+void Reconciler::addLocal(const sf::Packet &packet) {
+    m_pending.push_back(packet);
+}
+
+/*! \brief 	Our oldest pending command was sequenced, so it now belongs on the base canvas
+*
+*/
+bool Reconciler::commitLocal() {
+    if (m_pending.empty()) {
+        return false;
+    }
+
+    sf::Packet packet = m_pending.front();
+    sf::Uint8 header;
+    m_pending.pop_front();
+
+    apply(packet, &m_base, m_background, m_palettes, m_strokes, m_commands, m_undo);
+
+    // Undo and redo are only drawn once the server has placed them
+    packet >> header;
+    return header == UNDO || header == REDO;
+}
+
+/*! \brief 	A remote command was sequenced before all of our pending ones
+*
+*/
+bool Reconciler::addRemote(const sf::Packet &packet) {
+    sf::Packet copy = packet;
+    sf::Uint8 header;
+
+    apply(packet, &m_base, m_background, m_palettes, m_strokes, m_commands, m_undo);
+
+    // With nothing pending the screen matches the base, so the command can be drawn on it directly.
+    // Undo and redo depend on the history, which only the base keeps in the server's order.
+    copy >> header;
+    return !m_pending.empty() || header == UNDO || header == REDO;
+}
+
+/*! \brief 	Redraws the screen as the base layers with our pending commands on top. Only the tiles the
+*		remote commands and the pending ones changed since the last rebuild differ from the base, so
+*		only those are copied back before the pending commands are applied again.
+*
+*/
+void Reconciler::rebuild(LayerStack &layers) {
+    map<string, CompositeCommand *> strokes;
+    deque<Command *> commands;
+    stack<Command *> undo;
+
+    layers.assignChanged(m_base);
+    Canvas &image = layers.getLayer(layers.getSelected(m_username));
+
+    // If our stroke was started before the pending commands, continue it from its last brushes so the
+    // gap to the first pending one is interpolated like it was on screen. They are on the base already,
+    // so they are not drawn again.
+    map<string, CompositeCommand *>::iterator it = m_strokes.find(m_username);
+    if (it != m_strokes.end()) {
+        if (BrushStroke *brushStroke = dynamic_cast<BrushStroke *>(it->second)) {
+            const deque<DrawBrush> &draws = brushStroke->getDraws();
+            BrushStroke *seed = new BrushStroke();
+            for (auto draw = draws.size() < 2 ? draws.begin() : draws.end() - 2; draw != draws.end(); draw++) {
+                seed->continueFrom(DrawBrush(&image, draw->m_posX, draw->m_posY, draw->m_radius, draw->m_newColor,
+                                             draw->m_opacity, draw->m_mode, draw->m_subX, draw->m_subY));
+            }
+            strokes.emplace(m_username, seed);
+        } else if (EraserStroke *eraserStroke = dynamic_cast<EraserStroke *>(it->second)) {
+            deque<Eraser> erasers = eraserStroke->getErasers();
+            EraserStroke *seed = new EraserStroke();
+            for (auto eraser = erasers.size() < 2 ? erasers.begin() : erasers.end() - 2;
+                 eraser != erasers.end(); eraser++) {
+                seed->continueFrom(Eraser(&image, eraser->m_posX, eraser->m_posY, eraser->m_radius,
+                                          eraser->m_newColor));
+            }
+            strokes.emplace(m_username, seed);
+        }
+    }
+
+    // An undo here can only reach our own pending commands, anything older waits for the server
+    for (const sf::Packet &packet: m_pending) {
+        apply(packet, &layers, m_background, m_palettes, strokes, commands, undo);
+    }
+
+    for (auto &stroke: strokes) {
+        delete stroke.second;
+    }
+    for (Command *command: commands) {
+        delete command;
+    }
+    while (!undo.empty()) {
+        delete undo.top();
+        undo.pop();
+    }
+}
+
+/*! \brief 	Returns the layers as the server has ordered them
+*
+*/
+const LayerStack &Reconciler::getBase() const {
+    return m_base;
+}
+
+/*! \brief 	Returns the number of local commands waiting to be sequenced
+*
+*/
+unsigned long Reconciler::getPendingCount() const {
+    return m_pending.size();
+}
+
+/*! \brief 	Reconciler destructor
+*
+*/
+Reconciler::~Reconciler() {
+    for (auto &stroke: m_strokes) {
+        delete stroke.second;
+    }
+    for (Command *command: m_commands) {
+        delete command;
+    }
+    while (!m_undo.empty()) {
+        delete m_undo.top();
+        m_undo.pop();
+    }
+}
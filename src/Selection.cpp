@@ -0,0 +1,196 @@
+/**
+ *  @file   Selection.cpp
+ *  @brief  Selection implementation, moving rows or whole tiles of the canvas.
+ *  @author Ellah
+ *  @date   2021-12-27
+ ***********************************************/
+
+// Include standard library C++ libraries.
+#include <algorithm>
+#include <cstdio>
+// Project header files
+#include "Selection.hpp"
+using namespace std;
+
+Selection::Selection(Canvas *image, unsigned int left, unsigned int top, unsigned int width, unsigned int height,
+                     int offsetX, int offsetY, bool move, sf::Color eraseColor) :
+        Command(generateCommandDescription(left, top, width, height, offsetX, offsetY, move)),
+        m_image(image), m_sourceX(0), m_sourceY(0), m_movedWidth(0), m_movedHeight(0), m_targetX(0), m_targetY(0),
+        m_tiles(false), m_left(left), m_top(top), m_width(width), m_height(height), m_offsetX(offsetX),
+        m_offsetY(offsetY), m_move(move), m_eraseColor(eraseColor) {}
+
+/*! \brief 	Helper function for building a command description string using the Selection's member variables
+*
+*/
+string Selection::generateCommandDescription(unsigned int left, unsigned int top, unsigned int width,
+                                             unsigned int height, int offsetX, int offsetY, bool move) {
+    char description[128];
+    snprintf(description, sizeof(description), "%s x: %u y: %u width: %u height: %u by x: %d y: %d",
+             move ? "Move" : "Copy", left, top, width, height, offsetX, offsetY);
+    return description;
+}
+
+bool Selection::operator==(Command &cmd) const {
+    // Check if given Command is also a Selection
+    Selection *other = dynamic_cast<Selection *>(&cmd);
+    if (!other) {
+        return false;
+    }
+
+    return m_left == other->m_left && m_top == other->m_top && m_width == other->m_width &&
+           m_height == other->m_height && m_offsetX == other->m_offsetX && m_offsetY == other->m_offsetY &&
+           m_move == other->m_move && m_eraseColor == other->m_eraseColor;
+}
+
+/*! \brief 	Cuts the rectangle down to the pixels that are on the canvas and land on it
+*
+*/
+bool Selection::clip() {
+    sf::Int64 width = m_image->getSize().x, height = m_image->getSize().y;
+    sf::Int64 left = max<sf::Int64>(m_left, -(sf::Int64)m_offsetX);
+    sf::Int64 top = max<sf::Int64>(m_top, -(sf::Int64)m_offsetY);
+    sf::Int64 right = min<sf::Int64>((sf::Int64)m_left + m_width, min(width, width - m_offsetX));
+    sf::Int64 bottom = min<sf::Int64>((sf::Int64)m_top + m_height, min(height, height - m_offsetY));
+    if (left >= right || top >= bottom) {
+        return false;
+    }
+
+    m_sourceX = (unsigned int)left;
+    m_sourceY = (unsigned int)top;
+    m_movedWidth = (unsigned int)(right - left);
+    m_movedHeight = (unsigned int)(bottom - top);
+    m_targetX = (unsigned int)(left + m_offsetX);
+    m_targetY = (unsigned int)(top + m_offsetY);
+    return true;
+}
+
+/*! \brief 	Returns whether the clipped rectangle is made of whole tiles that land on whole tiles. A tile
+*		on the right or bottom edge counts as whole if the rectangle reaches the edge and stays in
+*		the same column or row.
+*
+*/
+bool Selection::alignedWithTiles() const {
+    unsigned int const tile = Canvas::TILE_SIZE;
+    sf::Vector2u size = m_image->getSize();
+    return m_sourceX % tile == 0 && m_sourceY % tile == 0 && m_offsetX % (int)tile == 0 &&
+           m_offsetY % (int)tile == 0 &&
+           (m_movedWidth % tile == 0 || (m_offsetX == 0 && m_sourceX + m_movedWidth == size.x)) &&
+           (m_movedHeight % tile == 0 || (m_offsetY == 0 && m_sourceY + m_movedHeight == size.y));
+}
+
+/*! \brief 	Moves or copies the rectangle, keeping what was under the destination. Nothing is done if none
+*		of it lands on the canvas.
+*
+*/
+bool Selection::execute() {
+    m_prevColors.clear();
+    m_prevTiles.clear();
+    if (!clip()) {
+        return false;
+    }
+
+    m_tiles = alignedWithTiles();
+    if (m_tiles) {
+        executeTiles();
+    } else {
+        executeRows();
+    }
+
+    return true;
+}
+
+/*! \brief 	Takes a copy of the source tiles before erasing them, as the destination may overlap them
+*
+*/
+void Selection::executeTiles() {
+    unsigned int const tile = Canvas::TILE_SIZE;
+    unsigned int columns = (m_movedWidth + tile - 1) / tile, rows = (m_movedHeight + tile - 1) / tile;
+    unsigned int sourceColumn = m_sourceX / tile, sourceRow = m_sourceY / tile;
+    unsigned int targetColumn = m_targetX / tile, targetRow = m_targetY / tile;
+
+    vector<vector<sf::Color>> moved;
+    for (unsigned int row = 0; row < rows; row++) {
+        for (unsigned int column = 0; column < columns; column++) {
+            moved.push_back(m_image->getTile(0, sourceColumn + column, sourceRow + row));
+            m_prevTiles.push_back(m_image->getTile(0, targetColumn + column, targetRow + row));
+        }
+    }
+
+    if (m_move) {
+        m_image->fillRect(m_sourceX, m_sourceY, m_movedWidth, m_movedHeight, m_eraseColor);
+    }
+    for (unsigned int row = 0, i = 0; row < rows; row++) {
+        for (unsigned int column = 0; column < columns; column++, i++) {
+            m_image->setTile(targetColumn + column, targetRow + row, moved[i]);
+        }
+    }
+}
+
+/*! \brief 	Copies the source rows out before erasing them, as the destination may overlap them
+*
+*/
+void Selection::executeRows() {
+    size_t count = (size_t)m_movedWidth * m_movedHeight;
+    m_prevColors.resize(count);
+    m_image->copyTo(reinterpret_cast<sf::Uint8 *>(m_prevColors.data()), m_targetX, m_targetY, m_movedWidth,
+                    m_movedHeight, m_movedWidth);
+
+    vector<sf::Color> moved(count);
+    m_image->copyTo(reinterpret_cast<sf::Uint8 *>(moved.data()), m_sourceX, m_sourceY, m_movedWidth,
+                    m_movedHeight, m_movedWidth);
+    if (m_move) {
+        m_image->fillRect(m_sourceX, m_sourceY, m_movedWidth, m_movedHeight, m_eraseColor);
+    }
+    m_image->copyFrom(reinterpret_cast<const sf::Uint8 *>(moved.data()), m_targetX, m_targetY, m_movedWidth,
+                      m_movedHeight, m_movedWidth);
+}
+
+/*! \brief 	Puts back what was under the destination. A move's pixels are taken from the destination back
+*		to the source after that, where they cover the part of the destination they overlap again.
+*
+*/
+bool Selection::undo() {
+    if (m_movedWidth == 0 || m_movedHeight == 0) {
+        return true;
+    }
+
+    if (m_tiles) {
+        unsigned int const tile = Canvas::TILE_SIZE;
+        unsigned int columns = (m_movedWidth + tile - 1) / tile, rows = (m_movedHeight + tile - 1) / tile;
+        unsigned int sourceColumn = m_sourceX / tile, sourceRow = m_sourceY / tile;
+        unsigned int targetColumn = m_targetX / tile, targetRow = m_targetY / tile;
+
+        vector<vector<sf::Color>> moved;
+        for (unsigned int row = 0, i = 0; row < rows; row++) {
+            for (unsigned int column = 0; column < columns; column++, i++) {
+                if (m_move) {
+                    moved.push_back(m_image->getTile(0, targetColumn + column, targetRow + row));
+                }
+                m_image->setTile(targetColumn + column, targetRow + row, m_prevTiles[i]);
+            }
+        }
+        for (unsigned int row = 0, i = 0; row < rows && m_move; row++) {
+            for (unsigned int column = 0; column < columns; column++, i++) {
+                m_image->setTile(sourceColumn + column, sourceRow + row, moved[i]);
+            }
+        }
+        return true;
+    }
+
+    vector<sf::Color> moved;
+    if (m_move) {
+        moved.resize(m_prevColors.size());
+        m_image->copyTo(reinterpret_cast<sf::Uint8 *>(moved.data()), m_targetX, m_targetY, m_movedWidth,
+                        m_movedHeight, m_movedWidth);
+    }
+    m_image->copyFrom(reinterpret_cast<const sf::Uint8 *>(m_prevColors.data()), m_targetX, m_targetY,
+                      m_movedWidth, m_movedHeight, m_movedWidth);
+    if (m_move) {
+        m_image->copyFrom(reinterpret_cast<const sf::Uint8 *>(moved.data()), m_sourceX, m_sourceY, m_movedWidth,
+                          m_movedHeight, m_movedWidth);
+    }
+
+    return true;
+}
+
+Selection::~Selection() = default;
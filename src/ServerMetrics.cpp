@@ -0,0 +1,52 @@
+/**
+ *  @file   ServerMetrics.cpp
+ *  @brief  ServerMetrics implementation
+ *  @author Ellah
+ *  @date   2021-12-24
+ ***********************************************/
+
+// Include standard library C++ libraries.
+#include <sstream>
+// Project header files
+#include "ServerMetrics.hpp"
+using namespace std;
+
+/*! \brief 	Escapes the characters that end a tag value in the line protocol
+*
+*/
+static string escapeTag(const string &value) {
+    string escaped;
+    for (char c: value) {
+        if (c == ',' || c == '=' || c == ' ') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+/*! \brief 	Returns one line for the server and one per client, every count an integer field
+*
+*/
+string ServerMetrics::toLineProtocol(const string &server, sf::Int64 time) const {
+    stringstream lines;
+    string tag = escapeTag(server);
+
+    lines << "collabpaint_server,server=" << tag
+          << " clients=" << clients << "i,accepts=" << accepts << "i,disconnects=" << disconnects
+          << "i,messages_in=" << messagesIn << "i,bytes_in=" << bytesIn
+          << "i,messages_out=" << messagesOut << "i,bytes_out=" << bytesOut
+          << "i,broadcasts=" << broadcasts << "i,broadcast_us=" << broadcastTime
+          << "i,broadcast_max_us=" << slowestBroadcast
+          << "i,history=" << historySize << "i,history_bytes=" << historyBytes << "i " << time << "\n";
+
+    for (auto &client: perClient) {
+        const ClientMetrics &metrics = client.second;
+        lines << "collabpaint_client,server=" << tag << ",user=" << escapeTag(client.first)
+              << " messages_in=" << metrics.messagesIn << "i,bytes_in=" << metrics.bytesIn
+              << "i,messages_out=" << metrics.messagesOut << "i,bytes_out=" << metrics.bytesOut
+              << "i,send_failures=" << metrics.sendFailures << "i,unacknowledged=" << metrics.unacknowledged
+              << "i " << time << "\n";
+    }
+    return lines.str();
+}
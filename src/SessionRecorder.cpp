@@ -0,0 +1,122 @@
+/**
+ *  @file   SessionRecorder.cpp
+ *  @brief  SessionRecorder implementation
+ *  @author Ellah
+ *  @date   2021-12-22
+ ***********************************************/
+
+// Include standard library C++ libraries.
+#include <cstring>
+// Project header files
+#include "SessionRecorder.hpp"
+using namespace std;
+
+/*! \brief 	Opens the file and writes the trace header
+*
+*/
+SessionRecorder::SessionRecorder(const string &path) : m_file(path, ios::binary | ios::trunc), m_last(0),
+                                                       m_unflushed(0) {
+    m_file.write(MAGIC, sizeof(MAGIC));
+    m_file.put((char)VERSION);
+    m_file.flush();
+}
+
+/*! \brief 	Destructor, writes whatever is still buffered
+*
+*/
+SessionRecorder::~SessionRecorder() {
+    m_file.flush();
+}
+
+/*! \brief 	Returns whether the file could be opened and written so far
+*
+*/
+bool SessionRecorder::isOpen() const {
+    return m_file.is_open() && m_file.good();
+}
+
+/*! \brief 	Writes an entry for a message, flushing every FLUSH_INTERVAL entries
+*
+*/
+void SessionRecorder::record(TraceKind kind, const sf::Packet &packet) {
+    if (!isOpen()) {
+        return;
+    }
+
+    sf::Int64 now = m_clock.getElapsedTime().asMicroseconds();
+    m_file.put((char)kind);
+    writeNumber(now - m_last);
+    writeNumber(packet.getDataSize());
+    m_file.write(static_cast<const char *>(packet.getData()), (streamsize)packet.getDataSize());
+    m_last = now;
+
+    if (++m_unflushed >= FLUSH_INTERVAL) {
+        m_file.flush();
+        m_unflushed = 0;
+    }
+}
+
+/*! \brief 	Writes a number 7 bits at a time, lowest first, the top bit of a byte set when more follow
+*
+*/
+void SessionRecorder::writeNumber(sf::Uint64 value) {
+    while (value >= 0x80) {
+        m_file.put((char)(0x80 | (value & 0x7F)));
+        value >>= 7;
+    }
+    m_file.put((char)value);
+}
+
+/*! \brief 	Reads a number written by writeNumber. Returns false if the stream ends first.
+*
+*/
+bool SessionRecorder::readNumber(istream &in, sf::Uint64 &value) {
+    value = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7) {
+        int byte = in.get();
+        if (byte == EOF) {
+            return false;
+        }
+        value |= (sf::Uint64)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*! \brief 	Reads every entry of a trace, with times from the start of recording
+*
+*/
+bool SessionRecorder::load(const string &path, vector<TraceEntry> &entries) {
+    ifstream file(path, ios::binary);
+    char magic[sizeof(MAGIC)];
+
+    if (!file.read(magic, sizeof(magic)) || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || file.get() != VERSION) {
+        return false;
+    }
+
+    sf::Int64 time = 0;
+    vector<char> data;
+    int kind = file.get();
+    while (kind != EOF) {
+        sf::Uint64 delta, size;
+        if (!readNumber(file, delta) || !readNumber(file, size)) {
+            return false;
+        }
+        data.resize(size);
+        if (!file.read(data.data(), (streamsize)size)) {
+            return false;
+        }
+
+        time += (sf::Int64)delta;
+        TraceEntry entry;
+        entry.kind = (TraceKind)kind;
+        entry.time = time;
+        entry.packet.append(data.data(), data.size());
+        entries.push_back(entry);
+
+        kind = file.get();
+    }
+    return true;
+}
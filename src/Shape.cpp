@@ -0,0 +1,294 @@
+/**
+ *  @file   Shape.cpp
+ *  @brief  Shape implementation, with the span rasterizers of Line, Rect and Ellipse.
+ *  @author Ellah
+ *  @date   2021-12-26
+ ***********************************************/
+
+// Include standard library C++ libraries.
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <typeinfo>
+// Project header files
+#include "Shape.hpp"
+#include "TCPClient.hpp"
+using namespace std;
+
+Shape::Shape(string commandDescription, Canvas *image, unsigned int x0, unsigned int y0, unsigned int x1,
+             unsigned int y1, unsigned int thickness, sf::Color newColor, sf::Uint8 opacity, BlendMode mode,
+             bool filled) :
+        Command(move(commandDescription)), m_image(image), m_rasterized(false),
+        m_x0(min(x0, Canvas::MAX_SIZE)), m_y0(min(y0, Canvas::MAX_SIZE)),
+        m_x1(min(x1, Canvas::MAX_SIZE)), m_y1(min(y1, Canvas::MAX_SIZE)),
+        m_thickness(max(1u, min(thickness, Canvas::MAX_SIZE))), m_newColor(newColor), m_opacity(opacity),
+        m_mode(mode), m_filled(filled) {}
+
+/*! \brief 	Helper function for building a command description string from a shape's corners
+*
+*/
+string Shape::generateCommandDescription(const char *name, unsigned int x0, unsigned int y0, unsigned int x1,
+                                         unsigned int y1) {
+    char description[96];
+    snprintf(description, sizeof(description), "%s from x: %u y: %u to x: %u y: %u", name, x0, y0, x1, y1);
+    return description;
+}
+
+/*! \brief 	Returns the integer square root of a value, rounded down
+*
+*/
+unsigned int Shape::squareRoot(sf::Uint64 value) {
+    sf::Uint64 root = 0;
+    sf::Uint64 bit = (sf::Uint64)1 << 62;
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (unsigned int)root;
+}
+
+bool Shape::operator==(Command &cmd) const {
+    // Check if given Command is the same kind of shape
+    if (typeid(*this) != typeid(cmd)) {
+        return false;
+    }
+
+    Shape *other = dynamic_cast<Shape *>(&cmd);
+
+    return m_x0 == other->m_x0 && m_y0 == other->m_y0 && m_x1 == other->m_x1 && m_y1 == other->m_y1 &&
+           m_thickness == other->m_thickness && m_newColor == other->m_newColor &&
+           m_opacity == other->m_opacity && m_mode == other->m_mode && m_filled == other->m_filled;
+}
+
+/*! \brief 	Blends the shape's spans with its colour, keeping the pixels under them first. The spans are
+*		worked out the first time: sorted, clipped to the canvas and joined where they overlap, so no
+*		pixel is blended twice.
+*
+*/
+bool Shape::execute() {
+    if (!m_rasterized) {
+        vector<ShapeSpan> spans;
+        rasterize(spans);
+        sort(spans.begin(), spans.end(), [](const ShapeSpan &a, const ShapeSpan &b) {
+            return a.y < b.y || (a.y == b.y && a.x < b.x);
+        });
+
+        int width = (int)m_image->getSize().x, height = (int)m_image->getSize().y;
+        for (const ShapeSpan &span: spans) {
+            int left = max(span.x, 0), right = min(span.x + span.length, width);
+            if (span.y < 0 || span.y >= height || left >= right) {
+                continue;
+            }
+            if (!m_spans.empty() && m_spans.back().y == span.y && m_spans.back().x + m_spans.back().length >= left) {
+                ShapeSpan &last = m_spans.back();
+                last.length = max(last.x + last.length, right) - last.x;
+            } else {
+                m_spans.push_back({left, span.y, right - left});
+            }
+        }
+        m_rasterized = true;
+    }
+
+    // The opacity only scales the colour's own alpha, and the kernels take premultiplied colours
+    sf::Color color = m_newColor;
+    color.a = (color.a * m_opacity + 127) / 255;
+    color = Blend::premultiply(color);
+    // Every covered pixel is covered whole
+    static const vector<sf::Uint8> coverage(Canvas::TILE_SIZE, 255);
+
+    size_t covered = 0;
+    for (const ShapeSpan &span: m_spans) {
+        covered += span.length;
+    }
+    m_prevColors.resize(covered);
+
+    sf::Color *saved = m_prevColors.data();
+    for (const ShapeSpan &span: m_spans) {
+        for (unsigned int x = span.x, end = span.x + span.length; x < end;) {
+            unsigned int count = end - x;
+            sf::Color *pixels = m_image->editSpan(x, span.y, count);
+            copy(pixels, pixels + count, saved);
+            Blend::colorSpan(m_mode, pixels, coverage.data(), count, color);
+            saved += count;
+            x += count;
+        }
+    }
+
+    return true;
+}
+
+/*! \brief 	Puts back the pixels the shape covered
+*
+*/
+bool Shape::undo() {
+    const sf::Color *saved = m_prevColors.data();
+    for (const ShapeSpan &span: m_spans) {
+        for (unsigned int x = span.x, end = span.x + span.length; x < end;) {
+            unsigned int count = end - x;
+            sf::Color *pixels = m_image->editSpan(x, span.y, count);
+            copy(saved, saved + count, pixels);
+            saved += count;
+            x += count;
+        }
+    }
+
+    return true;
+}
+
+/*! \brief 	Returns the spans the shape covers on the canvas, empty until executed
+*
+*/
+const vector<ShapeSpan> &Shape::getSpans() const {
+    return m_spans;
+}
+
+/*! \brief 	Makes the shape a message describes, or returns nullptr if it is not a shape's
+*
+*/
+Shape *Shape::create(sf::Uint8 header, Canvas *image, unsigned int x0, unsigned int y0, unsigned int x1,
+                     unsigned int y1, unsigned int thickness, sf::Color newColor, sf::Uint8 opacity, BlendMode mode,
+                     bool filled) {
+    switch (header) {
+        case LINE:
+            return new Line(image, x0, y0, x1, y1, thickness, newColor, opacity, mode);
+        case RECT:
+            return new Rect(image, x0, y0, x1, y1, thickness, newColor, opacity, mode, filled);
+        case ELLIPSE:
+            return new Ellipse(image, x0, y0, x1, y1, thickness, newColor, opacity, mode, filled);
+        default:
+            return nullptr;
+    }
+}
+
+Shape::~Shape() = default;
+
+Line::Line(Canvas *image, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, unsigned int thickness,
+           sf::Color newColor, sf::Uint8 opacity, BlendMode mode) :
+        Shape(generateCommandDescription("Line", x0, y0, x1, y1), image, x0, y0, x1, y1, thickness, newColor,
+              opacity, mode, false) {}
+
+/*! \brief 	Steps from one end to the other with Bresenham's algorithm, widening each row's span to the
+*		square around every step. The squares of neighbouring steps touch, so each row is one span.
+*
+*/
+void Line::rasterize(vector<ShapeSpan> &spans) const {
+    int before = ((int)m_thickness - 1) / 2, after = (int)m_thickness / 2;
+    int x = (int)m_x0, y = (int)m_y0, x1 = (int)m_x1, y1 = (int)m_y1;
+    int top = min(y, y1) - before;
+    // Leftmost and rightmost pixel of each row from top
+    vector<pair<int, int>> rows(abs(y1 - y) + before + after + 1, make_pair(INT_MAX, INT_MIN));
+
+    int dx = abs(x1 - x), dy = -abs(y1 - y);
+    int stepX = x < x1 ? 1 : -1, stepY = y < y1 ? 1 : -1;
+    int error = dx + dy;
+    while (true) {
+        for (int row = y - before; row <= y + after; row++) {
+            pair<int, int> &span = rows[row - top];
+            span.first = min(span.first, x - before);
+            span.second = max(span.second, x + after);
+        }
+        if (x == x1 && y == y1) {
+            break;
+        }
+        int doubled = 2 * error;
+        if (doubled >= dy) {
+            error += dy;
+            x += stepX;
+        }
+        if (doubled <= dx) {
+            error += dx;
+            y += stepY;
+        }
+    }
+
+    for (unsigned int row = 0; row < rows.size(); row++) {
+        spans.push_back({rows[row].first, top + (int)row, rows[row].second - rows[row].first + 1});
+    }
+}
+
+Rect::Rect(Canvas *image, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, unsigned int thickness,
+           sf::Color newColor, sf::Uint8 opacity, BlendMode mode, bool filled) :
+        Shape(generateCommandDescription("Rect", x0, y0, x1, y1), image, x0, y0, x1, y1, thickness, newColor,
+              opacity, mode, filled) {}
+
+/*! \brief 	Covers the whole width of the rows within the thickness of the top and bottom, and the thickness
+*		on each side of the rows between. Filled, every row is covered whole.
+*
+*/
+void Rect::rasterize(vector<ShapeSpan> &spans) const {
+    int left = (int)min(m_x0, m_x1), right = (int)max(m_x0, m_x1);
+    int top = (int)min(m_y0, m_y1), bottom = (int)max(m_y0, m_y1);
+    int thickness = (int)m_thickness;
+
+    for (int y = top; y <= bottom; y++) {
+        if (m_filled || y < top + thickness || y > bottom - thickness) {
+            spans.push_back({left, y, right - left + 1});
+        } else {
+            spans.push_back({left, y, thickness});
+            spans.push_back({right - thickness + 1, y, thickness});
+        }
+    }
+}
+
+Ellipse::Ellipse(Canvas *image, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1,
+                 unsigned int thickness, sf::Color newColor, sf::Uint8 opacity, BlendMode mode, bool filled) :
+        Shape(generateCommandDescription("Ellipse", x0, y0, x1, y1), image, x0, y0, x1, y1, thickness, newColor,
+              opacity, mode, filled) {}
+
+/*! \brief 	Works in half pixels, where the box is width by height and pixel centres are odd, so everything
+*		stays in integers and every client covers the same pixels. A pixel is inside if
+*		dx^2 * height^2 + dy^2 * width^2 <= width^2 * height^2, with dx and dy from the box's centre.
+*
+*/
+bool Ellipse::getRow(int left, int top, int right, int bottom, int y, int &rowLeft, int &rowRight) {
+    sf::Uint64 width = right - left + 1, height = bottom - top + 1;
+    sf::Int64 dy = 2 * (sf::Int64)y + 1 - (top + bottom + 1);
+    sf::Uint64 dy2 = dy * dy;
+    if (dy2 > height * height) {
+        return false;
+    }
+
+    int centre = left + right + 1;
+    int reach = (int)squareRoot(width * width * (height * height - dy2) / (height * height));
+    // The pixels with |2x + 1 - centre| <= reach
+    rowLeft = (centre - reach) / 2;
+    rowRight = (centre + reach - 1) / 2;
+    return rowLeft <= rowRight;
+}
+
+/*! \brief 	Covers each row inside the ellipse, leaving out the part inside the smaller one for an outline
+*
+*/
+void Ellipse::rasterize(vector<ShapeSpan> &spans) const {
+    int left = (int)min(m_x0, m_x1), right = (int)max(m_x0, m_x1);
+    int top = (int)min(m_y0, m_y1), bottom = (int)max(m_y0, m_y1);
+    int thickness = (int)m_thickness;
+    bool hollow = !m_filled && left + thickness <= right - thickness && top + thickness <= bottom - thickness;
+
+    for (int y = top; y <= bottom; y++) {
+        int outerLeft, outerRight, innerLeft, innerRight;
+        if (!getRow(left, top, right, bottom, y, outerLeft, outerRight)) {
+            continue;
+        }
+        if (hollow && getRow(left + thickness, top + thickness, right - thickness, bottom - thickness, y,
+                             innerLeft, innerRight)) {
+            if (innerLeft > outerLeft) {
+                spans.push_back({outerLeft, y, innerLeft - outerLeft});
+            }
+            if (outerRight > innerRight) {
+                spans.push_back({innerRight + 1, y, outerRight - innerRight});
+            }
+        } else {
+            spans.push_back({outerLeft, y, outerRight - outerLeft + 1});
+        }
+    }
+}
@@ -18,6 +18,13 @@ using namespace std;
 TCPClient::TCPClient(string username, unsigned short port) {
     m_username = std::move(username);
     m_port = port;
+    m_serverPort = 0;
+    m_connected = false;
+    m_connecting = false;
+    m_lastSequence = 0;
+    m_unacknowledged = 0;
+    m_presence = sf::Vector2<sf::Uint16>(PRESENCE_GONE, PRESENCE_GONE);
+    setPresenceRate(PRESENCE_RATE);
 }
 
 /*! \brief 	Client destructor
@@ -53,9 +60,62 @@ int TCPClient::joinServer(sf::IpAddress serverAddress, unsigned short serverPort
 
     m_socket.send(m_packet);
     m_socket.setBlocking(false);
+    m_connected = true;
 
     // Always call this to be receiving data
-    receiveData();
+    pollSocket();
+    return 0;
+}
+
+/*! \brief 	Reconnects to the server and resumes after the last sequence number received,
+*   so only the messages missed while disconnected are sent to us again. The connection is made
+*   without blocking, so a frame loop calls this every frame until it returns 0.
+*
+*/
+int TCPClient::resumeSession() {
+    if (!m_connecting) {
+        // Don't hammer an unreachable server, a frame loop may call this every frame
+        if (m_reconnectClock.getElapsedTime() < sf::milliseconds(RECONNECT_INTERVAL_MS)) {
+            return sf::Socket::NotReady;
+        }
+        m_reconnectClock.restart();
+
+        m_socket.setBlocking(false);
+        int status = m_socket.connect(m_serverIpAddress, m_serverPort);
+        if (status != sf::Socket::Done && status != sf::Socket::NotReady) {
+            return status;
+        }
+        m_connecting = true;
+    }
+
+    // The socket only has a remote address once the server accepted the connection
+    if (m_socket.getRemoteAddress() == sf::IpAddress::None) {
+        if (m_reconnectClock.getElapsedTime() >= sf::milliseconds(RECONNECT_INTERVAL_MS)) {
+            // Took too long, the next attempt starts over
+            m_socket.disconnect();
+            m_connecting = false;
+        }
+        return sf::Socket::NotReady;
+    }
+    m_connecting = false;
+
+    sf::Packet packet;
+    sf::Uint8 header = RESUME;
+    packet << header << m_username << m_lastSequence;
+    // A few bytes on a new connection, so sending them whole does not wait
+    m_socket.setBlocking(true);
+    m_socket.send(packet);
+    m_socket.setBlocking(false);
+    m_connected = true;
+    m_unacknowledged = 0;
+    cout << "Resumed session after message " << m_lastSequence << endl;
+
+    // Send what we drew while we were away
+    while (m_connected && !m_outbox.empty()) {
+        sendCommand(m_outbox.front());
+        m_outbox.pop();
+    }
+
     return 0;
 }
 
@@ -63,69 +123,162 @@ int TCPClient::joinServer(sf::IpAddress serverAddress, unsigned short serverPort
 *
 */
 void TCPClient::sendCommand(sf::Packet packet) {
-    if (packet.getDataSize() > 0 && m_socket.send(packet) == sf::Socket::Done) {
+    if (packet.getDataSize() == 0) {
+        return;
+    }
+
+    if (!m_connected) {
+        // Keep it until we resume
+        m_outbox.push(packet);
+        return;
+    }
+
+    int status = m_socket.send(packet);
+    if (status == sf::Socket::Done) {
         cout << "New packet was successfully sent to server.\n";
     } else {
         cout << "Failed to send packet to server." << endl;
+        if (status == sf::Socket::Disconnected) {
+            m_connected = false;
+            m_outbox.push(packet);
+        }
     }
 
     // Wait to get data from server
-    receiveData();
+    pollSocket();
 }
 
 /*! \brief 	Handles data recieved from server
 *
 */
 sf::Packet TCPClient::receiveData() {
+    pollSocket();
+
     sf::Packet packet;
-    sf::Uint8 header, ncolor, radius;
+    if (!m_inbox.empty()) {
+        packet = m_inbox.front();
+        m_inbox.pop();
+    }
+
+    // Return packet, may be empty
+    return packet;
+}
+
+/*! \brief 	Moves every message waiting on the socket into m_inbox, stripping the
+*   server's sequence number from the front of each one
+*
+*/
+void TCPClient::pollSocket() {
+    if (!m_connected) {
+        return;
+    }
+
+    sf::Packet packet;
+    sf::Uint32 sequence;
+    sf::Uint8 header, radius;
     string username;
     sf::Vector2i pos;
 
     int status = m_socket.receive(packet);
 
-    switch (status) {
-        // Only try to unpack if connection is Done, meaning data was sent over
-        // We need to do this because status will always return something (non-blocking), including Error
-        // and NotReady, which will disconnect our client. So, we want to stop trying to retreive data if
-        // connection isn't Done - hope that makes sense
-        case sf::Socket::Done:
+    // Only try to unpack if connection is Done, meaning data was sent over
+    // We need to do this because status will always return something (non-blocking), including Error
+    // and NotReady, which will disconnect our client. So, we want to stop trying to retreive data if
+    // connection isn't Done - hope that makes sense
+    while (status == sf::Socket::Done) {
+        packet >> sequence;
+
+        if (sequence == 0) {
+            // Presence is not part of the history, so it is neither counted nor acknowledged
+            sf::Packet presence;
+            presence.append(static_cast<const char *>(packet.getData()) + sizeof(sequence),
+                            packet.getDataSize() - sizeof(sequence));
+            m_inbox.push(presence);
+        } else if (sequence > m_lastSequence) {
+            // A message relayed twice (e.g. around a resume) is dropped
+            m_lastSequence = sequence;
+
+            sf::Packet command;
+            command.append(static_cast<const char *>(packet.getData()) + sizeof(sequence),
+                           packet.getDataSize() - sizeof(sequence));
+
             packet >> header;
             switch (header) {
                 case DRAWBRUSH:
-                    packet >> username >> pos.x >> pos.y >> ncolor >> radius;
-                    cout << "Received a draw command at position (" << pos.x << ", " << pos.y << ") with radius "
-                              << to_string(radius) << " from " << username << "\n";
-                    packet << header << username << pos.x << pos.y << ncolor << radius;
+                    packet >> username >> pos.x >> pos.y;
+                    cout << "Received a draw command at position (" << pos.x << ", " << pos.y << ") from "
+                         << username << "\n";
                     break;
                 case ERASER:
                     packet >> username >> pos.x >> pos.y >> radius;
                     cout << "Received an erase command at position (" << pos.x << ", " << pos.y <<
-                              ") with radius " << to_string(radius) << " from " << username << "\n";
-                    packet << header << username << pos.x << pos.y;
+                         ") with radius " << to_string(radius) << " from " << username << "\n";
                     break;
                 case CLEARSCREEN:
-                    packet >> username;
                     cout << "Received a clearscreen command\n";
-                    packet << header << username;
-                    break;
-                case NON_COMMAND:
                     break;
                 default:
                     packet >> username;
                     cout << "Received a command from " << username << "\n";
-                    packet << header << username;
                     break;
             }
-            break;
-            // Otherwise, break and go back to what client was doing
-        default:
-            break;
+
+            m_inbox.push(command);
+
+            if (++m_unacknowledged >= ACK_INTERVAL) {
+                acknowledge();
+            }
+        }
+
+        status = m_socket.receive(packet);
     }
 
-    // Return packet, may be empty
-    return packet;
+    if (status == sf::Socket::Disconnected) {
+        cout << "Lost connection to server" << endl;
+        m_connected = false;
+    }
+}
+
+/*! \brief 	Sends our cursor position, at most once per presence interval and only when it moved
+*
+*/
+void TCPClient::sendPresence(sf::Uint16 x, sf::Uint16 y) {
+    if (!m_connected || m_presenceClock.getElapsedTime() < m_presenceInterval ||
+        (x == m_presence.x && y == m_presence.y)) {
+        return;
+    }
 
+    sf::Packet packet;
+    sf::Uint8 header = PRESENCE;
+    packet << header << m_username << x << y;
+
+    // Presence is only worth sending now, so it is dropped rather than queued when the connection is down
+    if (m_socket.send(packet) == sf::Socket::Disconnected) {
+        m_connected = false;
+    }
+    m_presence = sf::Vector2<sf::Uint16>(x, y);
+    m_presenceClock.restart();
+}
+
+/*! \brief 	Sets how many cursor positions are sent per second
+*
+*/
+void TCPClient::setPresenceRate(unsigned int perSecond) {
+    m_presenceInterval = sf::microseconds(1000000 / (perSecond > 0 ? perSecond : 1));
+}
+
+/*! \brief 	Tells the server the last sequence number we received
+*
+*/
+void TCPClient::acknowledge() {
+    sf::Packet packet;
+    sf::Uint8 header = ACK;
+    packet << header << m_username << m_lastSequence;
+
+    if (m_socket.send(packet) == sf::Socket::Disconnected) {
+        m_connected = false;
+    }
+    m_unacknowledged = 0;
 }
 
 /*! \brief Returns client's username
@@ -149,16 +302,49 @@ sf::IpAddress TCPClient::getIpAddress() {
     return m_ipAddress;
 }
 
+/*! \brief 	Blocks until the server sends something or the timeout passes, so an idle client does not spin
+*
+*/
+bool TCPClient::waitForData(sf::Time timeout) {
+    if (m_inbox.empty() && m_connected) {
+        // The socket is replaced on reconnect, so it is added again every time
+        m_selector.clear();
+        m_selector.add(m_socket);
+        if (m_selector.wait(timeout)) {
+            pollSocket();
+        }
+    } else if (m_inbox.empty()) {
+        sf::sleep(timeout);
+    }
+
+    return !m_inbox.empty();
+}
+
 /*! \brief 	Returns true if client is disconnected
 *
 */
 bool TCPClient::diconnected() {
-    int status = m_socket.connect(m_serverIpAddress, m_serverPort);
-    if (status == sf::Socket::Disconnected) {
-        return true;
+    // A socket closed on our side has no remote address, one closed by the server shows up on receive
+    if (m_socket.getRemoteAddress() == sf::IpAddress::None) {
+        m_connected = false;
     }
+    pollSocket();
+
+    return !m_connected;
+}
 
-    return false;
+/*! \brief 	Returns the sequence number of the last message received from the server
+*
+*/
+sf::Uint32 TCPClient::getLastSequence() const {
+    return m_lastSequence;
+}
+
+/*! \brief 	Returns the number of messages received but not yet handed out
+*
+*/
+unsigned long TCPClient::getInboxSize() const {
+    return m_inbox.size();
 }
 
 /*! \brief 	Returns client's socket
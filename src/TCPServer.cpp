@@ -10,12 +10,14 @@
 #include <iostream>
 #include <map>
 #include <utility>
+#include <algorithm>
+#include <chrono>
 using namespace std;
 
 /*! \brief Defualt Constructor
 *
 */
-TCPServer::TCPServer() {}
+TCPServer::TCPServer() : m_sequence(0), m_nextSession(0), m_recorder(nullptr), m_historyBytes(0), m_start(false) {}
 
 /*! \brief 	Connects server
 *
@@ -54,8 +56,8 @@ void TCPServer::start() {
 
     while (m_start) {
 
-        // Selector waits for a connection
-        if (m_selector.wait()) {
+        // Selector waits for a connection, or until presence is due
+        if (m_selector.wait(sf::milliseconds(PRESENCE_INTERVAL_MS))) {
 
             // Checks if it's new connection to the server
             if (m_selector.isReady(m_listener)) {
@@ -64,13 +66,13 @@ void TCPServer::start() {
                 sf::TcpSocket *new_client = new sf::TcpSocket();
 
                 if (m_listener.accept(*new_client) == sf::Socket::Done) {
+                    m_metrics.accepts++;
                     m_clients.push_back(new_client);
                     m_selector.add(*new_client);
 
                     cout << "New connection to " << new_client->getRemoteAddress() << " completed.\n";
 
-                    // Update client on all data in history
-                    joiningClient(new_client);
+                    // History is sent once the client says whether it is joining or resuming
 
                 } else {
                     cout << "Could not initiate new connection from IP Address: " << new_client->getRemoteAddress()
@@ -89,8 +91,8 @@ void TCPServer::start() {
                     // before unpacking from packet
                     sf::TcpSocket &client = *c;
                     string username;
-                    sf::Vector2i pos;
-                    sf::Uint8 header, ncolor, radius;
+                    sf::Uint8 header;
+                    sf::Uint32 sequence;
 
                     // Check if this clients sent a packet
                     if (m_selector.isReady(client)) {
@@ -98,49 +100,92 @@ void TCPServer::start() {
                         // If ready, get packet sent
                         sf::Packet packet;
                         map<string, sf::TcpSocket *>::iterator it;
-                        m_status = client.receive(packet);
+                        {
+                            TraceSpan span("receive", "network");
+                            m_status = client.receive(packet);
+                        }
 
                         //Receive message
                         if (m_status == sf::Socket::Done) {
+                            // Decoding, keeping and broadcasting the message
+                            TraceSpan span("relay", "network");
                             packet >> header >> username;
 
+                            // Asking for the metrics does not count as traffic
+                            if (header == STATS) {
+                                answerStats(&client);
+                                continue;
+                            }
+                            m_metrics.messagesIn++;
+                            m_metrics.bytesIn += packet.getDataSize();
+                            m_metrics.perClient[username].messagesIn++;
+                            m_metrics.perClient[username].bytesIn += packet.getDataSize();
+
+                            // Session control messages are answered here and never relayed
+                            if (header == NON_COMMAND) {
+                                registerClient(username, &client);
+                                joiningClient(&client, username);
+                                continue;
+                            } else if (header == RESUME) {
+                                packet >> sequence;
+                                registerClient(username, &client);
+                                resumingClient(&client, username, sequence);
+                                continue;
+                            } else if (header == ACK) {
+                                packet >> sequence;
+                                m_acknowledged[username] = sequence;
+                                continue;
+                            } else if (header == PRESENCE) {
+                                sf::Vector2<sf::Uint16> cursor;
+                                packet >> cursor.x >> cursor.y;
+                                m_presence[username] = cursor;
+                                continue;
+                            }
+
                             it = m_activeClients.find(username);
 
                             if (it == m_activeClients.end()) {
                                 m_activeClients.insert(pair<string, sf::TcpSocket *>(username, &client));
                             }
 
-                            if (header == DRAWBRUSH) {
-                                packet >> pos.x >> pos.y >> ncolor >> radius;
-                                cout << username << " sent a new draw packet at position: (" << pos.x << ", "
-                                     << pos.y << "), radius" << to_string(radius) << endl;
-                                packet << header << username << pos.x << pos.y << ncolor << radius;
-                            } else if (header == ERASER) {
-                                packet >> pos.x >> pos.y >> radius;
-                                cout << username << " sent a new erase packet as position: (" << pos.x << ", "
-                                     << pos.y << "), radius" << to_string(radius) << endl;
-                                packet << header << username << pos.x << pos.y << radius;
-                            } else if (header == CLEARSCREEN) {
-                                cout << username << " sent a new clearscreen packet\n";
-                                packet << header << username;
-                            } else {
-                                cout << username << " sent a new packet\n";
-                                packet << header << username;
+                            // Every relayed packet is stamped with the next sequence number
+                            sf::Packet relay;
+                            relay << ++m_sequence;
+                            EventTrace::flow(FLOW_RELAYED, username, m_flowCounts[username]++);
+
+                            // Only the header and username are read. Whatever else a message holds, colours
+                            // included (see Palette), is decoded by the clients and goes along as it is.
+                            cout << username << " sent a new packet of type " << to_string(header) << endl;
+                            relay << header << username;
+                            relayRemainder(packet, relay);
+                            // Recorded as the clients receive it, without the sequence number
+                            if (m_recorder) {
+                                sf::Packet received;
+                                received.append(static_cast<const char *>(relay.getData()) + sizeof(m_sequence),
+                                                relay.getDataSize() - sizeof(m_sequence));
+                                m_recorder->record(TRACE_RECEIVED, received);
                             }
                             // Add packet to vector of packets and broadcast it to everyone else
-                            m_packetHistory.push_back(packet);
-                            broadcastCommandPacket(username, packet);
-                            packet.clear();
+                            m_packetHistory.emplace_back(username, relay);
+                            m_historyBytes += relay.getDataSize() + username.size();
+                            broadcastCommandPacket(username, relay);
+                            // The sender already drew it, it only needs to know where it was placed
+                            acknowledgeCommand(&client, username, m_sequence);
                             // If client disconnected, remove them from server
                         } else if (m_status == sf::Socket::Disconnected) {
 
                             //If disconnect request, handle appropriately
                             removeClient(c);
+                            // m_clients changed under us, the selector will report any other ready client again
+                            break;
                         }
                     }
                 }
             }
         }
+
+        flushPresence();
+        dumpStats();
     }
 
     stop();
@@ -172,40 +217,112 @@ int TCPServer::stop() {
 /*! \brief Handles a new client joining, sends them history
 *
 */
-int TCPServer::joiningClient(sf::TcpSocket *client) {
+int TCPServer::joiningClient(sf::TcpSocket *client, const string &username) {
+    TraceSpan span("join replay", "network");
     cout << "Updating new client\n";
 
     // Iterate through every packet sent and send it to the client.
     for (auto &i: m_packetHistory) {
-        client->send(i);
+        sendTo(username, client, i.second);
+    }
+
+    return 0;
+}
+
+/*! \brief Handles a client reconnecting, sends them the packets after lastSequence
+*   that they did not send themselves
+*
+*/
+int TCPServer::resumingClient(sf::TcpSocket *client, const string &username, sf::Uint32 lastSequence) {
+    TraceSpan span("resume replay", "network");
+    // A sequence we never issued means the server restarted, so start over
+    if (lastSequence > m_sequence) {
+        lastSequence = 0;
+    }
+    cout << "Resuming " << username << " after message " << lastSequence << " of " << m_sequence << "\n";
+
+    for (auto i = m_packetHistory.begin() + lastSequence; i != m_packetHistory.end(); ++i) {
+        if (i->first != username) {
+            sendTo(username, client, i->second);
+        } else {
+            acknowledgeCommand(client, username, i - m_packetHistory.begin() + 1);
+        }
     }
+    m_acknowledged[username] = lastSequence;
 
     return 0;
 }
 
+/*! \brief Tells the sender of a command which sequence number it was given
+*
+*/
+int TCPServer::acknowledgeCommand(sf::TcpSocket *client, const string &username, sf::Uint32 sequence) {
+    sf::Packet packet;
+    sf::Uint8 header = ACK;
+    packet << sequence << header << username;
+
+    return sendTo(username, client, packet);
+}
+
+/*! \brief Associates a username with the socket it is now using. A reconnecting client
+*   replaces its old socket, which is dropped once the selector reports it closed.
+*
+*/
+void TCPServer::registerClient(const string &username, sf::TcpSocket *client) {
+    m_activeClients[username] = client;
+
+    // Session numbers are kept across reconnects so the client's cursor keeps its colour
+    if (m_sessions.find(username) == m_sessions.end()) {
+        m_sessions[username] = ++m_nextSession;
+    }
+}
+
+/*! \brief Relays the latest cursor position of each client that moved since the last relay.
+*   Presence is sent with sequence number 0 and is not kept in the history.
+*
+*/
+void TCPServer::flushPresence() {
+    if (m_presence.empty() || m_presenceClock.getElapsedTime() < sf::milliseconds(PRESENCE_INTERVAL_MS)) {
+        return;
+    }
+    m_presenceClock.restart();
+
+    sf::Uint32 sequence = 0;
+    sf::Uint8 header = PRESENCE;
+
+    for (auto &presence: m_presence) {
+        sf::Packet packet;
+        packet << sequence << header << m_sessions[presence.first] << presence.second.x << presence.second.y;
+
+        for (auto &activeClient: m_activeClients) {
+            if (activeClient.first != presence.first) {
+                sendTo(activeClient.first, activeClient.second, packet);
+            }
+        }
+    }
+
+    m_presence.clear();
+}
+
 /*! \brief Handles a client leaving
 *
 */
 int TCPServer::removeClient(sf::TcpSocket *socket) {
     map<string, sf::TcpSocket *>::iterator it;
-    sf::TcpSocket toremove;
     for (it = m_activeClients.begin(); it != m_activeClients.end(); ++it) {
         if (it->second == socket) {
-            it->second->disconnect();
-            m_selector.remove(*it->second);
-            m_activeClients.erase(it->first);
-            delete it->second;
+            // Tell everyone to stop showing their cursor
+            m_presence[it->first] = sf::Vector2<sf::Uint16>(PRESENCE_GONE, PRESENCE_GONE);
+            m_activeClients.erase(it);
             break;
         }
     }
+    m_metrics.disconnects++;
 
-    for (auto & m_client : m_clients)
-        if (m_client == socket) {
-            m_selector.remove(*m_client);
-            break;
-        }
-
-    remove(m_clients.begin(), m_clients.end(), socket);
+    m_selector.remove(*socket);
+    socket->disconnect();
+    m_clients.erase(remove(m_clients.begin(), m_clients.end(), socket), m_clients.end());
+    delete socket;
 
     return 0;
 }
@@ -214,23 +331,86 @@ int TCPServer::removeClient(sf::TcpSocket *socket) {
 *
 */
 int TCPServer::broadcastCommandPacket(const string &username, sf::Packet packet) {
+    TraceSpan span("broadcast", "network");
+    sf::Clock clock;
     cout << "From: " << username << endl;
 
     // Send the data to all clients
     for (auto &m_activeClient: m_activeClients) {
         if (m_activeClient.first != username) {
             cout << "Sending to: " << m_activeClient.first << endl;
-            sf::TcpSocket &client = *m_activeClient.second;
-            if (client.send(packet) != sf::Socket::Done) {
+            if (sendTo(m_activeClient.first, m_activeClient.second, packet) != sf::Socket::Done) {
                 cout << "Could not send packet to clients\n";
             } else {
                 cout << "Packet sent\n";
             }
         }
     }
+
+    sf::Int64 elapsed = clock.getElapsedTime().asMicroseconds();
+    m_metrics.broadcasts++;
+    m_metrics.broadcastTime += elapsed;
+    m_metrics.slowestBroadcast = max(m_metrics.slowestBroadcast, elapsed);
     return 0;
 }
 
+/*! \brief Copies the unread rest of a packet a byte at a time, bytes being sent as they are
+*
+*/
+void TCPServer::relayRemainder(sf::Packet &from, sf::Packet &to) {
+    sf::Uint8 byte;
+    while (!from.endOfPacket() && from >> byte) {
+        to << byte;
+    }
+}
+
+/*! \brief Sends a packet to a client, counting it and whether it went through
+*
+*/
+sf::Socket::Status TCPServer::sendTo(const string &username, sf::TcpSocket *client, sf::Packet &packet) {
+    ClientMetrics &metrics = m_metrics.perClient[username];
+    sf::Socket::Status status = client->send(packet);
+
+    if (status == sf::Socket::Done) {
+        metrics.messagesOut++;
+        metrics.bytesOut += packet.getDataSize();
+        m_metrics.messagesOut++;
+        m_metrics.bytesOut += packet.getDataSize();
+    } else {
+        metrics.sendFailures++;
+    }
+    return status;
+}
+
+/*! \brief Replies to a STATS message with the metrics, unless it came from another machine
+*
+*/
+void TCPServer::answerStats(sf::TcpSocket *client) {
+    sf::IpAddress address = client->getRemoteAddress();
+    if (address != sf::IpAddress::LocalHost && address != sf::IpAddress::getLocalAddress()) {
+        cout << "Refused metrics to " << address << endl;
+        return;
+    }
+
+    sf::Packet packet;
+    sf::Uint32 sequence = 0;
+    sf::Uint8 header = STATS;
+    packet << sequence << header << getStats();
+    client->send(packet);
+}
+
+/*! \brief Appends the metrics to the stats file once every stats interval
+*
+*/
+void TCPServer::dumpStats() {
+    if (!m_statsFile.is_open() || m_statsClock.getElapsedTime() < m_statsInterval) {
+        return;
+    }
+    m_statsClock.restart();
+    m_statsFile << getStats();
+    m_statsFile.flush();
+}
+
 /*! \brief 	Returns number of clients connected to server
 *
 */
@@ -243,4 +423,87 @@ int TCPServer::getClients() {
 */
 unsigned short TCPServer::getPort() const {
     return m_port;
-}
\ No newline at end of file
+}
+
+/*! \brief 	Returns the sequence number of the last packet relayed
+*
+*/
+sf::Uint32 TCPServer::getSequence() const {
+    return m_sequence;
+}
+
+/*! \brief 	Returns the last sequence number the given client acknowledged
+*
+*/
+sf::Uint32 TCPServer::getAcknowledged(const string &username) {
+    return m_acknowledged[username];
+}
+
+/*! \brief 	Returns everything counted so far, with the clients connected, their unacknowledged
+*		messages and the history as they are now
+*
+*/
+ServerMetrics TCPServer::getMetrics() {
+    ServerMetrics metrics = m_metrics;
+    metrics.clients = m_activeClients.size();
+    metrics.historySize = m_packetHistory.size();
+    metrics.historyBytes = m_historyBytes;
+    for (auto &activeClient: m_activeClients) {
+        sf::Uint32 acknowledged = m_acknowledged[activeClient.first];
+        metrics.perClient[activeClient.first].unacknowledged = m_sequence > acknowledged ? m_sequence - acknowledged : 0;
+    }
+    return metrics;
+}
+
+/*! \brief 	Returns the metrics in the line protocol, timed now
+*
+*/
+string TCPServer::getStats() {
+    sf::Int64 now = chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    return getMetrics().toLineProtocol(m_name, now);
+}
+
+/*! \brief 	Records the commands relayed from now on, or stops with nullptr
+*
+*/
+void TCPServer::setRecorder(SessionRecorder *recorder) {
+    m_recorder = recorder;
+}
+
+/*! \brief 	Appends the metrics to a file every interval, starting one interval from now
+*
+*/
+bool TCPServer::setStatsFile(const string &path, sf::Time interval) {
+    m_statsFile.open(path, ios::app);
+    m_statsInterval = interval;
+    m_statsClock.restart();
+    return m_statsFile.is_open();
+}
+
+/*! \brief 	Asks the server listening on a port of this machine for its metrics. Returns false if it
+*		could not be reached or did not answer within STATS_TIMEOUT_MS.
+*
+*/
+bool TCPServer::queryStats(sf::IpAddress address, unsigned short port, string &stats) {
+    sf::TcpSocket socket;
+    if (socket.connect(address, port, sf::milliseconds(STATS_TIMEOUT_MS)) != sf::Socket::Done) {
+        return false;
+    }
+
+    sf::Packet request;
+    sf::Uint8 header = STATS;
+    request << header << string("stats");
+    if (socket.send(request) != sf::Socket::Done) {
+        return false;
+    }
+
+    sf::SocketSelector selector;
+    selector.add(socket);
+    sf::Packet reply;
+    if (!selector.wait(sf::milliseconds(STATS_TIMEOUT_MS)) || socket.receive(reply) != sf::Socket::Done) {
+        return false;
+    }
+
+    sf::Uint32 sequence;
+    return (reply >> sequence >> header >> stats) && header == STATS;
+}
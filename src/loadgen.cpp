@@ -0,0 +1,110 @@
+/**
+ *  @file   loadgen.cpp
+ *  @brief  Entry point of the load generator, prints how fast a server relays drawing to many clients
+ *  @author Ellah
+ *  @date   2021-12-21
+ ***********************************************/
+
+// Include standard library C++ libraries.
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <string>
+// Project header files
+#include "LoadGenerator.hpp"
+using namespace std;
+
+/*! \brief 	Reads strokes to replay, one "x y" dab per line and a blank line between two strokes
+*
+*/
+vector<vector<sf::Vector2i>> readStrokes(const string &path) {
+    vector<vector<sf::Vector2i>> strokes(1);
+    ifstream file(path);
+    string line;
+
+    while (getline(file, line)) {
+        sf::Vector2i position;
+        if (istringstream(line) >> position.x >> position.y) {
+            strokes.back().push_back(position);
+        } else if (!strokes.back().empty()) {
+            strokes.emplace_back();
+        }
+    }
+    if (strokes.back().empty()) {
+        strokes.pop_back();
+    }
+    return strokes;
+}
+
+/*! \brief 	The entry point of the load generator.
+*		Pass --clients=N, --rate=MESSAGES_PER_SECOND for each client, --seconds=S, --stroke=DABS,
+*		--radius=R, --port=P, --server=ADDRESS to load a running server instead of starting one,
+*		--strokes=FILE to replay strokes instead of generated ones and --verbose to keep the
+*		clients' and server's own output.
+*
+*/
+int main(int argc, char *argv[]) {
+    LoadSettings settings;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++) {
+        string argument = argv[i];
+        unsigned int value;
+        float seconds;
+        if (sscanf(argument.c_str(), "--clients=%u", &value) == 1) {
+            settings.clients = value;
+        } else if (sscanf(argument.c_str(), "--rate=%f", &settings.rate) == 1) {
+        } else if (sscanf(argument.c_str(), "--seconds=%f", &seconds) == 1) {
+            settings.duration = sf::seconds(seconds);
+        } else if (sscanf(argument.c_str(), "--stroke=%u", &value) == 1) {
+            settings.strokeLength = value;
+        } else if (sscanf(argument.c_str(), "--radius=%u", &value) == 1) {
+            settings.radius = value;
+        } else if (sscanf(argument.c_str(), "--port=%u", &value) == 1) {
+            settings.port = value;
+        } else if (argument.rfind("--server=", 0) == 0) {
+            settings.server = sf::IpAddress(argument.substr(9));
+        } else if (argument.rfind("--strokes=", 0) == 0) {
+            settings.strokes = readStrokes(argument.substr(10));
+        } else if (argument == "--verbose") {
+            verbose = true;
+        }
+    }
+
+    // The clients and the server log every message, which would be most of what is measured
+    streambuf *log = cout.rdbuf();
+    if (!verbose) {
+        cout.rdbuf(nullptr);
+    }
+    LoadReport report;
+    {
+        LoadGenerator generator(settings);
+        report = generator.run();
+    }
+    cout.rdbuf(log);
+    cout.clear();
+
+    cout << settings.clients << " clients, " << report.sent << " messages sent, " << report.received
+         << " copies received in " << report.elapsed / 1000000.0 << " s" << endl;
+    cout << "Throughput: " << report.getThroughput() << " copies/s" << endl;
+
+    sf::Int64 joinTotal = 0, joinMax = 0;
+    for (sf::Int64 join: report.joins) {
+        joinTotal += join;
+        joinMax = max(joinMax, join);
+    }
+    cout << "Join: mean " << (report.joins.empty() ? 0 : joinTotal / (sf::Int64)report.joins.size())
+         << " us, max " << joinMax << " us" << endl;
+    cout << "Latency: p50 " << report.getLatency(0.5) << " us, p99 " << report.getLatency(0.99)
+         << " us, p999 " << report.getLatency(0.999) << " us" << endl;
+
+    vector<unsigned long> histogram = report.getHistogram();
+    for (unsigned int i = 0; i < histogram.size(); i++) {
+        if (histogram[i] > 0) {
+            cout << "  < " << (1ll << i) << " us: " << histogram[i] << endl;
+        }
+    }
+
+    return report.received < report.sent * (settings.clients > 0 ? settings.clients - 1 : 0) ? 1 : 0;
+}
@@ -12,7 +12,8 @@
 // Include standard library C++ libraries.
 #include <string>
 #include <iostream>
-#include <thread>
+#include <cstdio>
+#include <cmath>
 // Project header files
 #include "App.hpp"
 #include "DrawBrush.hpp"
@@ -23,45 +24,46 @@
 #include "TCPClient.hpp"
 #include "Eraser.hpp"
 #include "EraserStroke.hpp"
+#include "FloodFill.hpp"
+#include "Shape.hpp"
+#include "Selection.hpp"
+#include "Reconciler.hpp"
 using namespace std;
 
-void executeReceivedCommands(App *app) {
-    sf::Uint8 header, ncolor, radius;
-    sf::Vector2i pos;
-    string name, username;
-
-    DrawBrush *db;
-    Eraser *er;
-    ClearScreen *cs;
-
-    sf::Color c;
-    sf::Packet p = app->getClient()->receiveData();
-    map<string, CompositeCommand*>::iterator it;
-
-    p >> header >> username;
-
-    switch (header) {
-        case DRAWBRUSH:
-            p >> pos.x >> pos.y >> ncolor >> radius;
-            db = new DrawBrush(&app->getImage(), pos.x, pos.y, radius, App::PRESET_COLORS[ncolor - 1].color);
-            db->execute();
-            break;
-        case ERASER:
-            p >> pos.x >> pos.y >> radius;
-            er = new Eraser(&app->getImage(), pos.x, pos.y, radius, app->getBGColor());
-            er->execute();
-        case CLEARSCREEN:
-            cs = new ClearScreen(app);
-            cs->execute();
-        case UNDO:
-            app->undoCommand();
-            break;
-        case REDO:
-            app->redoCommand();
-            break;
-        default:
-            break;
-    }
+// Last mouse sample sent for the current stroke. Receivers interpolate between samples,
+// so frames where the mouse is held still do not need to be sent again.
+static bool strokeSampled = false;
+static unsigned int lastSampleX, lastSampleY;
+// Where the shape being dragged out started, it is drawn and sent once the button is released
+static bool shapeStarted = false;
+static unsigned int shapeStartX, shapeStartY;
+// Where the select tool's drag started, and whether it drags the selection rather than picking a new one
+static bool selectStarted = false, selectDragged = false;
+static unsigned int selectStartX, selectStartY;
+// Rectangle copied with Ctrl+C. Pasting copies from it on the canvas as it is then, so only the rectangle
+// and the offset are ever sent.
+static sf::IntRect clipboard;
+// Window pixels the arrow keys move the view by, and the zoom factor of one mouse wheel notch
+static const float PAN_STEP = 64, ZOOM_STEP = 1.25f;
+
+/*! \brief 	Returns whether a mode draws a shape, see Shape
+*
+*/
+static bool isShapeMode(int mode) {
+    return mode == LINE_MODE || mode == RECT_MODE || mode == ELLIPSE_MODE;
+}
+
+/*! \brief 	Moves or copies a rectangle of our layer by an offset, and tells the others only that
+*
+*/
+static void sendSelection(App *app, const string &username, sf::IntRect rect, int offsetX, int offsetY, bool move) {
+    sf::Packet packet;
+    sf::Uint8 header = SELECTION;
+    packet << header << username << (sf::Uint32)rect.left << (sf::Uint32)rect.top << (sf::Uint32)rect.width
+           << (sf::Uint32)rect.height << (sf::Int32)offsetX << (sf::Int32)offsetY << (sf::Uint8)move;
+    app->addCommand(new Selection(&app->getImage(), rect.left, rect.top, rect.width, rect.height, offsetX, offsetY,
+                                  move, app->getEraseColor()));
+    app->sendCommand(packet);
 }
 
 /*! \brief 	The update function presented can be simplified.
@@ -75,11 +77,23 @@ void update(App *app) {
 
     bool lostFocusSinceDrawing = false;
 
+    // Apply everything the others sent since the last frame, also while we are not focused
+    while (app->executeReceivedCommand()) {
+    }
+
     // Update stored mouse position
-    if (app->getWindow().hasFocus()) {
-        sf::Vector2i mousePos = sf::Mouse::getPosition(app->getWindow());
-        app->mouseX = mousePos.x;
-        app->mouseY = mousePos.y;
+    if (!app->isHeadless() && app->getWindow().hasFocus()) {
+        // Commands and presence use canvas positions, which differ from window ones once zoomed or panned
+        sf::Vector2i mousePos = app->getMousePosition();
+        sf::Vector2f canvasPos = app->toCanvas(mousePos);
+        sf::Vector2u canvasSize = app->getImage().getSize();
+        bool onCanvas = mousePos.x >= 0 && mousePos.y >= 0 &&
+                        mousePos.x < (int)App::WINDOW_WIDTH && mousePos.y < (int)App::WINDOW_HEIGHT &&
+                        canvasPos.x >= 0 && canvasPos.y >= 0 && canvasPos.x < canvasSize.x && canvasPos.y < canvasSize.y;
+        if (onCanvas) {
+            app->mouseX = (unsigned int)canvasPos.x;
+            app->mouseY = (unsigned int)canvasPos.y;
+        }
 
         // For storing packet data
         sf::Packet packet;
@@ -88,10 +102,17 @@ void update(App *app) {
         string username = app->getClient()->getUsername();
 
         // Respond to key events
-        while (app->getWindow().pollEvent(event)) {
-            // Thread for handling incoming commands
-            thread net(executeReceivedCommands, app);
-            net.join();
+        while (app->pollEvent(event)) {
+            // Only events that change what is shown need a window rendered again. Moving the mouse changes
+            // nothing until it draws, and commands, zooming and panning invalidate the canvas themselves.
+            if (event.type == sf::Event::Resized || event.type == sf::Event::GainedFocus ||
+                event.type == sf::Event::LostFocus) {
+                app->invalidateCanvas();
+            }
+            // The GUI shows the colour and brush size the keys change
+            if (event.type == sf::Event::KeyReleased) {
+                app->invalidateGUI();
+            }
 
             if (event.type == sf::Event::KeyReleased) {
                 switch (event.key.code) {
@@ -123,22 +144,28 @@ void update(App *app) {
                         packet.clear();
                         header = UNDO;
                         packet << header << username;
-                        app->getClient()->sendCommand(packet);
-                        app->undoCommand();
+                        app->sendCommand(packet);
+                        // When the server's order is authoritative, the undo is drawn once it comes back sequenced
+                        if (!app->getReconciler()) {
+                            app->undoCommand();
+                        }
                         break;
                     case sf::Keyboard::Y:
                         packet.clear();
                         header = REDO;
                         packet << header << username;
-                        app->getClient()->sendCommand(packet);
-                        app->redoCommand();
+                        app->sendCommand(packet);
+                        if (!app->getReconciler()) {
+                            app->redoCommand();
+                        }
                         break;
                     case:: sf::Keyboard::Space:
                         packet.clear();
                         header = CLEARSCREEN;
                         packet << header << username;
+                        app->getPalette(username).write(packet, app->selectedColor);
                         app->addCommand(new ClearScreen(app));
-                        app->getClient()->sendCommand(packet);
+                        app->sendCommand(packet);
                         break;
                     case sf::Keyboard::RBracket:
                         app->brushRadius++;
@@ -148,12 +175,104 @@ void update(App *app) {
                         app->brushRadius--;
                         cout << "Radius decrease\n";
                         break;
+                    case sf::Keyboard::C:
+                        if (event.key.control && app->selection.width > 0 && app->selection.height > 0) {
+                            clipboard = app->selection;
+                        }
+                        break;
+                    case sf::Keyboard::V:
+                        // Pastes with its top left corner under the mouse, which becomes the selection
+                        if (event.key.control && onCanvas && clipboard.width > 0 && clipboard.height > 0) {
+                            int offsetX = (int)app->mouseX - clipboard.left, offsetY = (int)app->mouseY - clipboard.top;
+                            sendSelection(app, username, clipboard, offsetX, offsetY, false);
+                            app->selection = sf::IntRect(app->mouseX, app->mouseY, clipboard.width, clipboard.height);
+                        }
+                        break;
                     case sf::Keyboard::Escape:
                         app->getClient()->getSocket()->disconnect();
                         exit(EXIT_SUCCESS);
                     default:
                         break;
                 }
+            } else if (event.type == sf::Event::KeyPressed) {
+                // Held keys repeat, so the view keeps moving
+                switch (event.key.code) {
+                    case sf::Keyboard::Left:
+                        app->pan(-PAN_STEP, 0);
+                        break;
+                    case sf::Keyboard::Right:
+                        app->pan(PAN_STEP, 0);
+                        break;
+                    case sf::Keyboard::Up:
+                        app->pan(0, -PAN_STEP);
+                        break;
+                    case sf::Keyboard::Down:
+                        app->pan(0, PAN_STEP);
+                        break;
+                    case sf::Keyboard::Home:
+                        app->resetView();
+                        break;
+                    default:
+                        break;
+                }
+            } else if (event.type == sf::Event::MouseWheelScrolled &&
+                       event.mouseWheelScroll.wheel == sf::Mouse::VerticalWheel) {
+                sf::Vector2i position(event.mouseWheelScroll.x - app->getCanvasOffset(), event.mouseWheelScroll.y);
+                app->zoomAt(position, event.mouseWheelScroll.delta > 0 ? ZOOM_STEP : 1 / ZOOM_STEP);
+            } else if (event.type == sf::Event::MouseButtonPressed && app->selectedMode == FILL_MODE) {
+                // A fill is a single command, and only its seed is sent
+                if (onCanvas && app->getWindow().hasFocus()) {
+                    packet.clear();
+                    header = FLOODFILL;
+                    packet << header << username << app->mouseX << app->mouseY;
+                    app->getPalette(username).write(packet, app->selectedColor);
+                    packet << app->fillTolerance;
+                    app->addCommand(new FloodFill(app));
+                    app->sendCommand(packet);
+                }
+            } else if (event.type == sf::Event::MouseButtonPressed && isShapeMode(app->selectedMode)) {
+                shapeStarted = onCanvas && app->getWindow().hasFocus();
+                shapeStartX = app->mouseX;
+                shapeStartY = app->mouseY;
+            } else if (event.type == sf::Event::MouseButtonReleased && isShapeMode(app->selectedMode)) {
+                // The whole shape is one command and one message, however large
+                if (shapeStarted) {
+                    packet.clear();
+                    header = app->selectedMode == LINE_MODE ? LINE : app->selectedMode == RECT_MODE ? RECT : ELLIPSE;
+                    packet << header << username << shapeStartX << shapeStartY << app->mouseX << app->mouseY;
+                    app->getPalette(username).write(packet, app->selectedColor);
+                    packet << app->brushRadius << app->brushOpacity << (sf::Uint8)app->blendMode
+                           << (sf::Uint8)app->fillShapes;
+                    app->addCommand(Shape::create(header, &app->getImage(), shapeStartX, shapeStartY, app->mouseX,
+                                                  app->mouseY, app->brushRadius, app->selectedColor,
+                                                  app->brushOpacity, app->blendMode, app->fillShapes));
+                    app->sendCommand(packet);
+                    shapeStarted = false;
+                }
+            } else if (event.type == sf::Event::MouseButtonPressed && app->selectedMode == SELECT_MODE) {
+                // Dragging from inside the selection moves it, from anywhere else picks a new one
+                selectStarted = onCanvas && app->getWindow().hasFocus();
+                selectDragged = app->selection.contains(app->mouseX, app->mouseY);
+                selectStartX = app->mouseX;
+                selectStartY = app->mouseY;
+            } else if (event.type == sf::Event::MouseButtonReleased && app->selectedMode == SELECT_MODE) {
+                if (selectStarted && selectDragged) {
+                    // The whole move is one command and one message, with Ctrl held it is a copy
+                    int offsetX = (int)app->mouseX - (int)selectStartX, offsetY = (int)app->mouseY - (int)selectStartY;
+                    bool copy = sf::Keyboard::isKeyPressed(sf::Keyboard::LControl) ||
+                                sf::Keyboard::isKeyPressed(sf::Keyboard::RControl);
+                    if (offsetX != 0 || offsetY != 0) {
+                        sendSelection(app, username, app->selection, offsetX, offsetY, !copy);
+                        app->selection.left += offsetX;
+                        app->selection.top += offsetY;
+                    }
+                } else if (selectStarted) {
+                    app->selection = sf::IntRect(min(selectStartX, app->mouseX), min(selectStartY, app->mouseY),
+                                                 max(selectStartX, app->mouseX) - min(selectStartX, app->mouseX) + 1,
+                                                 max(selectStartY, app->mouseY) - min(selectStartY, app->mouseY) + 1);
+                    app->invalidateCanvas();
+                }
+                selectStarted = false;
             } else if (event.type == sf::Event::MouseButtonPressed &&
                        app->getWindow().hasFocus()) {
                 packet.clear();
@@ -172,14 +291,15 @@ void update(App *app) {
                 }
 
                 packet << header << username;
-                app->getClient()->sendCommand(packet);
+                app->sendCommand(packet);
                 app->startComposite(username, cc);
+                strokeSampled = false;
 
                 lostFocusSinceDrawing = false;
             } else if (event.type == sf::Event::LostFocus) {
                 lostFocusSinceDrawing = true;
             } else if (event.type == sf::Event::LostFocus ||
-                       event.type == sf::Event::MouseButtonReleased) {
+                       (event.type == sf::Event::MouseButtonReleased && app->selectedMode != FILL_MODE)) {
 
                 packet.clear();
 
@@ -194,21 +314,25 @@ void update(App *app) {
 
                 packet << header << username;
 
-                app->getClient()->sendCommand(packet);
+                app->sendCommand(packet);
                 app->endComposite(username);
             }
         }
 
+        // Let the others see where we are, the client limits how often this is sent
+        if (onCanvas) {
+            app->getClient()->sendPresence(app->mouseX, app->mouseY);
+        }
+
         // Respond to mouse pressed
-        if (sf::Mouse::isButtonPressed(sf::Mouse::Left)) {
+        if (sf::Mouse::isButtonPressed(sf::Mouse::Left) &&
+            (app->selectedMode == DRAW_MODE || app->selectedMode == ERASE_MODE)) {
             if (lostFocusSinceDrawing) {
                 app->addCommand(new BrushStroke());
                 lostFocusSinceDrawing = false;
             }
-            if (!(app->mouseX < 0 ||
-                  app->mouseX > App::WINDOW_WIDTH ||
-                  app->mouseY < 0 ||
-                  app->mouseY > App::WINDOW_HEIGHT)) {
+            if (onCanvas &&
+                !(strokeSampled && app->mouseX == lastSampleX && app->mouseY == lastSampleY)) {
 
                 packet.clear();
                 Command *cmd;
@@ -218,10 +342,10 @@ void update(App *app) {
                     cmd = d;
                     header = DRAWBRUSH;
 
-                    // Convert color to Uint8 int
-                    sf::Uint8 ncolor = App::getColorNumber(d->m_newColor);
-
-                    packet << header << username << app->mouseX << app->mouseY << ncolor << app->brushRadius;
+                    packet << header << username << app->mouseX << app->mouseY;
+                    // Usually a single byte, see Palette
+                    app->getPalette(username).write(packet, d->m_newColor);
+                    packet << app->brushRadius << d->m_opacity << (sf::Uint8)d->m_mode;
                 } else if (app->selectedMode == ERASE_MODE) {
                     Eraser *e = new Eraser(app);
                     cmd = e;
@@ -232,8 +356,12 @@ void update(App *app) {
                     return;
                 }
 
-                app->getClient()->sendCommand(packet);
+                app->sendCommand(packet);
                 app->addToComposite(username, cmd);
+
+                strokeSampled = true;
+                lastSampleX = app->mouseX;
+                lastSampleY = app->mouseY;
             }
         }
     }
@@ -247,24 +375,82 @@ void draw(App *app) {
 
     if (elapsed.asSeconds() > (1.0 / App::FRAMES_PER_SECOND)) {
         app->getClock().restart();
-        app->getTexture().loadFromImage(app->getImage());
+        app->updateTiles();
+    } else {
+        // Too soon to upload again, so keep the canvas dirty until it is
+        app->invalidateCanvas();
     }
 }
 
 /*! \brief 	The entry point into our program.
+*		Pass --single-window to draw the GUI and the canvas in one window, --headless for a client
+*		without windows that only follows the others, and --canvas=WIDTHxHEIGHT for a canvas of
+*		another size than the window. --record=FILE records the session for App_Replay, see
+*		SessionRecorder. --trace-events=FILE writes Chrome trace events, see EventTrace.
+*		A server passed --stats=FILE appends its metrics to the file every --stats-interval=SECONDS
+*		(10 by default), and the admin role prints those of a server running on this machine.
 *
 */
-int main() {
+int main(int argc, char *argv[]) {
+    WindowLayout layout = SEPARATE_WINDOWS;
+    unsigned int canvasWidth = App::WINDOW_WIDTH, canvasHeight = App::WINDOW_HEIGHT;
+    SessionRecorder *recorder = nullptr;
+    string tracePath;
+    string statsPath;
+    float statsInterval = 10;
+
+    for (int i = 1; i < argc; i++) {
+        string argument = argv[i];
+        if (argument == "--single-window") {
+            layout = SINGLE_WINDOW;
+        } else if (argument == "--headless") {
+            layout = HEADLESS;
+        } else if (argument.rfind("--canvas=", 0) == 0) {
+            // Both sides are needed, each from 1 to Canvas::MAX_SIZE, or the default size is kept
+            unsigned int width, height;
+            char rest;
+            if (sscanf(argument.c_str(), "--canvas=%ux%u%c", &width, &height, &rest) == 2 && width > 0 &&
+                height > 0 && width <= Canvas::MAX_SIZE && height <= Canvas::MAX_SIZE) {
+                canvasWidth = width;
+                canvasHeight = height;
+            } else {
+                cerr << "Ignoring " << argument << ", the canvas stays " << canvasWidth << "x" << canvasHeight << endl;
+            }
+        } else if (argument.rfind("--record=", 0) == 0) {
+            recorder = new SessionRecorder(argument.substr(9));
+        } else if (argument.rfind("--trace-events=", 0) == 0) {
+            tracePath = argument.substr(15);
+        } else if (argument.rfind("--stats=", 0) == 0) {
+            statsPath = argument.substr(8);
+        } else if (argument.rfind("--stats-interval=", 0) == 0) {
+            // Anything but a whole, positive number of seconds keeps the default
+            float seconds;
+            char rest;
+            if (sscanf(argument.c_str(), "--stats-interval=%f%c", &seconds, &rest) == 1 && seconds > 0 &&
+                isfinite(seconds)) {
+                statsInterval = seconds;
+            } else {
+                cerr << "Ignoring " << argument << ", stats are written every " << statsInterval << " s" << endl;
+            }
+        }
+    }
 
     // Stores a role of either a server or client user.
     string role;
 
     // Set the role
-    cout << "Enter (s) for Server, Enter (c) for Client: " << endl;
+    cout << "Enter (s) for Server, Enter (c) for Client, Enter (a) for Admin: " << endl;
     cin >> role;
 
     if (role[0] == 's' || role[0] == 'S') {
         TCPServer server;
+        server.setRecorder(recorder);
+        if (!tracePath.empty()) {
+            EventTrace::start(tracePath, "Server");
+        }
+        if (!statsPath.empty() && !server.setStatsFile(statsPath, sf::seconds(statsInterval))) {
+            cout << "Could not open " << statsPath << " for the stats\n";
+        }
         int port;
         cout << "Which port would you like to connect to? \n";
         cin >> port;
@@ -277,7 +463,9 @@ int main() {
         }
 
     } else if (role[0] == 'c' || role[0] == 'C') {
-        App app = App(&update, &draw);
+        App app = App(&update, &draw, layout);
+        app.setCanvasSize(canvasWidth, canvasHeight);
+        app.setRecorder(recorder);
 
         // Create a client and have them join
         string uname;
@@ -287,12 +475,30 @@ int main() {
         cout << "Which port will you try? (e.g. 4000):";
         cin >> port;
         TCPClient me(uname, port);
-        app.getWindow().setTitle(uname + "'s Mini App");
+        if (!tracePath.empty()) {
+            EventTrace::start(tracePath, "Client " + uname);
+        }
+        if (!app.isHeadless()) {
+            app.getWindow().setTitle(uname + "'s Mini App");
+        }
         app.addClient(&me);
         app.loop();
         // destroy our app
         app.destroy();
+    } else if (role[0] == 'a' || role[0] == 'A') {
+        // Print the metrics of a server on this machine
+        unsigned short port;
+        string stats;
+        cout << "Which port is the server on? ";
+        cin >> port;
+        if (TCPServer::queryStats(sf::IpAddress::LocalHost, port, stats)) {
+            cout << stats;
+        } else {
+            cout << "No server answered on port " << port << endl;
+        }
     }
 
+    EventTrace::stop();
+    delete recorder;
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,145 @@
+/**
+ *  @file   replay.cpp
+ *  @brief  Entry point of the replay tool, draws a recorded session without windows and times it
+ *  @author Ellah
+ *  @date   2021-12-22
+ ***********************************************/
+
+// Include standard library C++ libraries.
+#include <iostream>
+#include <iomanip>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <map>
+// Project header files
+#include "App.hpp"
+#include "SessionRecorder.hpp"
+using namespace std;
+
+// Names of the message headers, in HeaderType order
+static const char *const HEADER_NAMES[] = {
+        "DRAWBRUSH", "START_BRUSHSTROKE", "END_BRUSHSTROKE", "CLEARSCREEN", "ERASER", "START_ERASERSTROKE",
+        "END_ERASERSTROKE", "UNDO", "REDO", "NON_COMMAND", "ACK", "RESUME", "PRESENCE", "LAYER", "STATS",
+        "FLOODFILL", "LINE", "RECT", "ELLIPSE", "SELECTION"
+};
+
+// Number of messages of one kind and the time spent applying them
+struct PhaseTime {
+    unsigned long count = 0;
+    sf::Int64 microseconds = 0;
+};
+
+/*! \brief 	Prints a phase's time, and its count if it has one
+*
+*/
+void printPhase(const string &name, const PhaseTime &phase) {
+    cout << "  " << left << setw(20) << name << right << setw(12) << phase.microseconds << " us";
+    if (phase.count > 0) {
+        cout << setw(10) << phase.count << " x " << phase.microseconds / (double)phase.count << " us";
+    }
+    cout << endl;
+}
+
+/*! \brief 	The entry point of the replay tool.
+*		Pass the trace to replay, --realtime to keep the recorded timing instead of going as fast as
+*		possible, --canvas=WIDTHxHEIGHT for the recorded canvas size and --expect=HASH to fail unless the
+*		final canvas has the given hash.
+*
+*/
+int main(int argc, char *argv[]) {
+    string path, expected;
+    bool realtime = false;
+    unsigned int canvasWidth = App::WINDOW_WIDTH, canvasHeight = App::WINDOW_HEIGHT;
+
+    for (int i = 1; i < argc; i++) {
+        string argument = argv[i];
+        if (argument == "--realtime") {
+            realtime = true;
+        } else if (argument.rfind("--canvas=", 0) == 0) {
+            // Checked like the App's own --canvas
+            unsigned int width, height;
+            char rest;
+            if (sscanf(argument.c_str(), "--canvas=%ux%u%c", &width, &height, &rest) == 2 && width > 0 &&
+                height > 0 && width <= Canvas::MAX_SIZE && height <= Canvas::MAX_SIZE) {
+                canvasWidth = width;
+                canvasHeight = height;
+            } else {
+                cerr << "Ignoring " << argument << ", the canvas stays " << canvasWidth << "x" << canvasHeight << endl;
+            }
+        } else if (argument.rfind("--expect=", 0) == 0) {
+            expected = argument.substr(9);
+        } else {
+            path = argument;
+        }
+    }
+
+    PhaseTime loading, applying, waiting, compositing, hashing;
+    map<sf::Uint8, PhaseTime> byHeader;
+    sf::Clock clock;
+
+    vector<TraceEntry> entries;
+    bool complete = SessionRecorder::load(path, entries);
+    if (!complete) {
+        cerr << "Could not read all of " << path << ", replaying the " << entries.size() << " entries read" << endl;
+    }
+    loading.microseconds = clock.restart().asMicroseconds();
+
+    App app(nullptr, nullptr, HEADLESS);
+    app.setCanvasSize(canvasWidth, canvasHeight);
+
+    // The commands log as they are drawn, which is not what is being timed
+    streambuf *log = cout.rdbuf();
+    cout.rdbuf(nullptr);
+    sf::Clock session;
+    for (TraceEntry &entry: entries) {
+        if (realtime) {
+            clock.restart();
+            sf::sleep(sf::microseconds(entry.time - session.getElapsedTime().asMicroseconds()));
+            waiting.microseconds += clock.getElapsedTime().asMicroseconds();
+        }
+
+        sf::Uint8 header = entry.packet.getDataSize() > 0 ? *static_cast<const sf::Uint8 *>(entry.packet.getData())
+                                                          : (sf::Uint8)NON_COMMAND;
+        clock.restart();
+        app.applyCommand(entry.packet);
+        sf::Int64 elapsed = clock.getElapsedTime().asMicroseconds();
+
+        byHeader[header].count++;
+        byHeader[header].microseconds += elapsed;
+        applying.count++;
+        applying.microseconds += elapsed;
+    }
+    cout.rdbuf(log);
+    cout.clear();
+
+    clock.restart();
+    Canvas &composite = app.getLayers().composite();
+    compositing.microseconds = clock.restart().asMicroseconds();
+    sf::Uint64 hash = composite.getHash();
+    hashing.microseconds = clock.restart().asMicroseconds();
+
+    cout << "Replayed " << entries.size() << " messages from " << path << endl;
+    printPhase("load", loading);
+    printPhase("apply", applying);
+    for (auto &phase: byHeader) {
+        string name = phase.first < sizeof(HEADER_NAMES) / sizeof(HEADER_NAMES[0]) ? HEADER_NAMES[phase.first] : "?";
+        printPhase("  " + name, phase.second);
+    }
+    if (realtime) {
+        printPhase("wait", waiting);
+    }
+    printPhase("composite", compositing);
+    printPhase("hash", hashing);
+
+    stringstream hex;
+    hex << std::hex << setw(16) << setfill('0') << hash;
+    cout << "Canvas hash: " << hex.str() << endl;
+    app.destroy();
+
+    if (!expected.empty() && expected != hex.str()) {
+        cerr << "Expected canvas hash " << expected << endl;
+        return 1;
+    }
+    return complete ? 0 : 1;
+}
@@ -0,0 +1,170 @@
+/**
+ *  @file   benchmarks.cpp
+ *  @brief  Micro-benchmarks for drawing commands and undo/redo. Run with --reporter xml to keep the
+ *          results for comparing releases.
+ *  @author Ellah
+ *  @date   2021-12-21
+ ***********************************************/
+
+#include "catch_amalgamated.hpp"
+
+// Include standard library C++ libraries.
+#include <string>
+#include <vector>
+
+// Project header files
+#include "App.hpp"
+#include "DrawBrush.hpp"
+#include "BrushStroke.hpp"
+#include "ClearScreen.hpp"
+#include "Eraser.hpp"
+#include "FloodFill.hpp"
+#include "Shape.hpp"
+#include "Selection.hpp"
+#include "Canvas.hpp"
+using namespace std;
+
+// Brush radii measured, the GUI goes up to 64
+static const vector<unsigned int> BENCHMARK_RADII = {1, 4, 16, 64}; // NOLINT(cert-err58-cpp)
+
+TEST_CASE("DrawBrush", "[benchmark]") {
+    Canvas canvas;
+    canvas.create(App::WINDOW_WIDTH, App::WINDOW_HEIGHT, sf::Color::White);
+
+    for (unsigned int radius: BENCHMARK_RADII) {
+        string suffix = " radius " + to_string(radius);
+
+        // Constructing saves the pixels under the dab for undo
+        BENCHMARK("DrawBrush construct" + suffix) {
+            return DrawBrush(&canvas, 400, 400, radius, sf::Color::Red, 200);
+        };
+
+        DrawBrush dab(&canvas, 400, 400, radius, sf::Color::Red, 200);
+        BENCHMARK("DrawBrush execute" + suffix) {
+            return dab.execute();
+        };
+        BENCHMARK("DrawBrush undo" + suffix) {
+            return dab.undo();
+        };
+    }
+}
+
+TEST_CASE("BrushStroke", "[benchmark]") {
+    Canvas canvas;
+    canvas.create(App::WINDOW_WIDTH, App::WINDOW_HEIGHT, sf::Color::White);
+
+    // A long diagonal drag, filled in with a dab for every pixel of its length
+    for (unsigned int radius: {4u, 16u}) {
+        BENCHMARK_ADVANCED("BrushStroke drag radius " + to_string(radius))(Catch::Benchmark::Chronometer meter) {
+            DrawBrush first(&canvas, 10, 10, radius, sf::Color::Blue);
+            DrawBrush second(&canvas, 11, 11, radius, sf::Color::Blue);
+            DrawBrush last(&canvas, 790, 610, radius, sf::Color::Blue);
+            meter.measure([&] {
+                BrushStroke stroke;
+                stroke.addAndExecuteCommand(&first);
+                stroke.addAndExecuteCommand(&second);
+                stroke.addAndExecuteCommand(&last);
+                return stroke.getDraws().size();
+            });
+        };
+    }
+}
+
+TEST_CASE("Eraser", "[benchmark]") {
+    Canvas canvas;
+    canvas.create(App::WINDOW_WIDTH, App::WINDOW_HEIGHT, sf::Color::White);
+
+    for (unsigned int radius: BENCHMARK_RADII) {
+        Eraser eraser(&canvas, 400, 400, radius, sf::Color::White);
+        BENCHMARK("Eraser execute radius " + to_string(radius)) {
+            return eraser.execute();
+        };
+    }
+}
+
+TEST_CASE("ClearScreen", "[benchmark]") {
+    Canvas canvas;
+    canvas.create(App::WINDOW_WIDTH, App::WINDOW_HEIGHT, sf::Color::White);
+    ClearScreen clear(&canvas, sf::Color::White, sf::Color::Blue);
+    ClearScreen back(&canvas, sf::Color::Blue, sf::Color::White);
+
+    BENCHMARK("ClearScreen execute twice") {
+        clear.execute();
+        return back.execute();
+    };
+}
+
+TEST_CASE("FloodFill", "[benchmark]") {
+    // A blank 4k canvas, filled whole
+    Canvas canvas;
+    canvas.create(4096, 4096, sf::Color::White);
+    FloodFill fill(&canvas, 2048, 2048, sf::Color::Red);
+
+    BENCHMARK("FloodFill execute and undo 4096x4096") {
+        fill.execute();
+        return fill.undo();
+    };
+}
+
+TEST_CASE("Shapes", "[benchmark]") {
+    Canvas canvas;
+    canvas.create(App::WINDOW_WIDTH, App::WINDOW_HEIGHT, sf::Color::White);
+
+    // The first execute also works out the spans
+    BENCHMARK("Line construct and execute radius 4") {
+        Line line(&canvas, 10, 10, 790, 610, 4, sf::Color::Blue);
+        return line.execute();
+    };
+    BENCHMARK("Ellipse construct and execute filled") {
+        Ellipse ellipse(&canvas, 0, 0, 799, 799, 1, sf::Color::Blue, 255, BLEND_NORMAL, true);
+        return ellipse.execute();
+    };
+    Rect rect(&canvas, 0, 0, 799, 799, 1, sf::Color::Blue, 200, BLEND_NORMAL, true);
+    rect.execute();
+    BENCHMARK("Rect filled undo and execute") {
+        rect.undo();
+        return rect.execute();
+    };
+}
+
+TEST_CASE("Selection", "[benchmark]") {
+    Canvas canvas;
+    canvas.create(4096, 4096, sf::Color::White);
+    Rect rect(&canvas, 100, 100, 1099, 1099, 1, sf::Color::Blue, 255, BLEND_NORMAL, true);
+    rect.execute();
+
+    // A 1000x1000 area moved by a few pixels, and by whole tiles
+    Selection rows(&canvas, 100, 100, 1000, 1000, 13, 7, true, sf::Color::White);
+    BENCHMARK("Selection move 1000x1000 execute and undo") {
+        rows.execute();
+        return rows.undo();
+    };
+    Selection tiles(&canvas, 64, 64, 1024, 1024, 128, 64, true, sf::Color::White);
+    BENCHMARK("Selection move 1024x1024 tiles execute and undo") {
+        tiles.execute();
+        return tiles.undo();
+    };
+}
+
+TEST_CASE("App undo and redo", "[benchmark]") {
+    App app(nullptr, nullptr, HEADLESS);
+    app.brushRadius = 16;
+
+    // A full history of dabs across the canvas
+    for (unsigned int i = 0; i < App::MAX_REMEMBERED_COMMANDS; i++) {
+        app.mouseX = (i * 37) % App::WINDOW_WIDTH;
+        app.mouseY = (i * 53) % App::WINDOW_HEIGHT;
+        app.addCommand(new DrawBrush(&app));
+    }
+
+    BENCHMARK("App undo and redo the whole history") {
+        for (unsigned int i = 0; i < App::MAX_REMEMBERED_COMMANDS; i++) {
+            app.undoCommand();
+        }
+        for (unsigned int i = 0; i < App::MAX_REMEMBERED_COMMANDS; i++) {
+            app.redoCommand();
+        }
+        return app.getImage().getPixel(0, 0);
+    };
+    app.destroy();
+}
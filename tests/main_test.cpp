@@ -12,6 +12,11 @@
 #include <string>
 #include <thread>
 #include <utility>
+#include <numeric>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
 
 // Include our Third-Party SFML header
 #include <SFML/Graphics.hpp>
@@ -32,13 +37,26 @@
 #include "EraserStroke.hpp"
 #include "TCPServer.hpp"
 #include "TCPClient.hpp"
+#include "Reconciler.hpp"
+#include "Palette.hpp"
+#include "Canvas.hpp"
+#include "LayerStack.hpp"
+#include "Blend.hpp"
+#include "LoadGenerator.hpp"
+#include "SessionRecorder.hpp"
+#include "Profiler.hpp"
+#include "EventTrace.hpp"
+#include "AllocationCounter.hpp"
+#include "FloodFill.hpp"
+#include "Shape.hpp"
+#include "Selection.hpp"
 using namespace std;
 
 
-TEST_CASE("App initializes members properly & successfully destroys"){
+TEST_CASE("App initializes members properly & successfully destroys", "[window]"){
 
   App app = App(nullptr, nullptr);
-  sf::Image* image = &app.getImage();
+  Canvas* image = &app.getImage();
   sf::Window* window = &app.getWindow();
 
   REQUIRE(image != nullptr);
@@ -53,9 +71,25 @@ TEST_CASE("App initializes members properly & successfully destroys"){
   REQUIRE_NOTHROW(app.destroy());
 }
 
+TEST_CASE("A single window App draws the canvas right of the GUI", "[window]") {
+  App separate = App(nullptr, nullptr);
+  App single = App(nullptr, nullptr, SINGLE_WINDOW);
+
+  REQUIRE(separate.getCanvasOffset() == 0);
+  REQUIRE(single.getCanvasOffset() == (int)App::GUI_WIDTH);
+  // The canvas keeps its size either way
+  REQUIRE(single.getImage().getSize() == separate.getImage().getSize());
+
+  sf::Event event;
+  REQUIRE(single.pollEvent(event) == false);
+
+  separate.destroy();
+  single.destroy();
+}
+
 TEST_CASE("Drawing commands update sf::Image") {
-  App* app = new App(nullptr, nullptr);
-  sf::Image* image = &app->getImage();
+  App* app = new App(nullptr, nullptr, HEADLESS);
+  Canvas* image = &app->getImage();
   app->mouseX = 10;
   app->mouseY = 15;
 
@@ -70,8 +104,8 @@ TEST_CASE("Drawing commands update sf::Image") {
 
 // TODO: This test is failing at line 98
 TEST_CASE("Erasing commands update sf::Image") {
-    App* app = new App(nullptr, nullptr);
-    sf::Image* image = &app->getImage();
+    App* app = new App(nullptr, nullptr, HEADLESS);
+    Canvas* image = &app->getImage();
     app->selectedColor = sf::Color::Black;
     app->backgroundColor = sf::Color::White;
 
@@ -112,8 +146,8 @@ TEST_CASE("Erasing commands update sf::Image") {
 }
 
 TEST_CASE("Clearing screen commands clear to correct color") {
-    App* app = new App(nullptr, nullptr);
-    sf::Image* image = &app->getImage();
+    App* app = new App(nullptr, nullptr, HEADLESS);
+    Canvas* image = &app->getImage();
     app->selectedColor = sf::Color::Black;
     app->backgroundColor = sf::Color::White;
 
@@ -125,8 +159,8 @@ TEST_CASE("Clearing screen commands clear to correct color") {
 
 // TODO: This test is failing at line 146
 TEST_CASE("App remembers exactly 100 commands to undo/redo") {
-  App* app = new App(nullptr, nullptr);
-  sf::Image* image = &app->getImage();
+  App* app = new App(nullptr, nullptr, HEADLESS);
+  Canvas* image = &app->getImage();
 
   // Draw on 101 pixels & verify
   app->mouseX = 10;
@@ -159,8 +193,8 @@ TEST_CASE("App remembers exactly 100 commands to undo/redo") {
 }
 
 TEST_CASE("Making a new draw clears undo history") {
-  App* app = new App(nullptr, nullptr);
-  sf::Image* image = &app->getImage();
+  App* app = new App(nullptr, nullptr, HEADLESS);
+  Canvas* image = &app->getImage();
 
   // Draw at (10,15) then undo
   app->mouseX = 10;
@@ -184,8 +218,8 @@ TEST_CASE("Making a new draw clears undo history") {
 }
 
 TEST_CASE("Executing/undoing DrawBrush changes pixels within a specified radius") {
-    App* app = new App(nullptr, nullptr);
-    sf::Image* image = &app->getImage();
+    App* app = new App(nullptr, nullptr, HEADLESS);
+    Canvas* image = &app->getImage();
 
     app->mouseX = 100;
     app->mouseY = 200;
@@ -224,8 +258,8 @@ TEST_CASE("Executing/undoing DrawBrush changes pixels within a specified radius"
 }
 
 TEST_CASE("Adding to a BrushStroke draws multiple brush circles and undoing it undoes all of them") {
-    App* app = new App(nullptr, nullptr);
-    sf::Image* image = &app->getImage();
+    App* app = new App(nullptr, nullptr, HEADLESS);
+    Canvas* image = &app->getImage();
 
     app->brushRadius = 10;
     app->selectedColor = sf::Color::Yellow;
@@ -249,6 +283,214 @@ TEST_CASE("Adding to a BrushStroke draws multiple brush circles and undoing it u
     REQUIRE(image->getPixel(45, 45) == sf::Color::White);
 }
 
+TEST_CASE("A remote BrushStroke rebuilt from sparse samples matches the local interpolation") {
+    App* app = new App(nullptr, nullptr, HEADLESS);
+    Canvas* image = &app->getImage();
+
+    // Samples as they would arrive in DRAWBRUSH messages between START_BRUSHSTROKE and END_BRUSHSTROKE
+    app->startComposite("remote", new BrushStroke());
+    app->addToComposite("remote", new DrawBrush(image, 50, 50, 3, sf::Color::Red));
+    app->addToComposite("remote", new DrawBrush(image, 60, 50, 3, sf::Color::Red));
+    app->addToComposite("remote", new DrawBrush(image, 160, 50, 3, sf::Color::Red));
+
+    //Check that the gap between the last two samples was filled in
+    REQUIRE(image->getPixel(110, 50) == sf::Color::Red);
+    REQUIRE(image->getPixel(159, 50) == sf::Color::Red);
+    REQUIRE(image->getPixel(110, 60) == sf::Color::White);
+
+    //Check that ending the stroke makes it a single undoable command
+    app->endComposite("remote");
+    REQUIRE(app->m_inProgressCommands.empty());
+    app->undoCommand();
+    REQUIRE(image->getPixel(50, 50) == sf::Color::White);
+    REQUIRE(image->getPixel(110, 50) == sf::Color::White);
+    REQUIRE(image->getPixel(160, 50) == sf::Color::White);
+}
+
+TEST_CASE("Reconciled clients converge on the server's order for overlapping commands") {
+    LayerStack imageA, imageB;
+    imageA.create(App::WINDOW_WIDTH, App::WINDOW_HEIGHT, sf::Color::White);
+    imageB.create(App::WINDOW_WIDTH, App::WINDOW_HEIGHT, sf::Color::White);
+    Reconciler clientA("clientA", imageA, sf::Color::White, map<string, Palette>());
+    Reconciler clientB("clientB", imageB, sf::Color::White, map<string, Palette>());
+
+    sf::Packet redDab, blueDab;
+    sf::Uint8 header = DRAWBRUSH, radius = 5, opacity = 255, mode = BLEND_NORMAL;
+    Palette paletteA, paletteB;
+    redDab << header << string("clientA") << 50 << 50;
+    paletteA.write(redDab, sf::Color::Red);
+    redDab << radius << opacity << mode;
+    blueDab << header << string("clientB") << 50 << 50;
+    paletteB.write(blueDab, sf::Color::Blue);
+    blueDab << radius << opacity << mode;
+
+    // Both draw over the same spot at once, each on their own screen straight away
+    DrawBrush(&imageA.getLayer(0), 50, 50, 5, sf::Color::Red).execute();
+    clientA.addLocal(redDab);
+    DrawBrush(&imageB.getLayer(0), 50, 50, 5, sf::Color::Blue).execute();
+    clientB.addLocal(blueDab);
+
+    // The server sequences clientA's dab first. clientA has nothing pending when clientB's arrives.
+    REQUIRE(clientA.commitLocal() == false);
+    REQUIRE(clientA.addRemote(blueDab) == false);
+    DrawBrush(&imageA.getLayer(0), 50, 50, 5, sf::Color::Blue).execute();
+
+    // clientB receives clientA's dab while its own is pending, so its own is drawn again on top
+    REQUIRE(clientB.addRemote(redDab) == true);
+    clientB.rebuild(imageB);
+    REQUIRE(clientB.getPendingCount() == 1);
+    REQUIRE(clientB.commitLocal() == false);
+    REQUIRE(clientB.getPendingCount() == 0);
+
+    //Check that both screens and both base canvases agree
+    REQUIRE(imageA.getLayer(0).getPixel(50, 50) == sf::Color::Blue);
+    REQUIRE(imageB.getLayer(0).getPixel(50, 50) == sf::Color::Blue);
+    REQUIRE(clientA.getBase().getLayer(0).getPixel(50, 50) == sf::Color::Blue);
+    REQUIRE(clientB.getBase().getLayer(0).getPixel(50, 50) == sf::Color::Blue);
+
+    // An undo is placed by the server and undoes the last sequenced command everywhere
+    sf::Packet undo;
+    header = UNDO;
+    undo << header << string("clientA");
+    clientA.addLocal(undo);
+    REQUIRE(clientA.commitLocal() == true);
+    clientA.rebuild(imageA);
+    REQUIRE(clientB.addRemote(undo) == true);
+    clientB.rebuild(imageB);
+    REQUIRE(imageA.getLayer(0).getPixel(50, 50) == sf::Color::Red);
+    REQUIRE(imageB.getLayer(0).getPixel(50, 50) == sf::Color::Red);
+}
+
+TEST_CASE("A rebuild only copies back the tiles that differ from the base") {
+    unsigned int const tile = Canvas::TILE_SIZE;
+    LayerStack screen;
+    screen.create(16 * tile, 16 * tile, sf::Color::White);
+    screen.getLayer(0).setPixel(10 * tile, 10 * tile, sf::Color::Green);
+    Reconciler client("client", screen, sf::Color::White, map<string, Palette>());
+    screen.composite();
+
+    sf::Packet localDab, remoteDab;
+    sf::Uint8 header = DRAWBRUSH, radius = 5, opacity = 255, mode = BLEND_NORMAL;
+    Palette localPalette, remotePalette;
+    localDab << header << string("client") << 50 << 50;
+    localPalette.write(localDab, sf::Color::Red);
+    localDab << radius << opacity << mode;
+    remoteDab << header << string("other") << 5 * tile + 10 << 3 * tile + 10;
+    remotePalette.write(remoteDab, sf::Color::Blue);
+    remoteDab << radius << opacity << mode;
+
+    DrawBrush(&screen.getLayer(0), 50, 50, 5, sf::Color::Red).execute();
+    client.addLocal(localDab);
+    sf::Uint64 untouched = screen.getLayer(0).getTileVersion(0, 10, 10);
+    vector<unsigned int> changed;
+    screen.getLayer(0).takeChangedTiles(changed);
+
+    REQUIRE(client.addRemote(remoteDab) == true);
+    client.rebuild(screen);
+    REQUIRE(screen.getLayer(0).getPixel(50, 50) == sf::Color::Red);
+    REQUIRE(screen.getLayer(0).getPixel(5 * tile + 10, 3 * tile + 10) == sf::Color::Blue);
+    REQUIRE(screen.getLayer(0).getPixel(10 * tile, 10 * tile) == sf::Color::Green);
+    // Only the remote dab's tile and the pending dab's tile were copied and drawn again
+    REQUIRE(screen.getLayer(0).getTileVersion(0, 10, 10) == untouched);
+    changed.clear();
+    REQUIRE_FALSE(screen.getLayer(0).takeChangedTiles(changed));
+    sort(changed.begin(), changed.end());
+    REQUIRE(changed == vector<unsigned int>{0, 3 * 16 + 5});
+
+    // Once sequenced, the screen and the base agree
+    REQUIRE(client.commitLocal() == false);
+    REQUIRE(screen.getLayer(0).getHash() == client.getBase().getLayer(0).getHash());
+}
+
+TEST_CASE("A rebuild continues our sequenced stroke without blending its last brushes again") {
+    LayerStack screen;
+    screen.create(200, 200, sf::Color::White);
+    Reconciler client("client", screen, sf::Color::White, map<string, Palette>());
+
+    sf::Packet start, dabs[3], remoteDab;
+    sf::Uint8 header = START_BRUSHSTROKE, radius = 5, opacity = 128, mode = BLEND_NORMAL;
+    Palette localPalette, remotePalette;
+    start << header << string("client");
+    header = DRAWBRUSH;
+    BrushStroke stroke;
+    for (int i = 0; i < 3; i++) {
+        dabs[i] << header << string("client") << 50 + 10 * i << 50;
+        localPalette.write(dabs[i], sf::Color::Red);
+        dabs[i] << radius << opacity << mode;
+        DrawBrush dab(&screen.getLayer(0), 50 + 10 * i, 50, radius, sf::Color::Red, opacity);
+        stroke.addAndExecuteCommand(&dab);
+    }
+    client.addLocal(start);
+    for (sf::Packet &dab: dabs) {
+        client.addLocal(dab);
+    }
+
+    // The start and the first two brushes are sequenced, the last one is still pending
+    for (int i = 0; i < 3; i++) {
+        REQUIRE(client.commitLocal() == false);
+    }
+    remoteDab << header << string("other") << 150 << 150;
+    remotePalette.write(remoteDab, sf::Color::Blue);
+    remoteDab << radius << opacity << mode;
+    REQUIRE(client.addRemote(remoteDab) == true);
+    client.rebuild(screen);
+
+    // Half transparent brushes drawn twice would come out darker than on the base
+    REQUIRE(screen.getLayer(0).getPixel(50, 50) == client.getBase().getLayer(0).getPixel(50, 50));
+    REQUIRE(client.commitLocal() == false);
+    REQUIRE(screen.getLayer(0).getHash() == client.getBase().getLayer(0).getHash());
+}
+
+TEST_CASE("A remote stroke interleaved with our pending brushes draws like the base") {
+    App app(nullptr, nullptr, HEADLESS);
+    app.setReconcile(true);
+    Palette localPalette, remotePalette;
+    sf::Uint8 header, radius = 5, opacity = 255, mode = BLEND_NORMAL;
+
+    auto remote = [&](sf::Uint8 type, int x, int y) {
+        sf::Packet packet;
+        packet << type << string("other");
+        if (type == DRAWBRUSH) {
+            packet << x << y;
+            remotePalette.write(packet, sf::Color::Blue);
+            packet << radius << opacity << mode;
+        }
+        app.applyCommand(packet);
+    };
+
+    // Our brush is on screen but not sequenced when the other stroke starts, so it is rebuilt. Without a
+    // client our name is empty.
+    sf::Packet local;
+    header = DRAWBRUSH;
+    local << header << string() << 50 << 50;
+    localPalette.write(local, sf::Color::Red);
+    local << radius << opacity << mode;
+    DrawBrush(&app.getImage(), 50, 50, radius, sf::Color::Red).execute();
+    app.sendCommand(local);
+    remote(START_BRUSHSTROKE, 100, 0);
+    remote(DRAWBRUSH, 100, 300);
+
+    // Once ours is sequenced, the rest of the stroke is drawn directly and interpolated from the first brush
+    sf::Packet ack;
+    header = ACK;
+    ack << header << string();
+    app.applyCommand(ack);
+    remote(DRAWBRUSH, 100, 340);
+    remote(DRAWBRUSH, 100, 380);
+    REQUIRE(app.getImage().getPixel(100, 360) == sf::Color::Blue);
+
+    // A stroke whose end was lost is replaced by the next one instead of continued
+    remote(START_BRUSHSTROKE, 0, 0);
+    remote(DRAWBRUSH, 300, 100);
+    remote(DRAWBRUSH, 300, 140);
+    remote(END_BRUSHSTROKE, 0, 0);
+    REQUIRE(app.getImage().getPixel(200, 240) == sf::Color::White);
+
+    REQUIRE(app.getReconciler()->getPendingCount() == 0);
+    REQUIRE(app.getImage().getHash() == app.getReconciler()->getBase().getLayer(0).getHash());
+    app.destroy();
+}
+
 void networkingServerStartTask(TCPServer *server) {
     server->connectServer("SERVER", sf::IpAddress::getLocalAddress(), 8000);
 }
@@ -322,3 +564,1389 @@ TEST_CASE("Multiple Clients can connect to server") {
     REQUIRE(clientC.diconnected() == true);
 
 }
+
+void resumingServerStartTask(TCPServer *server) {
+    server->connectServer("SERVER", sf::IpAddress::getLocalAddress(), 8001);
+}
+
+TEST_CASE("A client that resumes only receives the messages it missed") {
+    TCPServer *server = new TCPServer();
+
+    thread t1(resumingServerStartTask, server);
+    t1.detach();
+
+    while (!server->m_start) {
+        // Await server start
+    }
+
+    TCPClient clientA("clientA", 8001);
+    TCPClient clientB("clientB", 8001);
+    clientA.joinServer(sf::IpAddress::getLocalAddress(), 8001);
+    clientB.joinServer(sf::IpAddress::getLocalAddress(), 8001);
+
+    while (server->getClients() != 2) {
+        // Await clientA & clientB join
+    }
+
+    sf::Packet packetA, packetB;
+    sf::Uint8 header = UNDO;
+    packetA << header << string("clientA");
+    packetB << header << string("clientB");
+
+    // clientA sees messages 1 and 2
+    clientB.sendCommand(packetB);
+    clientB.sendCommand(packetB);
+    while (clientA.getLastSequence() != 2) {
+        clientA.receiveData();
+    }
+    while (clientA.receiveData().getDataSize() > 0) {
+        // Drain what was already received
+    }
+
+    // Message 3 is clientA's own, then clientA drops and misses 4 to 6
+    clientA.sendCommand(packetA);
+    while (server->getSequence() != 3) {
+        // Await relay of clientA's message
+    }
+    clientA.getSocket()->disconnect();
+    REQUIRE(clientA.diconnected() == true);
+
+    clientB.sendCommand(packetB);
+    clientB.sendCommand(packetB);
+    clientB.sendCommand(packetB);
+    while (server->getSequence() != 6) {
+        // Await relay of clientB's messages
+    }
+
+    while (clientA.resumeSession() != 0) {
+        // Await reconnect
+    }
+    REQUIRE(clientA.diconnected() == false);
+
+    // Only 4 to 6 are sent again, not the history. clientA's own message may only come back as an ACK.
+    while (clientA.getLastSequence() != 6) {
+        // Polls the socket without handing out what was received
+        clientA.diconnected();
+    }
+
+    int received = 0;
+    string username;
+    for (sf::Packet packet = clientA.receiveData(); packet.getDataSize() > 0; packet = clientA.receiveData()) {
+        packet >> header >> username;
+        if (username == "clientB") {
+            received++;
+        } else {
+            REQUIRE(header == ACK);
+        }
+    }
+
+    REQUIRE(received == 3);
+}
+
+void presenceServerStartTask(TCPServer *server) {
+    server->connectServer("SERVER", sf::IpAddress::getLocalAddress(), 8002);
+}
+
+TEST_CASE("Cursor positions are coalesced and only the latest one is relayed") {
+    TCPServer *server = new TCPServer();
+
+    thread t1(presenceServerStartTask, server);
+    t1.detach();
+
+    while (!server->m_start) {
+        // Await server start
+    }
+
+    TCPClient clientA("clientA", 8002);
+    TCPClient clientB("clientB", 8002);
+    clientA.joinServer(sf::IpAddress::getLocalAddress(), 8002);
+    clientB.joinServer(sf::IpAddress::getLocalAddress(), 8002);
+
+    while (server->getClients() != 2) {
+        // Await clientA & clientB join
+    }
+
+    // clientA moves far more often than the server relays
+    clientA.setPresenceRate(1000);
+    for (sf::Uint16 i = 1; i <= 50; i++) {
+        sf::sleep(sf::milliseconds(2));
+        clientA.sendPresence(i, i);
+    }
+
+    int received = 0;
+    sf::Uint8 header;
+    sf::Uint16 session, x = 0, y = 0;
+    while (x != 50) {
+        sf::Packet packet = clientB.receiveData();
+        if (packet.getDataSize() > 0) {
+            packet >> header >> session >> x >> y;
+            REQUIRE(header == PRESENCE);
+            received++;
+        }
+    }
+
+    REQUIRE(y == 50);
+    REQUIRE(received < 50);
+    // Presence is not part of the history
+    REQUIRE(server->getSequence() == 0);
+    REQUIRE(clientB.getLastSequence() == 0);
+}
+
+TEST_CASE("Colours outside the presets are shared through each sender's palette") {
+    Palette sender, receiver;
+    sf::Color orange(255, 128, 0), seeThrough(10, 20, 30, 40);
+
+    // Preset colours keep their single byte
+    sf::Packet red;
+    sender.write(red, sf::Color::Red);
+    REQUIRE(red.getDataSize() == 1);
+    REQUIRE(receiver.read(red) == sf::Color::Red);
+
+    // The first use of a colour defines it, later uses are a single byte
+    sf::Packet first, second;
+    sender.write(first, orange);
+    sender.write(second, orange);
+    REQUIRE(first.getDataSize() == 5);
+    REQUIRE(second.getDataSize() == 1);
+    REQUIRE(receiver.read(first) == orange);
+    REQUIRE(receiver.read(second) == orange);
+
+    // The server relays a colour without knowing the palette
+    sf::Packet defined, relayed;
+    sender.write(defined, seeThrough);
+    Palette::relay(defined, relayed);
+    REQUIRE(receiver.read(relayed) == seeThrough);
+
+    // Once the palette is full, colours are sent whole
+    for (sf::Uint8 i = 0; sender.getSize() < Palette::SIZE; i++) {
+        sf::Packet filler;
+        sender.write(filler, sf::Color(i, i, i, 1));
+        receiver.read(filler);
+    }
+    sf::Packet literal;
+    sender.write(literal, sf::Color(1, 2, 3));
+    REQUIRE(literal.getDataSize() == 5);
+    REQUIRE(receiver.read(literal) == sf::Color(1, 2, 3));
+    REQUIRE(receiver.getSize() == Palette::SIZE);
+
+    // An entry the sender never defined does not read past the table
+    sf::Packet unknown;
+    unknown << sf::Uint8(0x7F);
+    REQUIRE(Palette().read(unknown) == sf::Color::Black);
+}
+
+void idleServerStartTask(TCPServer *server) {
+    server->connectServer("SERVER", sf::IpAddress::getLocalAddress(), 8003);
+}
+
+TEST_CASE("An idle client sleeps until the server sends something") {
+    TCPServer *server = new TCPServer();
+
+    thread t1(idleServerStartTask, server);
+    t1.detach();
+
+    while (!server->m_start) {
+        // Await server start
+    }
+
+    TCPClient clientA("clientA", 8003);
+    TCPClient clientB("clientB", 8003);
+    clientA.joinServer(sf::IpAddress::getLocalAddress(), 8003);
+    clientB.joinServer(sf::IpAddress::getLocalAddress(), 8003);
+
+    while (server->getClients() != 2) {
+        // Await clientA & clientB join
+    }
+
+    // Nothing was sent, so the whole timeout is slept
+    sf::Clock clock;
+    REQUIRE(clientB.waitForData(sf::milliseconds(50)) == false);
+    REQUIRE(clock.getElapsedTime() >= sf::milliseconds(45));
+
+    // Data wakes the client straight away
+    sf::Packet packet;
+    sf::Uint8 header = UNDO;
+    packet << header << string("clientA");
+    clientA.sendCommand(packet);
+    clock.restart();
+    REQUIRE(clientB.waitForData(sf::seconds(5)) == true);
+    REQUIRE(clock.getElapsedTime() < sf::seconds(5));
+    REQUIRE(clientB.receiveData().getDataSize() > 0);
+}
+
+TEST_CASE("The load generator times every copy the server relays") {
+    LoadSettings settings;
+    settings.clients = 3;
+    settings.rate = 100;
+    settings.duration = sf::milliseconds(300);
+    settings.strokeLength = 4;
+    settings.port = 8004;
+
+    LoadReport report = LoadGenerator(settings).run();
+
+    // Every message sent reaches both other clients
+    REQUIRE(report.joins.size() == 3);
+    REQUIRE(report.sent >= 3 * 25);
+    REQUIRE(report.received == 2 * report.sent);
+    REQUIRE(report.latencies.size() == report.received);
+    REQUIRE(report.getLatency(0.5) <= report.getLatency(0.99));
+    REQUIRE(report.getLatency(0.99) <= report.getLatency(0.999));
+    REQUIRE(report.getLatency(1) == report.latencies.back());
+    REQUIRE(report.getThroughput() > 0);
+
+    vector<unsigned long> histogram = report.getHistogram();
+    REQUIRE(accumulate(histogram.begin(), histogram.end(), 0ul) == report.received);
+}
+
+TEST_CASE("A large canvas only keeps the tiles that were painted") {
+    Canvas canvas;
+    canvas.create(Canvas::MAX_SIZE, Canvas::MAX_SIZE, sf::Color::White);
+    REQUIRE(canvas.getSize() == sf::Vector2u(Canvas::MAX_SIZE, Canvas::MAX_SIZE));
+    REQUIRE(canvas.getTileCount() == 0);
+
+    // A dab far from the origin, across the corner of four tiles
+    DrawBrush dab(&canvas, 20032, 30016, 5, sf::Color::Red);
+    dab.execute();
+    REQUIRE(canvas.getPixel(20032, 30016) == sf::Color::Red);
+    REQUIRE(canvas.getPixel(100, 100) == sf::Color::White);
+    REQUIRE(canvas.getTileCount() == 4);
+
+    // Painting the background on a blank tile does not allocate it
+    canvas.setPixel(0, 0, sf::Color::White);
+    REQUIRE(canvas.getTileCount() == 4);
+
+    // Drawing off the edge is clipped
+    DrawBrush(&canvas, Canvas::MAX_SIZE - 1, 0, 5, sf::Color::Blue).execute();
+    REQUIRE(canvas.getPixel(Canvas::MAX_SIZE - 1, 0) == sf::Color::Blue);
+    REQUIRE(canvas.getTileCount() == 5);
+
+    // A region across painted and blank tiles
+    vector<sf::Uint8> pixels(20 * 20 * 4);
+    canvas.copyTo(pixels.data(), 20022, 30006, 20, 20, 20);
+    sf::Uint8 *center = &pixels[(10 * 20 + 10) * 4];
+    REQUIRE(sf::Color(center[0], center[1], center[2], center[3]) == sf::Color::Red);
+    REQUIRE(sf::Color(pixels[0], pixels[1], pixels[2], pixels[3]) == sf::Color::White);
+
+    // Undo puts the background back, and clearing drops every tile
+    dab.undo();
+    REQUIRE(canvas.getPixel(20032, 30016) == sf::Color::White);
+    ClearScreen(&canvas, sf::Color::White, sf::Color::Green).execute();
+    REQUIRE(canvas.getTileCount() == 0);
+    REQUIRE(canvas.getPixel(20032, 30016) == sf::Color::Green);
+    REQUIRE(canvas.getSize() == sf::Vector2u(Canvas::MAX_SIZE, Canvas::MAX_SIZE));
+}
+
+TEST_CASE("Zoomed out views are built from a pyramid of averaged tiles") {
+    Canvas canvas;
+    canvas.create(1000, 300, sf::Color::White);
+    // 16x5 tiles, then 8x3, 4x2, 2x1 and 1x1
+    REQUIRE(canvas.getLevels() == 5);
+    REQUIRE(canvas.getTileGrid(1) == sf::Vector2u(8, 3));
+    REQUIRE(canvas.getTile(2, 1, 1).empty());
+
+    // A black 2x2 block becomes one black pixel a level up, half of it one grey pixel
+    for (unsigned int y = 128; y < 130; y++) {
+        for (unsigned int x = 130; x < 132; x++) {
+            canvas.setPixel(x, y, sf::Color::Black);
+        }
+    }
+    canvas.setPixel(134, 128, sf::Color::Black);
+    canvas.setPixel(134, 129, sf::Color::Black);
+    const vector<sf::Color> &tile = canvas.getTile(1, 1, 1);
+    REQUIRE(tile[1] == sf::Color::Black);
+    REQUIRE(tile[3] == sf::Color(128, 128, 128));
+    REQUIRE(tile[0] == sf::Color::White);
+    REQUIRE(canvas.getTile(4, 0, 0)[8 * Canvas::TILE_SIZE + 8] != sf::Color::White);
+
+    // Only the tiles above a change get a new version, once asked for
+    sf::Uint64 changed = canvas.getTileVersion(1, 1, 1), unchanged = canvas.getTileVersion(1, 4, 1);
+    canvas.setPixel(131, 131, sf::Color::Red);
+    REQUIRE(canvas.getTileVersion(1, 1, 1) == changed);
+    canvas.getTile(1, 1, 1);
+    REQUIRE(canvas.getTileVersion(1, 1, 1) != changed);
+    REQUIRE(canvas.getTileVersion(1, 4, 1) == unchanged);
+
+    // Tiles past the canvas count as blank
+    REQUIRE(canvas.getTile(1, 7, 2).empty());
+}
+
+TEST_CASE("Zooming keeps the canvas position under the mouse in place", "[window]") {
+    App app(nullptr, nullptr);
+    app.setCanvasSize(4096, 4096);
+    REQUIRE(app.toCanvas(sf::Vector2i(100, 50)) == sf::Vector2f(100, 50));
+
+    app.zoomAt(sf::Vector2i(100, 50), 2);
+    REQUIRE(app.getZoom() == 2);
+    REQUIRE(app.toCanvas(sf::Vector2i(100, 50)) == sf::Vector2f(100, 50));
+    REQUIRE(app.toCanvas(sf::Vector2i(0, 0)) == sf::Vector2f(50, 25));
+    REQUIRE(app.getViewLevel() == 0);
+
+    // Zoomed out, a level with fewer tiles is shown, and only tiles in view are uploaded
+    app.resetView();
+    app.zoomAt(sf::Vector2i(0, 0), 0.25f);
+    REQUIRE(app.getViewLevel() == 2);
+    DrawBrush(&app.getImage(), 10, 10, 3, sf::Color::Red).execute();
+    DrawBrush(&app.getImage(), 4000, 4000, 3, sf::Color::Red).execute();
+    app.updateTiles();
+    REQUIRE(app.getTileTextureCount() == 1);
+
+    app.pan(App::WINDOW_WIDTH, App::WINDOW_HEIGHT);
+    app.updateTiles();
+    REQUIRE(app.getTileTextureCount() == 2);
+
+    app.zoomAt(sf::Vector2i(0, 0), 0);
+    REQUIRE(app.getZoom() == App::MIN_ZOOM);
+    app.destroy();
+}
+
+TEST_CASE("Layers are composited only where they changed") {
+    LayerStack layers;
+    layers.create(App::WINDOW_WIDTH, App::WINDOW_HEIGHT, sf::Color::White);
+    REQUIRE(layers.getLayer(1).getBackground() == sf::Color::Transparent);
+
+    DrawBrush(&layers.getLayer(0), 100, 100, 5, sf::Color::Blue).execute();
+    DrawBrush(&layers.getLayer(1), 100, 100, 2, sf::Color::Red).execute();
+    DrawBrush(&layers.getLayer(1), 500, 500, 2, sf::Color::Red).execute();
+    Canvas &composite = layers.composite();
+    REQUIRE(composite.getPixel(100, 100) == sf::Color::Red);
+    REQUIRE(composite.getPixel(104, 100) == sf::Color::Blue);
+    REQUIRE(composite.getPixel(300, 300) == sf::Color::White);
+    REQUIRE(composite.getTileCount() == 2);
+
+    // Drawing on one tile leaves the others as they were composited
+    sf::Uint64 version = composite.getTileVersion(0, 500 / Canvas::TILE_SIZE, 500 / Canvas::TILE_SIZE);
+    DrawBrush(&layers.getLayer(2), 100, 100, 1, sf::Color::Green).execute();
+    layers.composite();
+    REQUIRE(composite.getPixel(100, 100) == sf::Color::Green);
+    REQUIRE(composite.getTileVersion(0, 500 / Canvas::TILE_SIZE, 500 / Canvas::TILE_SIZE) == version);
+
+    // Hidden and half transparent layers
+    layers.setVisible(2, false);
+    layers.setOpacity(1, 128);
+    layers.composite();
+    REQUIRE(composite.getPixel(100, 100) == sf::Color(128, 0, 127));
+    REQUIRE(composite.getPixel(104, 100) == sf::Color::Blue);
+    layers.setOpacity(1, 255);
+
+    // Erasing a layer shows the ones below it, and clearing it leaves them alone
+    Eraser(&layers.getLayer(1), 100, 100, 2, LayerStack::getEraseColor(1, sf::Color::White)).execute();
+    REQUIRE(layers.composite().getPixel(100, 100) == sf::Color::Blue);
+    ClearScreen(&layers.getLayer(1), sf::Color::Transparent, sf::Color::Yellow).execute();
+    REQUIRE(layers.composite().getPixel(300, 300) == sf::Color::Yellow);
+    REQUIRE(layers.getLayer(0).getPixel(100, 100) == sf::Color::Blue);
+    ClearScreen(&layers.getLayer(1), sf::Color::Yellow, sf::Color::Transparent).execute();
+    REQUIRE(layers.composite().getPixel(100, 100) == sf::Color::Blue);
+    REQUIRE(layers.composite().getTileCount() == 1);
+
+    // Each user draws on the layer they selected
+    layers.select("someone", 3);
+    layers.select("someone", LayerStack::LAYER_COUNT);
+    REQUIRE(layers.getSelected("someone") == 3);
+    REQUIRE(layers.getSelected("anyone") == 0);
+
+    App app(nullptr, nullptr, HEADLESS);
+    app.selectLayer(2);
+    REQUIRE(&app.getImage() == &app.getLayers().getLayer(2));
+    REQUIRE(app.getEraseColor() == sf::Color::Transparent);
+    app.destroy();
+}
+
+TEST_CASE("Brush dabs blend by opacity and mode, the same with every kernel") {
+    Canvas canvas;
+    canvas.create(200, 100, sf::Color::Transparent);
+
+    // Half opaque red over transparent is kept premultiplied
+    DrawBrush(&canvas, 20, 20, 5, sf::Color::Red, 128).execute();
+    REQUIRE(canvas.getPixel(20, 20) == sf::Color(128, 0, 0, 128));
+    REQUIRE(Blend::unpremultiply(canvas.getPixel(20, 20)) == sf::Color(255, 0, 0, 128));
+
+    // Painted again over itself it builds up
+    DrawBrush(&canvas, 20, 20, 5, sf::Color::Red, 128).execute();
+    REQUIRE(canvas.getPixel(20, 20) == sf::Color(192, 0, 0, 192));
+
+    // Erasing by alpha leaves it transparent
+    DrawBrush(&canvas, 20, 20, 5, sf::Color::Black, 255, BLEND_ERASE).execute();
+    REQUIRE(canvas.getPixel(20, 20) == sf::Color::Transparent);
+
+    // On opaque pixels, multiplying by white and screening by black change nothing
+    DrawBrush(&canvas, 60, 20, 5, sf::Color(200, 100, 50)).execute();
+    DrawBrush(&canvas, 60, 20, 5, sf::Color::White, 255, BLEND_MULTIPLY).execute();
+    DrawBrush(&canvas, 60, 20, 5, sf::Color::Black, 255, BLEND_SCREEN).execute();
+    REQUIRE(canvas.getPixel(60, 20) == sf::Color(200, 100, 50));
+    DrawBrush dab(&canvas, 60, 20, 5, sf::Color(128, 255, 0), 255, BLEND_MULTIPLY);
+    dab.execute();
+    REQUIRE(canvas.getPixel(60, 20) == sf::Color(100, 100, 0));
+    DrawBrush(&canvas, 60, 20, 5, sf::Color(0, 0, 255), 255, BLEND_SCREEN).execute();
+    REQUIRE(canvas.getPixel(60, 20) == sf::Color(100, 100, 255));
+
+    // Undo puts back exactly what was there
+    DrawBrush undone(&canvas, 60, 20, 5, sf::Color::Green, 100);
+    undone.execute();
+    undone.undo();
+    REQUIRE(canvas.getPixel(60, 20) == sf::Color(100, 100, 255));
+
+    // Every kernel the processor supports gives the same pixels, tails and uncovered pixels included
+    vector<sf::Color> start(67);
+    vector<sf::Uint8> coverage(67);
+    for (unsigned int i = 0; i < start.size(); i++) {
+        sf::Uint8 alpha = i * 37;
+        start[i] = sf::Color(alpha * (i % 3) / 2, alpha / (1 + i % 4), alpha, alpha);
+        coverage[i] = i % 5 == 0 ? 0 : i * 53;
+    }
+    BlendKernel best = Blend::getKernel();
+    for (int mode = BLEND_NORMAL; mode < BLEND_MODE_COUNT; mode++) {
+        vector<sf::Color> scalar = start, composited = start;
+        REQUIRE(Blend::setKernel(KERNEL_SCALAR));
+        Blend::colorSpan((BlendMode)mode, scalar.data(), coverage.data(), scalar.size(), sf::Color(90, 40, 10, 120));
+        Blend::pixelSpan(composited.data(), scalar.data(), composited.size(), 77);
+
+        for (BlendKernel kernel: {KERNEL_SSE41, KERNEL_AVX2}) {
+            if (Blend::setKernel(kernel)) {
+                vector<sf::Color> pixels = start, over = start;
+                Blend::colorSpan((BlendMode)mode, pixels.data(), coverage.data(), pixels.size(),
+                                 sf::Color(90, 40, 10, 120));
+                Blend::pixelSpan(over.data(), pixels.data(), over.size(), 77);
+                REQUIRE(pixels == scalar);
+                REQUIRE(over == composited);
+            }
+        }
+    }
+    Blend::setKernel(best);
+}
+
+TEST_CASE("Brush edges are anti-aliased and follow sub-pixel centres") {
+    Canvas canvas;
+    canvas.create(200, 100, sf::Color::White);
+
+    // Pixels near the edge are partly covered, the same all around, and ones outside are untouched
+    DrawBrush dab(&canvas, 50, 50, 5, sf::Color::Black);
+    dab.execute();
+    REQUIRE(canvas.getPixel(50, 50) == sf::Color::Black);
+    REQUIRE(canvas.getPixel(54, 50) == sf::Color::Black);
+    REQUIRE(canvas.getPixel(55, 50) == sf::Color::White);
+    REQUIRE(canvas.getPixel(53, 53).r > 0);
+    REQUIRE(canvas.getPixel(53, 53).r < 255);
+    REQUIRE(canvas.getPixel(47, 47) == canvas.getPixel(53, 53));
+    REQUIRE(canvas.getPixel(53, 47) == canvas.getPixel(47, 53));
+    REQUIRE(canvas.getPixel(47, 47) == canvas.getPixel(47, 53));
+
+    // Undo puts back the partly covered pixels too
+    dab.undo();
+    REQUIRE(canvas.getPixel(50, 50) == sf::Color::White);
+    REQUIRE(canvas.getPixel(53, 53) == sf::Color::White);
+
+    // Half a pixel to the right, the pixels half a pixel inside the edge on either side are half covered
+    DrawBrush(&canvas, 50, 50, 5, sf::Color::Black, 255, BLEND_NORMAL, DrawBrush::SUBPIXEL_STEPS / 2).execute();
+    REQUIRE(canvas.getPixel(55, 50).r > 100);
+    REQUIRE(canvas.getPixel(55, 50).r < 160);
+    REQUIRE(canvas.getPixel(46, 50) == canvas.getPixel(55, 50));
+    REQUIRE(canvas.getPixel(54, 50) == sf::Color::Black);
+    REQUIRE(canvas.getPixel(56, 50) == sf::Color::White);
+    REQUIRE(canvas.getPixel(45, 50) == sf::Color::White);
+
+    // A stroke along a shallow slope places the dabs in between at sub-pixel positions
+    BrushStroke stroke;
+    stroke.addAndExecuteCommand(new DrawBrush(&canvas, 100, 50, 3, sf::Color::Red));
+    stroke.addAndExecuteCommand(new DrawBrush(&canvas, 101, 50, 3, sf::Color::Red));
+    stroke.addAndExecuteCommand(new DrawBrush(&canvas, 140, 55, 3, sf::Color::Red));
+    deque<DrawBrush> draws = stroke.getDraws();
+    REQUIRE(any_of(draws.begin(), draws.end(), [](const DrawBrush &draw) { return draw.m_subY != 0; }));
+    REQUIRE(canvas.getPixel(120, 52) == sf::Color::Red);
+    REQUIRE(draws.back().m_posX == 140);
+    REQUIRE(draws.back().m_subX == 0);
+}
+
+// Counts the frames of the headless loop test, which closes the App after a few
+static int headlessFrames = 0;
+
+TEST_CASE("A headless App runs commands, undo and its loop without any window") {
+    App app([](App *app) {
+        if (++headlessFrames == 3) {
+            app->close();
+        }
+    }, [](App *app) {
+        app->updateTiles();
+    }, HEADLESS);
+    REQUIRE(app.isHeadless());
+
+    app.mouseX = 10;
+    app.mouseY = 10;
+    app.brushRadius = 3;
+    app.addCommand(new DrawBrush(&app));
+    REQUIRE(app.getImage().getPixel(10, 10) == sf::Color::Black);
+    app.undoCommand();
+    REQUIRE(app.getImage().getPixel(10, 10) == sf::Color::White);
+    app.redoCommand();
+    REQUIRE(app.getImage().getPixel(10, 10) == sf::Color::Black);
+
+    // The loop calls the update and draw functions until closed, compositing but uploading nothing
+    app.loop();
+    REQUIRE(headlessFrames == 3);
+    REQUIRE(app.getLayers().composite().getPixel(10, 10) == sf::Color::Black);
+    REQUIRE(app.getTileTextureCount() == 0);
+
+    sf::Event event;
+    REQUIRE(app.pollEvent(event) == false);
+    REQUIRE(app.getMousePosition() == sf::Vector2i(-1, -1));
+    app.destroy();
+}
+
+static int deferredFrames = 0;
+
+TEST_CASE("A headless App waits while its draw function defers the frame") {
+    static sf::Clock running;
+    running.restart();
+    App app([](App *app) {
+        deferredFrames++;
+        app->invalidateCanvas();
+        if (running.getElapsedTime() >= sf::milliseconds(200)) {
+            app->close();
+        }
+    }, [](App *app) {
+        // Always too soon, like draw in main.cpp within a frame of the last upload
+        app->invalidateCanvas();
+    }, HEADLESS);
+
+    app.loop();
+    // Waiting IDLE_WAIT_MS each time, not spinning
+    REQUIRE(deferredFrames <= 200 / (int)App::IDLE_WAIT_MS + 2);
+    app.destroy();
+}
+
+static int quietFrames = 0, quietDraws = 0;
+
+TEST_CASE("A headless App does not draw again for messages that leave the canvas as it is") {
+    App app([](App *app) {
+        // Acknowledgements and layer changes arrive every frame, a brush only on the third
+        sf::Uint8 header = ACK;
+        sf::Packet ack, layer;
+        ack << header << string("other") << (sf::Uint32)quietFrames;
+        app->applyCommand(ack);
+        header = LAYER;
+        layer << header << string("other") << (sf::Uint8)1;
+        app->applyCommand(layer);
+        if (++quietFrames == 3) {
+            sf::Packet dab;
+            sf::Uint8 radius = 2, opacity = 255, mode = BLEND_NORMAL;
+            header = DRAWBRUSH;
+            dab << header << string("other") << 10 << 10;
+            app->getPalette("other").write(dab, sf::Color::Red);
+            dab << radius << opacity << mode;
+            app->applyCommand(dab);
+        } else if (quietFrames == 6) {
+            app->close();
+        }
+    }, [](App *) {
+        quietDraws++;
+    }, HEADLESS);
+
+    app.loop();
+    // The first frame and the one with the brush
+    REQUIRE(quietDraws == 2);
+    app.destroy();
+}
+
+TEST_CASE("A recorded session replays to the same canvas") {
+    const string path = "test_session.trace";
+    sf::Uint8 header = DRAWBRUSH, start = START_BRUSHSTROKE, end = END_BRUSHSTROKE, radius = 4, opacity = 255,
+            mode = BLEND_NORMAL;
+    Palette local, remote;
+
+    App app(nullptr, nullptr, HEADLESS);
+    sf::Uint64 blank = app.getLayers().composite().getHash();
+    {
+        SessionRecorder recorder(path);
+        REQUIRE(recorder.isOpen());
+        app.setRecorder(&recorder);
+
+        // A stroke of our own, drawn as it is sent
+        sf::Packet startPacket, endPacket;
+        startPacket << start << string("me");
+        app.sendCommand(startPacket);
+        app.applyCommand(startPacket);
+        for (int x = 20; x <= 60; x += 20) {
+            sf::Packet dab;
+            dab << header << string("me") << (sf::Int32)x << (sf::Int32)30;
+            local.write(dab, sf::Color::Red);
+            dab << radius << opacity << mode;
+            app.sendCommand(dab);
+            app.applyCommand(dab);
+        }
+        endPacket << end << string("me");
+        app.sendCommand(endPacket);
+        app.applyCommand(endPacket);
+
+        // And a dab from someone else, as if the server sent it
+        sf::Packet dab;
+        dab << header << string("them") << (sf::Int32)40 << (sf::Int32)80;
+        remote.write(dab, sf::Color::Blue);
+        dab << radius << opacity << mode;
+        recorder.record(TRACE_RECEIVED, dab);
+        app.applyCommand(dab);
+        app.setRecorder(nullptr);
+    }
+    sf::Uint64 drawn = app.getLayers().composite().getHash();
+    REQUIRE(drawn != blank);
+    app.destroy();
+
+    vector<TraceEntry> entries;
+    REQUIRE(SessionRecorder::load(path, entries));
+    REQUIRE(entries.size() == 6);
+    REQUIRE(entries.front().kind == TRACE_LOCAL);
+    REQUIRE(entries.back().kind == TRACE_RECEIVED);
+    for (unsigned int i = 1; i < entries.size(); i++) {
+        REQUIRE(entries[i].time >= entries[i - 1].time);
+    }
+
+    // Replaying into a fresh App draws exactly the same pixels
+    App replay(nullptr, nullptr, HEADLESS);
+    for (TraceEntry &entry: entries) {
+        replay.applyCommand(entry.packet);
+    }
+    REQUIRE(replay.getLayers().composite().getHash() == drawn);
+    REQUIRE(replay.getLayers().composite().getPixel(40, 80) == sf::Color::Blue);
+    replay.destroy();
+
+    // Anything that is not a trace is refused
+    ofstream(path, ios::binary) << "not a trace";
+    entries.clear();
+    REQUIRE(SessionRecorder::load(path, entries) == false);
+    REQUIRE(entries.empty());
+    remove(path.c_str());
+}
+
+TEST_CASE("Canvas hashes depend on the pixels, not on which tiles are stored") {
+    Canvas a, b;
+    a.create(100, 100, sf::Color::White);
+    b.create(100, 100, sf::Color::White);
+    REQUIRE(a.getHash() == b.getHash());
+
+    // Painting the background over a blank tile stores it without changing what it shows
+    b.setPixel(70, 70, sf::Color::White);
+    REQUIRE(a.getHash() == b.getHash());
+
+    a.setPixel(70, 70, sf::Color::Red);
+    REQUIRE(a.getHash() != b.getHash());
+
+    Canvas smaller;
+    smaller.create(100, 50, sf::Color::White);
+    REQUIRE(smaller.getHash() != b.getHash());
+}
+
+TEST_CASE("The profiler keeps the last frames of each stage") {
+    Profiler profiler;
+    REQUIRE(profiler.getAverage(PROFILE_FRAME) == 0);
+    REQUIRE(profiler.getHistory(PROFILE_FRAME).empty());
+
+    // Frames of 1 to 200 microseconds, only the last HISTORY_FRAMES are kept
+    for (sf::Int64 time = 1; time <= 200; time++) {
+        profiler.add(PROFILE_FRAME, time);
+        profiler.add(PROFILE_UPLOAD_BYTES, 10);
+        profiler.add(PROFILE_UPLOAD_BYTES, 6);
+        profiler.set(PROFILE_INBOX, time % 3);
+        profiler.endFrame();
+    }
+    REQUIRE(profiler.getFrames() == 200);
+    vector<sf::Int64> history = profiler.getHistory(PROFILE_FRAME);
+    REQUIRE(history.size() == Profiler::HISTORY_FRAMES);
+    REQUIRE(history.front() == 200 - Profiler::HISTORY_FRAMES + 1);
+    REQUIRE(history.back() == 200);
+    REQUIRE(is_sorted(history.begin(), history.end()));
+
+    REQUIRE(profiler.getAverage(PROFILE_FRAME) == (200 + 200 - Profiler::HISTORY_FRAMES + 1) / 2);
+    REQUIRE(profiler.getPercentile(PROFILE_FRAME, 1) == 200);
+    REQUIRE(profiler.getPercentile(PROFILE_FRAME, 0.5) == 200 - Profiler::HISTORY_FRAMES / 2);
+    REQUIRE(profiler.getLast(PROFILE_INBOX) == 200 % 3);
+    REQUIRE(profiler.getHistory(PROFILE_UPLOAD_BYTES).back() == 16);
+
+    // 73 to 127 have 7 bits, 128 to 200 have 8
+    vector<unsigned long> histogram = profiler.getHistogram(PROFILE_FRAME);
+    REQUIRE(histogram.size() == 9);
+    REQUIRE(histogram[7] == 127 - 73 + 1);
+    REQUIRE(histogram[8] == 200 - 128 + 1);
+    REQUIRE(profiler.getAverage(PROFILE_DISPLAY) == 0);
+}
+
+TEST_CASE("Profile scopes time a stage once however deeply they nest") {
+    Profiler profiler;
+    {
+        ProfileScope outer(&profiler, PROFILE_COMMANDS);
+        sf::sleep(sf::milliseconds(5));
+        ProfileScope inner(&profiler, PROFILE_COMMANDS);
+        sf::sleep(sf::milliseconds(5));
+    }
+    {
+        // Without a profiler nothing is timed
+        ProfileScope nothing(nullptr, PROFILE_COMMANDS);
+    }
+    profiler.endFrame();
+    sf::Int64 time = profiler.getHistory(PROFILE_COMMANDS).back();
+    REQUIRE(time >= 10000);
+    REQUIRE(time < 20000);
+}
+
+TEST_CASE("A headless App profiles its frames and commands") {
+    App app([](App *app) {
+        // Draws on the first frame, closes on the third
+        if (app->getProfiler().getFrames() == 0) {
+            app->mouseX = 30;
+            app->mouseY = 30;
+            app->brushRadius = 60;
+            app->addCommand(new DrawBrush(app));
+        } else if (app->getProfiler().getFrames() == 2) {
+            app->close();
+        }
+    }, [](App *app) {
+        app->updateTiles();
+    }, HEADLESS);
+    app.loop();
+
+    Profiler &profiler = app.getProfiler();
+    REQUIRE(profiler.getFrames() == 3);
+    vector<sf::Int64> commands = profiler.getHistory(PROFILE_COMMANDS);
+    vector<sf::Int64> frames = profiler.getHistory(PROFILE_FRAME);
+    REQUIRE(commands[0] > 0);
+    REQUIRE(commands[0] <= frames[0]);
+    REQUIRE(commands[1] == 0);
+    // Headless, nothing is uploaded
+    REQUIRE(profiler.getHistory(PROFILE_UPLOAD_BYTES)[0] == 0);
+    app.destroy();
+}
+
+TEST_CASE("Trace events follow a message from its sender to where it is applied") {
+    const string path = "test_events.json";
+    REQUIRE(EventTrace::start(path, "Client \"A\""));
+    REQUIRE(EventTrace::isEnabled());
+
+    App sender(nullptr, nullptr, HEADLESS), receiver(nullptr, nullptr, HEADLESS);
+    sf::Uint8 header = CLEARSCREEN;
+    for (int i = 0; i < 2; i++) {
+        sf::Packet clear;
+        clear << header << string("");
+        sender.getPalette("").write(clear, sf::Color::Red);
+        sender.sendCommand(clear);
+        receiver.applyCommand(clear);
+    }
+    {
+        TraceSpan span("outside", "test");
+    }
+    EventTrace::stop();
+    REQUIRE(!EventTrace::isEnabled());
+    {
+        // Spans after the trace stopped are left out
+        TraceSpan span("after", "test");
+    }
+    sender.destroy();
+    receiver.destroy();
+
+    ifstream file(path);
+    string line, sent, applied;
+    vector<string> lines;
+    getline(file, line);
+    REQUIRE(line == "[");
+    while (getline(file, line)) {
+        REQUIRE(line.front() == '{');
+        REQUIRE(line.substr(line.size() - 2) == "},");
+        lines.push_back(line);
+    }
+    REQUIRE(lines.front().find(R"("name":"Client \"A\"")") != string::npos);
+
+    auto count = [&lines](const string &text) {
+        return count_if(lines.begin(), lines.end(), [&text](const string &line) {
+            return line.find(text) != string::npos;
+        });
+    };
+    REQUIRE(count(R"("name":"send","cat":"network","ph":"X")") == 2);
+    REQUIRE(count(R"("name":"apply","cat":"command","ph":"X")") == 2);
+    REQUIRE(count(R"("name":"outside")") == 1);
+    REQUIRE(count(R"("name":"after")") == 0);
+
+    // Each message's flow starts when it is sent and finishes where it is applied, with the same id
+    REQUIRE(count(R"("ph":"s")") == 2);
+    REQUIRE(count(R"("ph":"f")") == 2);
+    for (const string &line: lines) {
+        size_t id = line.find(R"("id":")");
+        if (id == string::npos) {
+            continue;
+        }
+        string flow = line.substr(id, 26);
+        REQUIRE(count(flow) == 2);
+    }
+    file.close();
+    remove(path.c_str());
+}
+
+TEST_CASE("Allocation probes count the calling thread's allocations") {
+    REQUIRE(AllocationCounter::isEnabled());
+
+    AllocationProbe probe;
+    int *number = new int(5);
+    REQUIRE(probe.getAllocations() == 1);
+    REQUIRE(probe.getBytes() == sizeof(int));
+    delete number;
+    REQUIRE(probe.getDeallocations() == 1);
+
+    // Another thread's allocations are its own
+    probe.reset();
+    thread other([]() {
+        for (int i = 0; i < 100; i++) {
+            delete new int(i);
+        }
+    });
+    other.join();
+    REQUIRE(probe.getAllocations() < 100);
+}
+
+TEST_CASE("Compositing a tile again does not allocate") {
+    LayerStack layers;
+    layers.create(App::WINDOW_WIDTH, App::WINDOW_HEIGHT, sf::Color::White);
+    DrawBrush dab(&layers.getLayer(1), 100, 100, 5, sf::Color::Red);
+    dab.execute();
+    layers.composite();
+
+    // The blended tile, the blank bottom layer's coverage and the list of changed tiles are reused
+    dab.execute();
+    AllocationProbe probe;
+    layers.composite();
+    REQUIRE(probe.getAllocations() == 0);
+    REQUIRE(layers.composite().getPixel(100, 100) == sf::Color::Red);
+}
+
+TEST_CASE("Drawing with a warmed up brush does not allocate") {
+    Canvas canvas;
+    canvas.create(200, 200, sf::Color::White);
+
+    // The first dab stores the tiles it touches and works out its mask, after that it only blends
+    DrawBrush dab(&canvas, 50, 50, 8, sf::Color::Red);
+    dab.execute();
+    AllocationProbe probe;
+    dab.execute();
+    REQUIRE(probe.getAllocations() == 0);
+
+    // A dab keeps its description and what was under it, one block each
+    probe.reset();
+    DrawBrush another(&canvas, 60, 50, 8, sf::Color::Red);
+    REQUIRE(probe.getAllocations() == 2);
+
+    BrushStroke stroke;
+    for (int x = 20; x < 100; x += 10) {
+        DrawBrush sample(&canvas, x, 100, 8, sf::Color::Blue);
+        stroke.addAndExecuteCommand(&sample);
+    }
+
+    // Undoing and redoing a whole stroke works on the dabs it has
+    probe.reset();
+    stroke.undo();
+    REQUIRE(probe.getAllocations() == 0);
+    stroke.execute();
+    REQUIRE(probe.getAllocations() == 0);
+
+    // Each dab interpolated up to a new sample is made in place, the deque adding a block now and then
+    DrawBrush sample(&canvas, 150, 100, 8, sf::Color::Blue);
+    unsigned long before = stroke.getDraws().size();
+    probe.reset();
+    stroke.addAndExecuteCommand(&sample);
+    unsigned long added = stroke.getDraws().size() - before;
+    REQUIRE(added > 40);
+    REQUIRE(probe.getAllocations() <= 3 * added);
+}
+
+// Runs a server on a port for the rest of a test, waiting up to the timeout for it to listen. It is stopped
+// and deleted when the test ends, also when an assertion fails part way through.
+class TestServer {
+private:
+    TCPServer *m_server;
+    thread m_thread;
+
+public:
+    explicit TestServer(unsigned short port, TCPServer *server = new TCPServer(),
+                        sf::Time timeout = sf::seconds(5)) : m_server(server) {
+        m_thread = thread([server, port]() {
+            server->connectServer("SERVER", sf::IpAddress::getLocalAddress(), port);
+        });
+        sf::Clock waiting;
+        while (!m_server->m_start && waiting.getElapsedTime() < timeout) {
+            sf::sleep(sf::milliseconds(1));
+        }
+    }
+
+    ~TestServer() {
+        // The server's loop stops it once it sees m_start cleared
+        m_server->m_start = false;
+        m_thread.join();
+        delete m_server;
+    }
+
+    TCPServer *operator->() {
+        return m_server;
+    }
+
+    bool isRunning() const {
+        return m_server->m_start;
+    }
+};
+
+TEST_CASE("The server counts its traffic and answers a local admin with it") {
+    TCPServer *counting = new TCPServer();
+    string path = "stats_test.txt";
+    remove(path.c_str());
+    REQUIRE(counting->setStatsFile(path, sf::milliseconds(20)));
+    TestServer server(8005, counting);
+    REQUIRE(server.isRunning());
+
+    TCPClient clientA("clientA", 8005);
+    TCPClient clientB("clientB", 8005);
+    clientA.joinServer(sf::IpAddress::getLocalAddress(), 8005);
+    clientB.joinServer(sf::IpAddress::getLocalAddress(), 8005);
+
+    while (server->getClients() != 2) {
+        // Await clientA & clientB join
+    }
+
+    sf::Packet packet;
+    sf::Uint8 header = UNDO;
+    packet << header << string("clientA");
+    clientA.sendCommand(packet);
+    REQUIRE(clientB.waitForData(sf::seconds(5)) == true);
+    REQUIRE(clientB.receiveData().getDataSize() > 0);
+
+    // The admin's own connection is the third accepted
+    string stats;
+    REQUIRE(TCPServer::queryStats(sf::IpAddress::LocalHost, 8005, stats));
+    REQUIRE(stats.rfind("collabpaint_server,server=SERVER clients=2i,accepts=3i,disconnects=0i", 0) == 0);
+    REQUIRE(stats.find("broadcasts=1i") != string::npos);
+    REQUIRE(stats.find("history=1i") != string::npos);
+    REQUIRE(stats.find("collabpaint_client,server=SERVER,user=clientA messages_in=2i") != string::npos);
+    REQUIRE(stats.find("collabpaint_client,server=SERVER,user=clientB messages_in=1i") != string::npos);
+    REQUIRE(stats.find("send_failures=0i") != string::npos);
+
+    // Nobody listens on the next port
+    REQUIRE_FALSE(TCPServer::queryStats(sf::IpAddress::LocalHost, 8006, stats));
+
+    // The stats file gets a snapshot every interval
+    sf::sleep(sf::milliseconds(500));
+    ifstream file(path);
+    string line;
+    int servers = 0;
+    while (getline(file, line)) {
+        if (line.rfind("collabpaint_server,", 0) == 0) {
+            servers++;
+        }
+    }
+    REQUIRE(servers >= 2);
+    file.close();
+    remove(path.c_str());
+}
+
+TEST_CASE("A flood fill stops at other colours and undoes span by span") {
+    Canvas canvas;
+    canvas.create(200, 200, sf::Color::White);
+    // A black square outline from 50 to 100, with a gap in neither side
+    for (unsigned int i = 50; i <= 100; i++) {
+        canvas.setPixel(i, 50, sf::Color::Black);
+        canvas.setPixel(i, 100, sf::Color::Black);
+        canvas.setPixel(50, i, sf::Color::Black);
+        canvas.setPixel(100, i, sf::Color::Black);
+    }
+    sf::Uint64 before = canvas.getHash();
+
+    FloodFill inside(&canvas, 75, 75, sf::Color::Red);
+    REQUIRE(inside.execute());
+    REQUIRE(canvas.getPixel(51, 51) == sf::Color::Red);
+    REQUIRE(canvas.getPixel(99, 99) == sf::Color::Red);
+    REQUIRE(canvas.getPixel(50, 75) == sf::Color::Black);
+    REQUIRE(canvas.getPixel(49, 75) == sf::Color::White);
+    REQUIRE(canvas.getPixel(150, 150) == sf::Color::White);
+    // One span for each row inside, all of it white before
+    REQUIRE(inside.getSpans().size() == 49);
+    for (const FillSpan &span: inside.getSpans()) {
+        REQUIRE(span.x == 51);
+        REQUIRE(span.length == 49);
+        REQUIRE(span.color == sf::Color::White);
+    }
+
+    // Outside goes around the square, across blank tiles
+    FloodFill outside(&canvas, 0, 0, sf::Color::Blue);
+    REQUIRE(outside.execute());
+    REQUIRE(canvas.getPixel(199, 199) == sf::Color::Blue);
+    REQUIRE(canvas.getPixel(75, 75) == sf::Color::Red);
+    REQUIRE(canvas.getPixel(50, 50) == sf::Color::Black);
+
+    outside.undo();
+    inside.undo();
+    REQUIRE(canvas.getHash() == before);
+
+    // Filling with the same colour changes nothing, and a seed off the canvas does nothing
+    FloodFill same(&canvas, 75, 75, sf::Color::White);
+    REQUIRE(same.execute());
+    REQUIRE(same.getSpans().empty());
+    REQUIRE_FALSE(FloodFill(&canvas, 200, 0, sf::Color::Red).execute());
+}
+
+TEST_CASE("A flood fill spreads to colours within its tolerance") {
+    Canvas canvas;
+    canvas.create(100, 10, sf::Color::White);
+    // Columns getting darker by 10 from the left
+    for (unsigned int x = 0; x < 100; x++) {
+        sf::Uint8 shade = 255 - (x / 10) * 10;
+        for (unsigned int y = 0; y < 10; y++) {
+            canvas.setPixel(x, y, sf::Color(shade, shade, shade));
+        }
+    }
+
+    FloodFill near(&canvas, 0, 5, sf::Color::Red, 25);
+    near.execute();
+    REQUIRE(canvas.getPixel(29, 9) == sf::Color::Red);
+    REQUIRE(canvas.getPixel(30, 0) == sf::Color(225, 225, 225));
+    // A run for each shade of each row
+    REQUIRE(near.getSpans().size() == 3 * 10);
+    near.undo();
+    REQUIRE(canvas.getPixel(29, 9) == sf::Color(235, 235, 235));
+
+    // A fill colour within the tolerance would still match once painted, and does not loop
+    FloodFill similar(&canvas, 0, 0, sf::Color(250, 250, 250), 25);
+    similar.execute();
+    REQUIRE(canvas.getPixel(29, 0) == sf::Color(250, 250, 250));
+    REQUIRE(canvas.getPixel(30, 0) == sf::Color(225, 225, 225));
+}
+
+TEST_CASE("A received fill is worked out from its seed and undone as one command") {
+    App app(nullptr, nullptr, HEADLESS);
+    sf::Uint64 blank = app.getImage().getHash();
+
+    sf::Packet fill;
+    sf::Uint8 header = FLOODFILL, tolerance = 0;
+    fill << header << string("other") << 10u << 10u;
+    app.getPalette("other").write(fill, sf::Color::Green);
+    fill << tolerance;
+    // Seed, colour and tolerance, whatever the size of the area
+    REQUIRE(fill.getDataSize() < 32);
+    app.applyCommand(fill);
+    REQUIRE(app.getImage().getPixel(0, 0) == sf::Color::Green);
+    REQUIRE(app.getImage().getPixel(App::WINDOW_WIDTH - 1, App::WINDOW_HEIGHT - 1) == sf::Color::Green);
+
+    app.undoCommand();
+    REQUIRE(app.getImage().getHash() == blank);
+    app.destroy();
+}
+
+TEST_CASE("A fill reaches the other clients through the server whole") {
+    TestServer server(8007);
+    REQUIRE(server.isRunning());
+
+    TCPClient clientA("clientA", 8007);
+    TCPClient clientB("clientB", 8007);
+    clientA.joinServer(sf::IpAddress::getLocalAddress(), 8007);
+    clientB.joinServer(sf::IpAddress::getLocalAddress(), 8007);
+
+    while (server->getClients() != 2) {
+        // Await clientA & clientB join
+    }
+
+    // The first fill defines a colour in clientA's palette, the second uses the entry
+    Palette palette;
+    sf::Color orange(255, 128, 0);
+    sf::Uint8 header = FLOODFILL, tolerance = 3;
+    sf::Packet first, second;
+    first << header << string("clientA") << 10u << 10u;
+    palette.write(first, orange);
+    first << tolerance;
+    second << header << string("clientA") << 10u << 10u;
+    palette.write(second, sf::Color::Blue);
+    second << tolerance;
+    clientA.sendCommand(first);
+    clientA.sendCommand(second);
+
+    App app(nullptr, nullptr, HEADLESS);
+    for (const sf::Packet &sent: {first, second}) {
+        REQUIRE(clientB.waitForData(sf::seconds(5)) == true);
+        sf::Packet received = clientB.receiveData();
+        REQUIRE(received.getDataSize() == sent.getDataSize());
+        REQUIRE(memcmp(received.getData(), sent.getData(), sent.getDataSize()) == 0);
+        app.applyCommand(received);
+    }
+    REQUIRE(app.getImage().getPixel(App::WINDOW_WIDTH - 1, App::WINDOW_HEIGHT - 1) == sf::Color::Blue);
+    app.undoCommand();
+    REQUIRE(app.getImage().getPixel(0, 0) == orange);
+    app.destroy();
+}
+
+TEST_CASE("Rectangles cover their outline or their whole area in spans") {
+    Canvas canvas;
+    canvas.create(100, 100, sf::Color::White);
+    sf::Uint64 blank = canvas.getHash();
+
+    // Corners given in any order
+    Rect outline(&canvas, 20, 15, 10, 10, 2, sf::Color::Black);
+    REQUIRE(outline.execute());
+    REQUIRE(canvas.getPixel(10, 10) == sf::Color::Black);
+    REQUIRE(canvas.getPixel(20, 15) == sf::Color::Black);
+    REQUIRE(canvas.getPixel(11, 12) == sf::Color::Black);
+    REQUIRE(canvas.getPixel(12, 12) == sf::Color::White);
+    REQUIRE(canvas.getPixel(18, 13) == sf::Color::White);
+    REQUIRE(canvas.getPixel(21, 12) == sf::Color::White);
+    // Two whole rows at the top and bottom, two sides in between
+    REQUIRE(outline.getSpans().size() == 2 + 2 * 2 + 2);
+    outline.undo();
+    REQUIRE(canvas.getHash() == blank);
+
+    // Filled and reaching past the canvas, clipped
+    Rect filled(&canvas, 90, 90, 200, 200, 1, sf::Color::Red, 255, BLEND_NORMAL, true);
+    filled.execute();
+    REQUIRE(filled.getSpans().size() == 10);
+    for (const ShapeSpan &span: filled.getSpans()) {
+        REQUIRE(span.x == 90);
+        REQUIRE(span.length == 10);
+    }
+    REQUIRE(canvas.getPixel(99, 99) == sf::Color::Red);
+    filled.undo();
+    REQUIRE(canvas.getHash() == blank);
+}
+
+TEST_CASE("Ellipses are symmetric and their outline leaves the inside alone") {
+    Canvas canvas;
+    canvas.create(100, 100, sf::Color::White);
+
+    Ellipse filled(&canvas, 10, 20, 49, 39, 1, sf::Color::Blue, 255, BLEND_NORMAL, true);
+    filled.execute();
+    // Touches the middle of each side of its box, not the corners
+    REQUIRE(canvas.getPixel(10, 29) == sf::Color::Blue);
+    REQUIRE(canvas.getPixel(49, 30) == sf::Color::Blue);
+    REQUIRE(canvas.getPixel(29, 20) == sf::Color::Blue);
+    REQUIRE(canvas.getPixel(30, 39) == sf::Color::Blue);
+    REQUIRE(canvas.getPixel(10, 20) == sf::Color::White);
+    REQUIRE(canvas.getPixel(49, 39) == sf::Color::White);
+    // A row each, mirrored left to right and top to bottom
+    const vector<ShapeSpan> &spans = filled.getSpans();
+    REQUIRE(spans.size() == 20);
+    for (unsigned int i = 0; i < spans.size(); i++) {
+        REQUIRE(spans[i].x - 10 == 49 - (spans[i].x + spans[i].length - 1));
+        REQUIRE(spans[i].x == spans[spans.size() - 1 - i].x);
+    }
+    filled.undo();
+
+    Ellipse outline(&canvas, 10, 20, 49, 39, 3, sf::Color::Blue);
+    outline.execute();
+    REQUIRE(canvas.getPixel(10, 29) == sf::Color::Blue);
+    REQUIRE(canvas.getPixel(12, 29) == sf::Color::Blue);
+    REQUIRE(canvas.getPixel(13, 29) == sf::Color::White);
+    REQUIRE(canvas.getPixel(29, 29) == sf::Color::White);
+}
+
+TEST_CASE("Lines are a square of their thickness stepped from end to end") {
+    Canvas canvas;
+    canvas.create(100, 100, sf::Color::White);
+
+    Line flat(&canvas, 5, 50, 94, 50, 3, sf::Color::Black);
+    flat.execute();
+    REQUIRE(flat.getSpans().size() == 3);
+    for (const ShapeSpan &span: flat.getSpans()) {
+        REQUIRE(span.x == 4);
+        REQUIRE(span.length == 92);
+    }
+    flat.undo();
+
+    // One pixel a row along a diagonal, at half opacity
+    Line diagonal(&canvas, 0, 0, 99, 99, 1, sf::Color::Black, 128);
+    diagonal.execute();
+    REQUIRE(diagonal.getSpans().size() == 100);
+    REQUIRE(canvas.getPixel(42, 42) != sf::Color::White);
+    REQUIRE(canvas.getPixel(42, 42) != sf::Color::Black);
+    REQUIRE(canvas.getPixel(43, 42) == sf::Color::White);
+
+    // A dot in the corner is clipped to the canvas
+    Line dot(&canvas, 0, 99, 0, 99, 5, sf::Color::Red);
+    dot.execute();
+    REQUIRE(dot.getSpans().size() == 3);
+    REQUIRE(dot.getSpans()[0].length == 3);
+    REQUIRE(canvas.getPixel(2, 97) == sf::Color::Red);
+}
+
+TEST_CASE("A received shape is one small message and one undo") {
+    App app(nullptr, nullptr, HEADLESS);
+    sf::Uint64 blank = app.getImage().getHash();
+
+    sf::Packet rect;
+    sf::Uint8 header = RECT, thickness = 4, opacity = 255, mode = BLEND_NORMAL, filled = 1;
+    rect << header << string("other") << 100u << 100u << 700u << 700u;
+    app.getPalette("other").write(rect, sf::Color::Green);
+    rect << thickness << opacity << mode << filled;
+    REQUIRE(rect.getDataSize() < 40);
+    app.applyCommand(rect);
+    REQUIRE(app.getImage().getPixel(400, 400) == sf::Color::Green);
+    REQUIRE(app.getImage().getPixel(99, 400) == sf::Color::White);
+
+    app.undoCommand();
+    REQUIRE(app.getImage().getHash() == blank);
+    app.redoCommand();
+    REQUIRE(app.getImage().getPixel(700, 700) == sf::Color::Green);
+    app.destroy();
+}
+
+TEST_CASE("Shapes reach the other clients through the server whole") {
+    TestServer server(8008);
+    REQUIRE(server.isRunning());
+
+    TCPClient clientA("clientA", 8008);
+    TCPClient clientB("clientB", 8008);
+    clientA.joinServer(sf::IpAddress::getLocalAddress(), 8008);
+    clientB.joinServer(sf::IpAddress::getLocalAddress(), 8008);
+
+    while (server->getClients() != 2) {
+        // Await clientA & clientB join
+    }
+
+    // A filled rectangle in a colour clientA's palette defines, then an ellipse and a line using the entry
+    Palette palette;
+    sf::Color orange(255, 128, 0);
+    sf::Uint8 thickness = 2, opacity = 255, mode = BLEND_NORMAL;
+    vector<sf::Packet> sent(3);
+    sf::Uint8 headers[] = {RECT, ELLIPSE, LINE};
+    unsigned int corners[][4] = {{100, 100, 300, 300}, {400, 400, 600, 500}, {10, 700, 700, 700}};
+    for (unsigned int i = 0; i < 3; i++) {
+        sent[i] << headers[i] << string("clientA") << corners[i][0] << corners[i][1] << corners[i][2]
+                << corners[i][3];
+        palette.write(sent[i], orange);
+        sent[i] << thickness << opacity << mode << (sf::Uint8)(i == 0);
+        clientA.sendCommand(sent[i]);
+    }
+
+    App app(nullptr, nullptr, HEADLESS);
+    for (const sf::Packet &packet: sent) {
+        REQUIRE(clientB.waitForData(sf::seconds(5)) == true);
+        sf::Packet received = clientB.receiveData();
+        REQUIRE(received.getDataSize() == packet.getDataSize());
+        REQUIRE(memcmp(received.getData(), packet.getData(), packet.getDataSize()) == 0);
+        app.applyCommand(received);
+    }
+    REQUIRE(app.getImage().getPixel(200, 200) == orange);
+    REQUIRE(app.getImage().getPixel(400, 450) == orange);
+    REQUIRE(app.getImage().getPixel(500, 450) == sf::Color::White);
+    REQUIRE(app.getImage().getPixel(350, 700) == orange);
+    app.destroy();
+}
+
+TEST_CASE("Moving a selection copies its rows and undo puts back only what it covered") {
+    Canvas canvas;
+    canvas.create(300, 200, sf::Color::White);
+    for (unsigned int y = 10; y < 60; y++) {
+        for (unsigned int x = 10; x < 90; x++) {
+            canvas.setPixel(x, y, sf::Color(x, y, 7));
+        }
+    }
+    canvas.setPixel(50, 50, sf::Color::Red);
+    sf::Uint64 before = canvas.getHash();
+
+    SECTION("A move overlapping its source") {
+        Selection move(&canvas, 10, 10, 80, 50, 25, 13, true, sf::Color::White);
+        REQUIRE(move.execute());
+        REQUIRE(canvas.getPixel(75, 63) == sf::Color::Red);
+        REQUIRE(canvas.getPixel(10 + 25, 10 + 13) == sf::Color(10, 10, 7));
+        // Left behind where nothing landed
+        REQUIRE(canvas.getPixel(10, 10) == sf::Color::White);
+        REQUIRE(canvas.getPixel(34, 59) == sf::Color::White);
+        move.undo();
+        REQUIRE(canvas.getHash() == before);
+        move.execute();
+        REQUIRE(canvas.getPixel(75, 63) == sf::Color::Red);
+    }
+
+    SECTION("A copy leaves its source") {
+        Selection copy(&canvas, 10, 10, 80, 50, -15, 100, false, sf::Color::White);
+        REQUIRE(copy.execute());
+        REQUIRE(canvas.getPixel(35, 150) == sf::Color::Red);
+        REQUIRE(canvas.getPixel(50, 50) == sf::Color::Red);
+        // The columns that would land left of the canvas are not copied, the first one landing is x 15
+        REQUIRE(canvas.getPixel(0, 110) == sf::Color(15, 10, 7));
+        copy.undo();
+        REQUIRE(canvas.getHash() == before);
+    }
+
+    SECTION("Nothing lands on the canvas") {
+        Selection away(&canvas, 10, 10, 80, 50, 400, 0, true, sf::Color::White);
+        REQUIRE_FALSE(away.execute());
+        REQUIRE(canvas.getHash() == before);
+    }
+}
+
+TEST_CASE("A selection lined up with the tiles moves whole tiles and keeps blank ones blank") {
+    unsigned int const tile = Canvas::TILE_SIZE;
+    Canvas canvas;
+    canvas.create(8 * tile, 4 * tile, sf::Color::White);
+    canvas.setPixel(tile + 3, 5, sf::Color::Blue);
+    sf::Uint64 before = canvas.getHash();
+    REQUIRE(canvas.getTileCount() == 1);
+
+    // Two tiles wide with the blue one on the right, moved over by one tile onto itself
+    Selection move(&canvas, 0, 0, 2 * tile, 2 * tile, tile, 0, true, sf::Color::White);
+    REQUIRE(move.execute());
+    REQUIRE(canvas.getPixel(2 * tile + 3, 5) == sf::Color::Blue);
+    REQUIRE(canvas.getPixel(tile + 3, 5) == sf::Color::White);
+    REQUIRE(canvas.getTileCount() == 1);
+
+    move.undo();
+    REQUIRE(canvas.getHash() == before);
+    REQUIRE(canvas.getPixel(tile + 3, 5) == sf::Color::Blue);
+
+    // Copying blank pixels over blank tiles does not allocate them
+    Selection blank(&canvas, 4 * tile + 5, tile, 50, 50, 17, 9, false, sf::Color::White);
+    blank.execute();
+    REQUIRE(canvas.getTileCount() == 1);
+}
+
+TEST_CASE("A received selection is the rectangle and offset and one undo") {
+    App app(nullptr, nullptr, HEADLESS);
+    app.getImage().setPixel(120, 130, sf::Color::Green);
+    sf::Uint64 before = app.getImage().getHash();
+
+    sf::Packet selection;
+    sf::Uint8 header = SELECTION, move = 1;
+    selection << header << string("other") << 100u << 100u << 300u << 300u << (sf::Int32)250 << (sf::Int32)-40 << move;
+    REQUIRE(selection.getDataSize() < 40);
+    app.applyCommand(selection);
+    REQUIRE(app.getImage().getPixel(370, 90) == sf::Color::Green);
+    REQUIRE(app.getImage().getPixel(120, 130) == sf::Color::White);
+
+    app.undoCommand();
+    REQUIRE(app.getImage().getHash() == before);
+    app.redoCommand();
+    REQUIRE(app.getImage().getPixel(370, 90) == sf::Color::Green);
+    app.destroy();
+}
+
+TEST_CASE("A selection and messages the server does not know reach the other clients whole") {
+    TestServer server(8009);
+    REQUIRE(server.isRunning());
+
+    TCPClient clientA("clientA", 8009);
+    TCPClient clientB("clientB", 8009);
+    clientA.joinServer(sf::IpAddress::getLocalAddress(), 8009);
+    clientB.joinServer(sf::IpAddress::getLocalAddress(), 8009);
+
+    while (server->getClients() != 2) {
+        // Await clientA & clientB join
+    }
+
+    sf::Packet selection, unknown;
+    sf::Uint8 header = SELECTION, move = 1;
+    selection << header << string("clientA") << 100u << 100u << 300u << 300u << (sf::Int32)250 << (sf::Int32)-40
+              << move;
+    // A later message type the server has no branch for keeps its payload
+    header = SELECTION + 1;
+    unknown << header << string("clientA") << 1u << 2u << string("payload");
+    clientA.sendCommand(selection);
+    clientA.sendCommand(unknown);
+
+    App app(nullptr, nullptr, HEADLESS);
+    app.getImage().setPixel(120, 130, sf::Color::Green);
+    for (const sf::Packet &sent: {selection, unknown}) {
+        REQUIRE(clientB.waitForData(sf::seconds(5)) == true);
+        sf::Packet received = clientB.receiveData();
+        REQUIRE(received.getDataSize() == sent.getDataSize());
+        REQUIRE(memcmp(received.getData(), sent.getData(), sent.getDataSize()) == 0);
+        app.applyCommand(received);
+    }
+    REQUIRE(app.getImage().getPixel(370, 90) == sf::Color::Green);
+    REQUIRE(app.getImage().getPixel(120, 130) == sf::Color::White);
+    app.destroy();
+}